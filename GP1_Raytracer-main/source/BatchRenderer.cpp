@@ -0,0 +1,199 @@
+#include "BatchRenderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+#include "SDL.h"
+#include "Renderer.h"
+#include "RenderTarget.h"
+#include "Scene.h"
+#include "SceneFactory.h"
+#include "Timer.h"
+
+using namespace dae;
+
+BatchRenderer::BatchRenderer(const BatchSettings& settings) :
+	m_Settings(settings)
+{
+}
+
+int BatchRenderer::Run()
+{
+	Scene* pScene{ SceneFactory::GetInstance().Create(m_Settings.sceneName) };
+	if (!pScene)
+	{
+		std::cout << "Unknown scene '" << m_Settings.sceneName << "', available:";
+		for (const std::string& name : SceneFactory::GetInstance().GetNames())
+			std::cout << " " << name;
+		std::cout << std::endl;
+		return 1;
+	}
+
+	std::vector<CameraKeyframe> keyframes{};
+	if (!m_Settings.keyframePath.empty() && !LoadKeyframes(m_Settings.keyframePath, keyframes))
+	{
+		std::cout << "Could not read camera keyframes from " << m_Settings.keyframePath << std::endl;
+		delete pScene;
+		return 1;
+	}
+
+	pScene->Initialize();
+
+	MemoryRenderTarget target{ m_Settings.width, m_Settings.height };
+	Renderer renderer{ &target };
+	renderer.SetWorkers(m_Settings.nrWorkers, m_Settings.pinWorkers);
+
+	Timer timer{};
+	timer.Start();
+	timer.SetFixedTimeStep(m_Settings.timeStep);
+
+	ImageWriter& writer{ renderer.GetImageWriter() };
+
+	std::unique_ptr<VideoStream> pStream{};
+	if (!m_Settings.streamPath.empty())
+	{
+		const int frameRate{ std::max(1, static_cast<int>(std::lround(1.f / m_Settings.timeStep))) };
+		pStream = std::make_unique<VideoStream>(m_Settings.streamPath, m_Settings.streamFormat, m_Settings.width, m_Settings.height, frameRate);
+		if (!pStream->IsOpen())
+		{
+			std::cout << "Could not open video stream " << m_Settings.streamPath << std::endl;
+			delete pScene;
+			return 1;
+		}
+	}
+
+	std::ofstream timings{ m_Settings.outputPrefix + "_timing.csv" };
+	timings << "frame,time,render_ms,write_wait_ms\n";
+
+	const float countsToMilliseconds{ 1000.f / SDL_GetPerformanceFrequency() };
+	const uint64_t batchStart{ SDL_GetPerformanceCounter() };
+	float totalRenderTime{};
+
+	for (uint32_t frame{}; frame < m_Settings.nrFrames; ++frame)
+	{
+		pScene->Update(&timer);
+		if (!keyframes.empty())
+			ApplyKeyframes(keyframes, timer.GetTotal(), pScene->GetCamera());
+
+		const uint64_t renderStart{ SDL_GetPerformanceCounter() };
+		renderer.Render(pScene);
+		const float renderTime{ (SDL_GetPerformanceCounter() - renderStart) * countsToMilliseconds };
+		totalRenderTime += renderTime;
+
+		float waitTime{};
+		if (pStream)
+		{
+			waitTime = pStream->Write(target.GetSurface()) * 1000.f;
+		}
+		else
+		{
+			std::ostringstream path{};
+			path << m_Settings.outputPrefix << "_" << std::setw(4) << std::setfill('0') << frame << "." << m_Settings.imageExtension;
+			waitTime = renderer.SaveBufferToImage(path.str()) * 1000.f;
+		}
+
+		timings << frame << "," << timer.GetTotal() << "," << renderTime << "," << waitTime << "\n";
+		std::cout << "Frame " << frame << ": " << renderTime << " ms" << std::endl;
+
+		timer.Update();
+	}
+
+	writer.Flush();
+
+	if (pStream)
+		pStream->Flush();
+
+	const float totalTime{ (SDL_GetPerformanceCounter() - batchStart) * countsToMilliseconds };
+	std::cout << "Rendered " << m_Settings.nrFrames << " frames of " << m_Settings.sceneName
+		<< " at " << m_Settings.width << "x" << m_Settings.height
+		<< ", average " << totalRenderTime / std::max(m_Settings.nrFrames, 1u) << " ms per frame, "
+		<< totalTime / 1000.f << " s total, ";
+	if (pStream)
+	{
+		std::cout << pStream->GetNrFramesWritten() << " frames streamed";
+		if (pStream->HasFailed())
+			std::cout << ", the stream was closed early";
+		std::cout << std::endl;
+
+		const bool hasFailed{ pStream->HasFailed() };
+		delete pScene;
+		return hasFailed ? 1 : 0;
+	}
+
+	std::cout << writer.GetNrWritten() << " images written";
+	if (writer.GetNrFailed() > 0)
+		std::cout << ", " << writer.GetNrFailed() << " failed";
+	std::cout << std::endl;
+
+	const ImageWriter::EncodeStats encodeStats{ writer.GetEncodeStats() };
+	std::cout << "Encoding: " << encodeStats.nrInputBytes / 1'000'000.0 << " MB in " << encodeStats.encodeTime << " s, "
+		<< encodeStats.GetThroughput() << " MB/s, " << encodeStats.nrOutputBytes / 1'000'000.0 << " MB written" << std::endl;
+
+	delete pScene;
+	return writer.GetNrFailed() == 0 ? 0 : 1;
+}
+
+bool BatchRenderer::LoadKeyframes(const std::string& path, std::vector<CameraKeyframe>& keyframes)
+{
+	std::ifstream file{ path };
+	if (!file)
+		return false;
+
+	std::string line{};
+	while (std::getline(file, line))
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		std::istringstream stream{ line };
+		CameraKeyframe keyframe{};
+		if (!(stream >> keyframe.time >> keyframe.origin.x >> keyframe.origin.y >> keyframe.origin.z >> keyframe.yaw >> keyframe.pitch))
+			return false;
+
+		//The fov is optional, keep the previous one
+		if (!(stream >> keyframe.fovAngle))
+			keyframe.fovAngle = keyframes.empty() ? CameraKeyframe{}.fovAngle : keyframes.back().fovAngle;
+
+		keyframes.emplace_back(keyframe);
+	}
+
+	std::stable_sort(keyframes.begin(), keyframes.end(), [](const CameraKeyframe& a, const CameraKeyframe& b) { return a.time < b.time; });
+	return !keyframes.empty();
+}
+
+void BatchRenderer::ApplyKeyframes(const std::vector<CameraKeyframe>& keyframes, float time, Camera& camera)
+{
+	const auto next{ std::upper_bound(keyframes.begin(), keyframes.end(), time, [](float t, const CameraKeyframe& keyframe) { return t < keyframe.time; }) };
+
+	CameraKeyframe pose{};
+	if (next == keyframes.begin())
+	{
+		pose = keyframes.front();
+	}
+	else if (next == keyframes.end())
+	{
+		pose = keyframes.back();
+	}
+	else
+	{
+		const CameraKeyframe& from{ *(next - 1) };
+		const CameraKeyframe& to{ *next };
+		const float factor{ (time - from.time) / (to.time - from.time) };
+
+		pose.origin = from.origin + (to.origin - from.origin) * factor;
+		pose.yaw = from.yaw + (to.yaw - from.yaw) * factor;
+		pose.pitch = from.pitch + (to.pitch - from.pitch) * factor;
+		pose.fovAngle = from.fovAngle + (to.fovAngle - from.fovAngle) * factor;
+	}
+
+	camera.origin = pose.origin;
+	camera.totalYaw = pose.yaw * TO_RADIANS;
+	camera.totalPitch = pose.pitch * TO_RADIANS;
+	camera.SetFOV(pose.fovAngle);
+	camera.CalculateCameraToWorld();
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Math.h"
+#include "VideoStream.h"
+
+namespace dae
+{
+	struct Camera;
+
+	//Camera pose at a point in scene time, angles in degrees
+	struct CameraKeyframe
+	{
+		float time{};
+		Vector3 origin{};
+		float yaw{};
+		float pitch{};
+		float fovAngle{ 90.f };
+	};
+
+	struct BatchSettings
+	{
+		std::string sceneName{ "Scene_W4_Reference" };
+		int width{ 640 };
+		int height{ 480 };
+		uint32_t nrFrames{ 60 };
+		float timeStep{ 1.f / 30.f };
+		//Optional, one keyframe per line: time x y z yaw pitch [fov]
+		std::string keyframePath{};
+		//Frames are written as <prefix>_0000.<extension> ..., the timings to <prefix>_timing.csv
+		std::string outputPrefix{ "frame" };
+		//Any extension the image writer knows, pfm and exr store the linear colors
+		std::string imageExtension{ "bmp" };
+		//When set the frames are streamed as video to this file, pipe or stdout (-) instead of saved as images,
+		//at a frame rate of one over the time step
+		std::string streamPath{};
+		VideoStream::Format streamFormat{ VideoStream::Format::y4m };
+		uint32_t nrWorkers{};
+		bool pinWorkers{ false };
+	};
+
+	//Renders a fixed number of frames without a window at a fixed time step, following the camera keyframes.
+	//Finished frames go to the renderer's ImageWriter so encoding and the disk never hold up the next frame.
+	class BatchRenderer final
+	{
+	public:
+		BatchRenderer(const BatchSettings& settings);
+		~BatchRenderer() = default;
+
+		BatchRenderer(const BatchRenderer&) = delete;
+		BatchRenderer(BatchRenderer&&) noexcept = delete;
+		BatchRenderer& operator=(const BatchRenderer&) = delete;
+		BatchRenderer& operator=(BatchRenderer&&) noexcept = delete;
+
+		//Returns the process exit code
+		int Run();
+
+	private:
+		BatchSettings m_Settings;
+
+		static bool LoadKeyframes(const std::string& path, std::vector<CameraKeyframe>& keyframes);
+		//Linear interpolation between the surrounding keyframes, clamped to the first and last one
+		static void ApplyKeyframes(const std::vector<CameraKeyframe>& keyframes, float time, Camera& camera);
+	};
+}
@@ -0,0 +1,206 @@
+#include "CompactMesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "DataTypes.h"
+#include "Utils.h"
+
+using namespace dae;
+
+namespace
+{
+	constexpr float QuantizationSteps{ std::numeric_limits<uint16_t>::max() };
+	constexpr float NormalSteps{ std::numeric_limits<int16_t>::max() };
+
+	float SignNotZero(float value)
+	{
+		return value >= 0.f ? 1.f : -1.f;
+	}
+
+	template<typename Vector>
+	size_t GetCapacityBytes(const Vector& vector)
+	{
+		return vector.capacity() * sizeof(typename Vector::value_type);
+	}
+}
+
+CompactMesh::CompactMesh(std::span<const Vector3> positions, std::span<const Vector3> normals, std::span<const Vector3> vertexNormals,
+	std::span<const int> indices)
+{
+	if (!positions.empty())
+	{
+		m_MinAABB = positions[0];
+		m_MaxAABB = positions[0];
+		for (const Vector3& position : positions)
+		{
+			m_MinAABB = Vector3::Min(m_MinAABB, position);
+			m_MaxAABB = Vector3::Max(m_MaxAABB, position);
+		}
+	}
+
+	const Vector3 extent{ m_MaxAABB - m_MinAABB };
+	m_Step = extent / QuantizationSteps;
+
+	//A flat axis has a step of 0, everything on it quantizes to 0
+	const auto quantize = [](float value, float minValue, float axisExtent)
+	{
+		return axisExtent > 0.f ? static_cast<uint16_t>(std::lround((value - minValue) / axisExtent * QuantizationSteps)) : uint16_t{};
+	};
+
+	m_Positions.reserve(positions.size());
+	for (const Vector3& position : positions)
+	{
+		m_Positions.emplace_back(QuantizedPosition{ quantize(position.x, m_MinAABB.x, extent.x), quantize(position.y, m_MinAABB.y, extent.y),
+			quantize(position.z, m_MinAABB.z, extent.z) });
+	}
+
+	m_Normals.reserve(normals.size());
+	for (const Vector3& normal : normals)
+		m_Normals.emplace_back(EncodeNormal(normal));
+
+	m_VertexNormals.reserve(vertexNormals.size());
+	for (const Vector3& vertexNormal : vertexNormals)
+		m_VertexNormals.emplace_back(EncodeNormal(vertexNormal));
+
+	if (positions.size() <= size_t{ std::numeric_limits<uint16_t>::max() } + 1)
+		m_ShortIndices.assign(indices.begin(), indices.end());
+	else
+		m_Indices.assign(indices.begin(), indices.end());
+}
+
+bool CompactMesh::Compact(TriangleMesh& mesh)
+{
+	if (mesh.pClusters)
+		return false;
+
+	if (mesh.pMapped)
+	{
+		const MeshCache::MeshView& view{ *mesh.pMapped };
+		mesh.pCompact = std::make_shared<const CompactMesh>(view.positions, view.normals, view.vertexNormals, view.indices);
+		mesh.pMapped.reset();
+	}
+	else
+	{
+		if (mesh.indices.empty())
+			return false;
+
+		if (mesh.normals.size() * 3 != mesh.indices.size())
+			mesh.CalculateNormals();
+
+		mesh.pCompact = std::make_shared<const CompactMesh>(mesh.positions, mesh.normals, mesh.vertexNormals, mesh.indices);
+	}
+
+	mesh.minAABB = mesh.pCompact->GetMinAABB();
+	mesh.maxAABB = mesh.pCompact->GetMaxAABB();
+
+	//Swapping with empty vectors releases the memory, clear keeps it
+	std::vector<Vector3>{}.swap(mesh.positions);
+	std::vector<Vector3>{}.swap(mesh.normals);
+	std::vector<Vector3>{}.swap(mesh.vertexNormals);
+	std::vector<int>{}.swap(mesh.indices);
+	std::vector<Vector3>{}.swap(mesh.transformedPositions);
+	std::vector<Vector3>{}.swap(mesh.transformedNormals);
+	std::vector<Vector3>{}.swap(mesh.transformedVertexNormals);
+
+	mesh.UpdateTransforms();
+	return true;
+}
+
+bool CompactMesh::HitTest(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord) const
+{
+	if (m_ShortIndices.empty())
+		return HitTest(m_Indices, mesh, ray, hitRecord, ignoreHitRecord);
+
+	return HitTest(m_ShortIndices, mesh, ray, hitRecord, ignoreHitRecord);
+}
+
+size_t CompactMesh::GetMemoryUsage() const
+{
+	return sizeof(CompactMesh) + GetCapacityBytes(m_Positions) + GetCapacityBytes(m_Normals) + GetCapacityBytes(m_VertexNormals)
+		+ GetCapacityBytes(m_ShortIndices) + GetCapacityBytes(m_Indices);
+}
+
+uint32_t CompactMesh::EncodeNormal(const Vector3& normal)
+{
+	//Onto the octahedron, the lower half is folded over the upper one
+	const float inverseLength{ 1.f / (std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z)) };
+	float x{ normal.x * inverseLength };
+	float y{ normal.y * inverseLength };
+	if (normal.z < 0.f)
+	{
+		const float foldedX{ (1.f - std::abs(y)) * SignNotZero(x) };
+		y = (1.f - std::abs(x)) * SignNotZero(y);
+		x = foldedX;
+	}
+
+	const auto encode = [](float value)
+	{
+		return static_cast<uint16_t>(static_cast<int16_t>(std::lround(std::clamp(value, -1.f, 1.f) * NormalSteps)));
+	};
+
+	return static_cast<uint32_t>(encode(x)) | static_cast<uint32_t>(encode(y)) << 16;
+}
+
+Vector3 CompactMesh::DecodeNormal(uint32_t encodedNormal)
+{
+	const float x{ static_cast<int16_t>(encodedNormal & 0xFFFF) / NormalSteps };
+	const float y{ static_cast<int16_t>(encodedNormal >> 16) / NormalSteps };
+	const float z{ 1.f - std::abs(x) - std::abs(y) };
+	if (z >= 0.f)
+		return Vector3{ x, y, z }.Normalized();
+
+	return Vector3{ (1.f - std::abs(y)) * SignNotZero(x), (1.f - std::abs(x)) * SignNotZero(y), z }.Normalized();
+}
+
+template<typename Index>
+bool CompactMesh::HitTest(const std::vector<Index>& indices, const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord) const
+{
+	//The direction isn't normalized, t stays the distance along the world ray
+	const Ray localRay{ mesh.inverseTransform.TransformPoint(ray.origin), mesh.inverseTransform.TransformVector(ray.direction), ray.min, ray.max };
+
+	Triangle triangle{};
+	triangle.cullMode = mesh.cullMode;
+	triangle.materialIndex = mesh.materialIndex;
+	size_t hitTriangle{ m_Normals.size() };
+
+	for (size_t index{}; index < indices.size(); index += 3)
+	{
+		triangle.v0 = GetPosition(indices[index]);
+		triangle.v1 = GetPosition(indices[index + 1]);
+		triangle.v2 = GetPosition(indices[index + 2]);
+
+		//The normal isn't needed to find the hit, it is decoded once the closest one is known
+		if (!GeometryUtils::HitTest_Triangle(triangle, localRay, hitRecord, ignoreHitRecord))
+			continue;
+
+		if (ignoreHitRecord)
+			return true;
+
+		hitTriangle = index / 3;
+	}
+
+	//Moved back to world space once, for the closest hit
+	if (hitTriangle < m_Normals.size())
+	{
+		if (m_VertexNormals.empty())
+		{
+			hitRecord.normal = DecodeNormal(m_Normals[hitTriangle]);
+		}
+		else
+		{
+			const size_t index{ hitTriangle * 3 };
+			triangle.v0 = GetPosition(indices[index]);
+			triangle.v1 = GetPosition(indices[index + 1]);
+			triangle.v2 = GetPosition(indices[index + 2]);
+			hitRecord.normal = GeometryUtils::InterpolateNormal(triangle, hitRecord.origin, DecodeNormal(m_VertexNormals[indices[index]]),
+				DecodeNormal(m_VertexNormals[indices[index + 1]]), DecodeNormal(m_VertexNormals[indices[index + 2]]));
+		}
+
+		hitRecord.origin = ray.origin + ray.direction * hitRecord.t;
+		hitRecord.normal = mesh.finalTransform.TransformVector(hitRecord.normal).Normalized();
+	}
+
+	return hitRecord.didHit;
+}
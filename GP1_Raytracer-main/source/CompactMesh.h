@@ -0,0 +1,84 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "Vector3.h"
+
+namespace dae
+{
+	struct Ray;
+	struct HitRecord;
+	struct TriangleMesh;
+
+	//Object space geometry of a mesh at a fraction of the float size: positions are quantized to 16 bits per axis
+	//relative to the mesh's bounds, normals are octahedral encoded in 32 bits and indices take 16 bits when the mesh
+	//has few enough vertices. Nothing is kept in world space, the ray is moved into object space instead, so meshes
+	//that share a CompactMesh are instances that only differ in their transform and material.
+	class CompactMesh final
+	{
+	public:
+		//vertexNormals is empty or has one per position, normals has one per triangle
+		CompactMesh(std::span<const Vector3> positions, std::span<const Vector3> normals, std::span<const Vector3> vertexNormals,
+			std::span<const int> indices);
+		~CompactMesh() = default;
+
+		CompactMesh(const CompactMesh&) = delete;
+		CompactMesh(CompactMesh&&) noexcept = delete;
+		CompactMesh& operator=(const CompactMesh&) = delete;
+		CompactMesh& operator=(CompactMesh&&) noexcept = delete;
+
+		/**
+		 * \brief Replaces the float arrays of mesh, and their transformed copies, with a CompactMesh of them.
+		 * A mesh that is read from a MeshCache is compacted from the mapping and lets go of it.
+		 * \return false when the mesh has no triangles in memory or mapped, a streamed mesh for one
+		 */
+		static bool Compact(TriangleMesh& mesh);
+
+		/**
+		 * \brief Tests the ray against every triangle, dequantizing them on the fly. The ray is moved into object space
+		 * with the mesh's inverse transform, the hit is moved back.
+		 * \return whether anything was hit, like GeometryUtils::HitTest_TriangleMesh. With ignoreHitRecord it stops at the first
+		 * hit and leaves hitRecord alone, the float and streamed meshes do the same so shadows match across storage modes.
+		 */
+		bool HitTest(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord) const;
+
+		const Vector3& GetMinAABB() const { return m_MinAABB; }
+		const Vector3& GetMaxAABB() const { return m_MaxAABB; }
+		size_t GetNrTriangles() const { return m_Normals.size(); }
+		size_t GetMemoryUsage() const;
+
+		static uint32_t EncodeNormal(const Vector3& normal);
+		static Vector3 DecodeNormal(uint32_t encodedNormal);
+
+	private:
+		struct QuantizedPosition
+		{
+			uint16_t x{};
+			uint16_t y{};
+			uint16_t z{};
+		};
+
+		Vector3 m_MinAABB{};
+		Vector3 m_MaxAABB{};
+		//Size of a quantization step per axis
+		Vector3 m_Step{};
+
+		std::vector<QuantizedPosition> m_Positions{};
+		std::vector<uint32_t> m_Normals{};
+		std::vector<uint32_t> m_VertexNormals{};
+		//Only one of them is filled
+		std::vector<uint16_t> m_ShortIndices{};
+		std::vector<int> m_Indices{};
+
+		Vector3 GetPosition(int vertex) const
+		{
+			const QuantizedPosition& position{ m_Positions[vertex] };
+			return Vector3{ m_MinAABB.x + position.x * m_Step.x, m_MinAABB.y + position.y * m_Step.y, m_MinAABB.z + position.z * m_Step.z };
+		}
+
+		template<typename Index>
+		bool HitTest(const std::vector<Index>& indices, const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord) const;
+	};
+}
@@ -1,11 +1,17 @@
 #pragma once
 #include <cassert>
+#include <cstdint>
+#include <memory>
 
 #include "Math.h"
+#include "MeshCache.h"
 #include "vector"
 
 namespace dae
 {
+	class CompactMesh;
+	class MeshClusters;
+
 #pragma region GEOMETRY
 	struct Sphere
 	{
@@ -79,6 +85,8 @@ namespace dae
 		std::vector<Vector3> positions{};
 		std::vector<Vector3> normals{};
 		std::vector<int> indices{};
+		//Optional, one per position, the hit normal is interpolated from them instead of using the face normal
+		std::vector<Vector3> vertexNormals{};
 		unsigned char materialIndex{};
 
 		TriangleCullMode cullMode{TriangleCullMode::BackFaceCulling};
@@ -87,6 +95,16 @@ namespace dae
 		Matrix translationTransform{};
 		Matrix scaleTransform{};
 
+		//Set by UpdateTransforms, streamed, compact and mapped meshes move the ray into object space instead of transforming their triangles
+		Matrix finalTransform{};
+		Matrix inverseTransform{};
+
+		//Set when the triangles stay on disk (see MeshClusters), positions and indices are empty then
+		std::shared_ptr<const MeshClusters> pClusters{};
+		//Set when the triangles are kept quantized (see CompactMesh), positions and indices are empty then too
+		std::shared_ptr<const CompactMesh> pCompact{};
+		//Set when the triangles are read in place from a MeshCache, it shares ownership of the cache so the mapping stays open
+		std::shared_ptr<const MeshCache::MeshView> pMapped{};
 
 		Vector3 minAABB;
 		Vector3 maxAABB;
@@ -96,6 +114,12 @@ namespace dae
 
 		std::vector<Vector3> transformedPositions{};
 		std::vector<Vector3> transformedNormals{};
+		std::vector<Vector3> transformedVertexNormals{};
+
+		//Set by UpdateTransforms, the previous bounds are the ones the renderer last saw
+		bool isDirty{ true };
+		Vector3 previousTransformedMinAABB;
+		Vector3 previousTransformedMaxAABB;
 
 		void Translate(const Vector3& translation)
 		{
@@ -147,7 +171,9 @@ namespace dae
 			transformedNormals.clear();
 			transformedPositions.clear();
 			
-			const Matrix finalTransform = scaleTransform * rotationTransform * translationTransform;
+			finalTransform = scaleTransform * rotationTransform * translationTransform;
+			inverseTransform = Matrix::CreateTranslation(-translationTransform.GetTranslation()) * Matrix::Transpose(rotationTransform)
+				* Matrix::CreateScale(1.f / scaleTransform.GetAxisX().x, 1.f / scaleTransform.GetAxisY().y, 1.f / scaleTransform.GetAxisZ().z);
 
 			transformedNormals.reserve(normals.size());
 			transformedPositions.reserve(positions.size());
@@ -162,6 +188,20 @@ namespace dae
 				 
 				transformedNormals.emplace_back(finalTransform.TransformVector(normals).Normalized());
 			}
+
+			transformedVertexNormals.clear();
+			transformedVertexNormals.reserve(vertexNormals.size());
+			for (const Vector3& vertexNormal : vertexNormals)
+			{
+				transformedVertexNormals.emplace_back(finalTransform.TransformVector(vertexNormal).Normalized());
+			}
+
+			if (!isDirty)
+			{
+				previousTransformedMinAABB = transformedMinAABB;
+				previousTransformedMaxAABB = transformedMaxAABB;
+				isDirty = true;
+			}
 			UpdateTransformedAABB(finalTransform);
 
 		}
@@ -258,6 +298,8 @@ namespace dae
 
 		bool didHit{ false };
 		unsigned char materialIndex{ 0 };
+		//Index of the hit object in the scene (planes, spheres, triangles, meshes), filled in by Scene::GetClosestHit
+		uint32_t primitiveId{ 0 };
 	};
 #pragma endregion
 }
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include "FileWatcher.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using namespace dae;
+
+FileWatcher::FileWatcher()
+{
+#ifdef __linux__
+	m_InotifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+	if (m_InotifyDescriptor >= 0)
+		close(m_InotifyDescriptor);
+#endif
+}
+
+void FileWatcher::Watch(const std::string& path)
+{
+	const std::string key{ GetKey(path) };
+	if (m_Files.contains(key))
+		return;
+
+	std::error_code error{};
+	m_Files.emplace(key, WatchedFile{ path, std::filesystem::last_write_time(path, error) });
+
+#ifdef __linux__
+	const std::filesystem::path directory{ std::filesystem::path{ key }.parent_path() };
+	const bool isWatched{ std::any_of(m_Directories.begin(), m_Directories.end(), [&directory](const auto& watch) { return watch.second == directory; }) };
+	if (m_InotifyDescriptor >= 0 && !isWatched)
+	{
+		const int watchDescriptor{ inotify_add_watch(m_InotifyDescriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) };
+		if (watchDescriptor >= 0)
+			m_Directories.emplace(watchDescriptor, directory);
+	}
+#endif
+}
+
+void FileWatcher::Clear()
+{
+	m_Files.clear();
+
+#ifdef __linux__
+	for (const auto& directory : m_Directories)
+		inotify_rm_watch(m_InotifyDescriptor, directory.first);
+	m_Directories.clear();
+#endif
+}
+
+std::vector<std::string> FileWatcher::Poll()
+{
+	std::vector<std::string> changedPaths{};
+	const auto addChanged = [&changedPaths](const std::string& path)
+	{
+		if (std::find(changedPaths.begin(), changedPaths.end(), path) == changedPaths.end())
+			changedPaths.emplace_back(path);
+	};
+
+#ifdef __linux__
+	if (m_InotifyDescriptor >= 0)
+	{
+		//Events are variable length, the buffer is aligned for the header
+		alignas(inotify_event) char buffer[4096];
+		ssize_t size{};
+		while ((size = read(m_InotifyDescriptor, buffer, sizeof(buffer))) > 0)
+		{
+			for (ssize_t offset{}; offset < size;)
+			{
+				const inotify_event* pEvent{ reinterpret_cast<const inotify_event*>(buffer + offset) };
+				offset += sizeof(inotify_event) + pEvent->len;
+
+				const auto directoryIt{ m_Directories.find(pEvent->wd) };
+				if (directoryIt == m_Directories.end() || pEvent->len == 0)
+					continue;
+
+				const auto fileIt{ m_Files.find((directoryIt->second / pEvent->name).string()) };
+				if (fileIt != m_Files.end())
+					addChanged(fileIt->second.path);
+			}
+		}
+
+		return changedPaths;
+	}
+#endif
+
+	const auto now{ std::chrono::steady_clock::now() };
+	if (now - m_LastPoll < PollInterval)
+		return changedPaths;
+	m_LastPoll = now;
+
+	for (auto& file : m_Files)
+	{
+		std::error_code error{};
+		const std::filesystem::file_time_type writeTime{ std::filesystem::last_write_time(file.second.path, error) };
+		if (!error && writeTime != file.second.writeTime)
+		{
+			file.second.writeTime = writeTime;
+			addChanged(file.second.path);
+		}
+	}
+
+	return changedPaths;
+}
+
+std::string FileWatcher::GetKey(const std::string& path)
+{
+	std::error_code error{};
+	return std::filesystem::absolute(path, error).lexically_normal().string();
+}
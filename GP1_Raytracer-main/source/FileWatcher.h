@@ -0,0 +1,52 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace dae
+{
+	//Reports watched files that were written since the last poll, without blocking. On Linux inotify watches the
+	//directories of the files, which also catches editors that save by renaming a temporary file over the original.
+	//Elsewhere the write times are compared, at most every PollInterval.
+	class FileWatcher final
+	{
+	public:
+		FileWatcher();
+		~FileWatcher();
+
+		FileWatcher(const FileWatcher&) = delete;
+		FileWatcher(FileWatcher&&) noexcept = delete;
+		FileWatcher& operator=(const FileWatcher&) = delete;
+		FileWatcher& operator=(FileWatcher&&) noexcept = delete;
+
+		//Watching the same file twice has no effect
+		void Watch(const std::string& path);
+		void Clear();
+
+		//Paths as given to Watch, each changed file once
+		std::vector<std::string> Poll();
+
+	private:
+		static constexpr std::chrono::milliseconds PollInterval{ 250 };
+
+		struct WatchedFile
+		{
+			std::string path{};
+			std::filesystem::file_time_type writeTime{};
+		};
+
+		//Keyed on the absolute, normalized path
+		std::unordered_map<std::string, WatchedFile> m_Files{};
+		std::chrono::steady_clock::time_point m_LastPoll{};
+
+#ifdef __linux__
+		int m_InotifyDescriptor{ -1 };
+		//Watch descriptor to absolute directory
+		std::unordered_map<int, std::filesystem::path> m_Directories{};
+#endif
+
+		static std::string GetKey(const std::string& path);
+	};
+}
@@ -0,0 +1,51 @@
+#include "FrameBudgetController.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace dae;
+
+FrameBudgetController::FrameBudgetController(float targetFrameTime) :
+	m_TargetFrameTime(targetFrameTime)
+{
+}
+
+bool FrameBudgetController::Update(float frameTime)
+{
+	if (frameTime <= 0.f)
+		return false;
+
+	m_SmoothedFrameTime = (m_SmoothedFrameTime == 0.f) ? frameTime : m_SmoothedFrameTime + (frameTime - m_SmoothedFrameTime) * Smoothing;
+
+	if (m_Cooldown > 0)
+	{
+		--m_Cooldown;
+		return false;
+	}
+
+	const float ratio{ m_SmoothedFrameTime / m_TargetFrameTime };
+	if (ratio <= UpperBound && ratio >= LowerBound)
+		return false;
+
+	//Frame cost is roughly proportional to the traced pixel count, so to the square of the scale
+	float newScale{ m_Scale / std::sqrt(ratio) };
+	newScale = std::round(newScale / ScaleStep) * ScaleStep;
+	newScale = std::clamp(newScale, MinScale, MaxScale);
+
+	if (newScale == m_Scale)
+		return false;
+
+	m_Scale = newScale;
+	m_Cooldown = CooldownFrames;
+
+	//Older measurements belong to the previous scale
+	m_SmoothedFrameTime = 0.f;
+	return true;
+}
+
+void FrameBudgetController::Reset()
+{
+	m_Scale = MaxScale;
+	m_SmoothedFrameTime = 0.f;
+	m_Cooldown = 0;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+namespace dae
+{
+	//Picks an internal render resolution scale so the measured frame time stays close to a target.
+	//The scale only moves when the smoothed frame time leaves a band around the target, and stays
+	//put for a few frames after every change so the new scale can be measured.
+	class FrameBudgetController final
+	{
+	public:
+		FrameBudgetController(float targetFrameTime = 1.f / 30.f);
+		~FrameBudgetController() = default;
+
+		FrameBudgetController(const FrameBudgetController&) = delete;
+		FrameBudgetController(FrameBudgetController&&) noexcept = delete;
+		FrameBudgetController& operator=(const FrameBudgetController&) = delete;
+		FrameBudgetController& operator=(FrameBudgetController&&) noexcept = delete;
+
+		/**
+		 * \brief Feeds the duration of the last frame
+		 * \param frameTime seconds, e.g. Timer::GetElapsed()
+		 * \return true when the scale changed
+		 */
+		bool Update(float frameTime);
+		void Reset();
+
+		void SetTargetFrameTime(float targetFrameTime) { m_TargetFrameTime = targetFrameTime; }
+		float GetTargetFrameTime() const { return m_TargetFrameTime; }
+		float GetSmoothedFrameTime() const { return m_SmoothedFrameTime; }
+
+		//Fraction of the output width and height that is rendered
+		float GetScale() const { return m_Scale; }
+
+	private:
+		static constexpr float MinScale{ 0.25f };
+		static constexpr float MaxScale{ 1.f };
+		//The scale snaps to multiples of this step, small measurement noise never changes it
+		static constexpr float ScaleStep{ 1.f / 16.f };
+		//Hysteresis band around the target, relative
+		static constexpr float UpperBound{ 1.1f };
+		static constexpr float LowerBound{ 0.8f };
+		//Weight of the newest frame in the smoothed frame time
+		static constexpr float Smoothing{ 0.3f };
+		static constexpr int CooldownFrames{ 3 };
+
+		float m_TargetFrameTime{};
+		float m_SmoothedFrameTime{};
+		float m_Scale{ MaxScale };
+		int m_Cooldown{};
+	};
+}
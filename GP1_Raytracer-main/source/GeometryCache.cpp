@@ -0,0 +1,125 @@
+#include "GeometryCache.h"
+
+#include <iostream>
+
+using namespace dae;
+
+GeometryCache& GeometryCache::GetInstance()
+{
+	static GeometryCache instance{};
+	return instance;
+}
+
+void GeometryCache::SetCapacity(size_t bytes)
+{
+	const std::lock_guard lock{ m_Mutex };
+	m_Capacity = bytes;
+	Evict();
+}
+
+std::shared_ptr<const GeometryCache::Page> GeometryCache::Acquire(uint32_t sourceId, uint32_t pageIndex, const std::function<bool(Page&)>& read)
+{
+	const uint64_t key{ GetKey(sourceId, pageIndex) };
+
+	{
+		const std::lock_guard lock{ m_Mutex };
+		const auto entryIt{ m_EntriesByKey.find(key) };
+		if (entryIt != m_EntriesByKey.end())
+		{
+			m_Entries.splice(m_Entries.begin(), m_Entries, entryIt->second);
+			++m_Hits;
+			return entryIt->second->pPage;
+		}
+	}
+
+	//Read without holding the lock, the other threads keep hitting the pages that are cached
+	++m_Faults;
+	auto pPage{ std::make_shared<Page>() };
+	if (!read(*pPage))
+		return nullptr;
+
+	const size_t size{ pPage->size() * sizeof(Vector3) };
+	m_BytesRead += size;
+
+	const std::lock_guard lock{ m_Mutex };
+	const auto [entryIt, isNew] { m_EntriesByKey.try_emplace(key) };
+	if (!isNew)
+	{
+		m_Entries.splice(m_Entries.begin(), m_Entries, entryIt->second);
+		return entryIt->second->pPage;
+	}
+
+	m_Entries.emplace_front(Entry{ key, std::move(pPage), size });
+	entryIt->second = m_Entries.begin();
+	m_ResidentBytes += size;
+
+	//The new page itself is never evicted, it is in use
+	const std::shared_ptr<const Page> pResult{ m_Entries.front().pPage };
+	Evict();
+	return pResult;
+}
+
+void GeometryCache::Release(uint32_t sourceId)
+{
+	const std::lock_guard lock{ m_Mutex };
+	for (auto entryIt{ m_Entries.begin() }; entryIt != m_Entries.end();)
+	{
+		if (entryIt->key >> 32 != sourceId)
+		{
+			++entryIt;
+			continue;
+		}
+
+		m_ResidentBytes -= entryIt->size;
+		m_EntriesByKey.erase(entryIt->key);
+		entryIt = m_Entries.erase(entryIt);
+	}
+}
+
+GeometryCache::Statistics GeometryCache::GetStatistics() const
+{
+	Statistics statistics{};
+	statistics.hits = m_Hits;
+	statistics.faults = m_Faults;
+	statistics.evictions = m_Evictions;
+	statistics.bytesRead = m_BytesRead;
+
+	const std::lock_guard lock{ m_Mutex };
+	statistics.residentBytes = m_ResidentBytes;
+	statistics.capacity = m_Capacity;
+	return statistics;
+}
+
+void GeometryCache::ResetStatistics()
+{
+	m_Hits = 0;
+	m_Faults = 0;
+	m_Evictions = 0;
+	m_BytesRead = 0;
+}
+
+void GeometryCache::PrintStatistics() const
+{
+	const Statistics statistics{ GetStatistics() };
+	const uint64_t nrAccesses{ statistics.hits + statistics.faults };
+	if (nrAccesses == 0)
+		return;
+
+	constexpr double megabyte{ 1024.0 * 1024.0 };
+	std::cout << "Geometry cache: " << statistics.hits << " hits, " << statistics.faults << " faults ("
+		<< 100.0 * statistics.hits / nrAccesses << "% hit rate), " << statistics.evictions << " evictions, "
+		<< statistics.bytesRead / megabyte << " MB read, " << statistics.residentBytes / megabyte << " of "
+		<< statistics.capacity / megabyte << " MB resident" << std::endl;
+}
+
+void GeometryCache::Evict()
+{
+	while (m_ResidentBytes > m_Capacity && m_Entries.size() > 1)
+	{
+		const Entry& entry{ m_Entries.back() };
+		m_ResidentBytes -= entry.size;
+		m_EntriesByKey.erase(entry.key);
+		m_Entries.pop_back();
+		++m_Evictions;
+	}
+}
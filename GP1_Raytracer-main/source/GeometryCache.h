@@ -0,0 +1,92 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "Vector3.h"
+
+namespace dae
+{
+	//Least recently used cache of the geometry pages of streamed meshes (see MeshClusters), shared by every mesh and
+	//render thread. A page that is evicted while a thread still uses it stays alive until that thread lets go, so the
+	//resident size can briefly exceed the capacity by a page per thread.
+	class GeometryCache final
+	{
+	public:
+		using Page = std::vector<Vector3>;
+
+		struct Statistics
+		{
+			uint64_t hits{};
+			//Pages that had to be read from disk
+			uint64_t faults{};
+			uint64_t evictions{};
+			uint64_t bytesRead{};
+			size_t residentBytes{};
+			size_t capacity{};
+		};
+
+		static GeometryCache& GetInstance();
+
+		GeometryCache(const GeometryCache&) = delete;
+		GeometryCache(GeometryCache&&) noexcept = delete;
+		GeometryCache& operator=(const GeometryCache&) = delete;
+		GeometryCache& operator=(GeometryCache&&) noexcept = delete;
+
+		//Evicts right away when the cache holds more than the new capacity
+		void SetCapacity(size_t bytes);
+
+		/**
+		 * \brief Returns the page, calling read outside the lock when it isn't cached. Two threads that fault the same
+		 * page at once both read it, the second one then takes the page the first one inserted.
+		 * \param sourceId tells the files apart, see NewSourceId
+		 * \return nullptr when read fails
+		 */
+		std::shared_ptr<const Page> Acquire(uint32_t sourceId, uint32_t pageIndex, const std::function<bool(Page&)>& read);
+
+		//Ids are never reused, pages of a closed file can't be mistaken for those of a new one
+		uint32_t NewSourceId() { return m_NextSourceId++; }
+		//Drops the pages of a file that is closed
+		void Release(uint32_t sourceId);
+
+		Statistics GetStatistics() const;
+		void ResetStatistics();
+		void PrintStatistics() const;
+
+	private:
+		//256 MB
+		static constexpr size_t DefaultCapacity{ size_t{ 256 } << 20 };
+
+		struct Entry
+		{
+			uint64_t key{};
+			std::shared_ptr<const Page> pPage{};
+			size_t size{};
+		};
+
+		GeometryCache() = default;
+		~GeometryCache() = default;
+
+		mutable std::mutex m_Mutex{};
+		//Most recently used first
+		std::list<Entry> m_Entries{};
+		std::unordered_map<uint64_t, std::list<Entry>::iterator> m_EntriesByKey{};
+		size_t m_Capacity{ DefaultCapacity };
+		size_t m_ResidentBytes{};
+
+		std::atomic<uint32_t> m_NextSourceId{};
+		std::atomic<uint64_t> m_Hits{};
+		std::atomic<uint64_t> m_Faults{};
+		std::atomic<uint64_t> m_Evictions{};
+		std::atomic<uint64_t> m_BytesRead{};
+
+		static uint64_t GetKey(uint32_t sourceId, uint32_t pageIndex) { return static_cast<uint64_t>(sourceId) << 32 | pageIndex; }
+		//Call with the mutex held
+		void Evict();
+	};
+}
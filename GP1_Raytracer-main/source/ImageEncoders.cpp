@@ -0,0 +1,650 @@
+#include "ImageEncoders.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cctype>
+#include <cstring>
+
+using namespace dae;
+
+//PFM and EXR store little endian floats, the bulk copies below rely on the host matching
+static_assert(std::endian::native == std::endian::little);
+
+namespace
+{
+	void AppendBytes(std::vector<uint8_t>& output, const void* pData, size_t size)
+	{
+		const uint8_t* pBytes{ static_cast<const uint8_t*>(pData) };
+		output.insert(output.end(), pBytes, pBytes + size);
+	}
+
+	void AppendString(std::vector<uint8_t>& output, const std::string& text)
+	{
+		AppendBytes(output, text.data(), text.size());
+	}
+
+	//Null terminated, as the EXR attribute names and types are stored
+	void AppendName(std::vector<uint8_t>& output, const char* pName)
+	{
+		AppendBytes(output, pName, std::strlen(pName) + 1);
+	}
+
+	template<typename T>
+	void AppendLittleEndian(std::vector<uint8_t>& output, T value)
+	{
+		AppendBytes(output, &value, sizeof(T));
+	}
+
+	void AppendBigEndian(std::vector<uint8_t>& output, uint32_t value)
+	{
+		const uint8_t bytes[4]{ uint8_t(value >> 24), uint8_t(value >> 16), uint8_t(value >> 8), uint8_t(value) };
+		AppendBytes(output, bytes, sizeof(bytes));
+	}
+
+	//PNG chunk checksums, slicing by 4: one table per byte position of a 32-bit word
+	const std::array<std::array<uint32_t, 256>, 4>& GetCrcTables()
+	{
+		static const std::array<std::array<uint32_t, 256>, 4> tables{ []
+		{
+			std::array<std::array<uint32_t, 256>, 4> result{};
+			for (uint32_t index{}; index < 256; ++index)
+			{
+				uint32_t value{ index };
+				for (int bit{}; bit < 8; ++bit)
+					value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+				result[0][index] = value;
+			}
+			for (uint32_t index{}; index < 256; ++index)
+			{
+				for (size_t slice{ 1 }; slice < 4; ++slice)
+					result[slice][index] = result[0][result[slice - 1][index] & 0xFF] ^ (result[slice - 1][index] >> 8);
+			}
+			return result;
+		}() };
+		return tables;
+	}
+
+	uint32_t Crc32(const uint8_t* pData, size_t size)
+	{
+		const std::array<std::array<uint32_t, 256>, 4>& tables{ GetCrcTables() };
+		uint32_t crc{ 0xFFFFFFFFu };
+		for (; size >= 4; size -= 4, pData += 4)
+		{
+			uint32_t word{};
+			std::memcpy(&word, pData, sizeof(word));
+			crc ^= word;
+			crc = tables[3][crc & 0xFF] ^ tables[2][(crc >> 8) & 0xFF] ^ tables[1][(crc >> 16) & 0xFF] ^ tables[0][crc >> 24];
+		}
+		for (; size > 0; --size, ++pData)
+			crc = tables[0][(crc ^ *pData) & 0xFF] ^ (crc >> 8);
+		return crc ^ 0xFFFFFFFFu;
+	}
+
+	uint32_t Adler32(const uint8_t* pData, size_t size)
+	{
+		//Largest run of bytes before the sums can overflow 32 bits
+		constexpr size_t blockSize{ 5552 };
+		uint32_t a{ 1 };
+		uint32_t b{};
+		while (size > 0)
+		{
+			const size_t count{ std::min(size, blockSize) };
+			for (size_t index{}; index < count; ++index)
+			{
+				a += pData[index];
+				b += a;
+			}
+			a %= 65521;
+			b %= 65521;
+			pData += count;
+			size -= count;
+		}
+		return (b << 16) | a;
+	}
+
+	//Writes the chunk that starts at chunkStart (length placeholder, type, data) its length and checksum
+	void FinishPngChunk(std::vector<uint8_t>& output, size_t chunkStart)
+	{
+		const uint32_t length{ static_cast<uint32_t>(output.size() - chunkStart - 8) };
+		output[chunkStart] = uint8_t(length >> 24);
+		output[chunkStart + 1] = uint8_t(length >> 16);
+		output[chunkStart + 2] = uint8_t(length >> 8);
+		output[chunkStart + 3] = uint8_t(length);
+		AppendBigEndian(output, Crc32(&output[chunkStart + 4], length + 4));
+	}
+
+	//Deflate bit stream, least significant bit first
+	class BitWriter final
+	{
+	public:
+		BitWriter(std::vector<uint8_t>& output) : m_Output(output) {}
+
+		void Write(uint32_t bits, uint32_t nrBits)
+		{
+			m_Bits |= uint64_t(bits) << m_NrBits;
+			m_NrBits += nrBits;
+			//Codes are at most 16 bits, emptying 32 at a time keeps the appends rare
+			if (m_NrBits >= 32)
+			{
+				AppendLittleEndian(m_Output, uint32_t(m_Bits));
+				m_Bits >>= 32;
+				m_NrBits -= 32;
+			}
+		}
+
+		void Flush()
+		{
+			for (; m_NrBits > 0; m_NrBits -= std::min(m_NrBits, 8u))
+			{
+				m_Output.emplace_back(uint8_t(m_Bits));
+				m_Bits >>= 8;
+			}
+			m_Bits = 0;
+		}
+
+	private:
+		std::vector<uint8_t>& m_Output;
+		uint64_t m_Bits{};
+		uint32_t m_NrBits{};
+	};
+
+	uint32_t ReverseBits(uint32_t value, uint32_t nrBits)
+	{
+		uint32_t result{};
+		for (uint32_t bit{}; bit < nrBits; ++bit)
+			result |= ((value >> bit) & 1) << (nrBits - 1 - bit);
+		return result;
+	}
+
+	//Fixed Huffman codes of the literal/length alphabet (RFC 1951 3.2.6), bit reversed for the LSB-first stream
+	struct FixedCode
+	{
+		uint16_t code{};
+		uint16_t nrBits{};
+	};
+
+	const std::array<FixedCode, 288>& GetFixedCodes()
+	{
+		static const std::array<FixedCode, 288> codes{ []
+		{
+			std::array<FixedCode, 288> result{};
+			for (uint32_t symbol{}; symbol < 288; ++symbol)
+			{
+				uint32_t code{};
+				uint32_t nrBits{};
+				if (symbol < 144) { code = 0x30 + symbol; nrBits = 8; }
+				else if (symbol < 256) { code = 0x190 + symbol - 144; nrBits = 9; }
+				else if (symbol < 280) { code = symbol - 256; nrBits = 7; }
+				else { code = 0xC0 + symbol - 280; nrBits = 8; }
+				result[symbol] = { uint16_t(ReverseBits(code, nrBits)), uint16_t(nrBits) };
+			}
+			return result;
+		}() };
+		return codes;
+	}
+
+	void WriteMatch(BitWriter& writer, const std::array<FixedCode, 288>& codes, uint32_t length, uint32_t distance)
+	{
+		//Length 3..258: 8 single codes, then 4 codes per power of two with a growing number of extra bits
+		const uint32_t lengthOffset{ length - 3 };
+		if (length == 258)
+		{
+			writer.Write(codes[285].code, codes[285].nrBits);
+		}
+		else if (lengthOffset < 8)
+		{
+			writer.Write(codes[257 + lengthOffset].code, codes[257 + lengthOffset].nrBits);
+		}
+		else
+		{
+			const uint32_t highBit{ static_cast<uint32_t>(std::bit_width(lengthOffset)) - 1 };
+			const uint32_t nrExtraBits{ highBit - 2 };
+			const uint32_t symbol{ 257 + 4 * (highBit - 1) + ((lengthOffset >> nrExtraBits) & 3) };
+			writer.Write(codes[symbol].code, codes[symbol].nrBits);
+			writer.Write(lengthOffset & ((1u << nrExtraBits) - 1), nrExtraBits);
+		}
+
+		//Distance 1..32768: 4 single codes, then 2 codes per power of two, all codes are 5 bits
+		const uint32_t distanceOffset{ distance - 1 };
+		if (distanceOffset < 4)
+		{
+			writer.Write(ReverseBits(distanceOffset, 5), 5);
+		}
+		else
+		{
+			const uint32_t highBit{ static_cast<uint32_t>(std::bit_width(distanceOffset)) - 1 };
+			const uint32_t nrExtraBits{ highBit - 1 };
+			const uint32_t symbol{ 2 * highBit + ((distanceOffset >> nrExtraBits) & 1) };
+			writer.Write(ReverseBits(symbol, 5), 5);
+			writer.Write(distanceOffset & ((1u << nrExtraBits) - 1), nrExtraBits);
+		}
+	}
+
+	//One fixed Huffman block, greedy matches from a single hash probe: far from the best ratio, but cheap per byte
+	void DeflateFast(const uint8_t* pData, size_t size, std::vector<uint8_t>& output)
+	{
+		constexpr uint32_t hashBits{ 15 };
+		constexpr size_t windowSize{ 32768 };
+		constexpr size_t minMatch{ 4 };
+		constexpr size_t maxMatch{ 258 };
+
+		const std::array<FixedCode, 288>& codes{ GetFixedCodes() };
+		std::vector<uint32_t> lastPositions(size_t(1) << hashBits, UINT32_MAX);
+
+		BitWriter writer{ output };
+		//Final block, fixed codes
+		writer.Write(1, 1);
+		writer.Write(1, 2);
+
+		size_t position{};
+		while (position + minMatch <= size)
+		{
+			uint32_t word{};
+			std::memcpy(&word, pData + position, sizeof(word));
+			const uint32_t hash{ (word * 2654435761u) >> (32 - hashBits) };
+			const uint32_t candidate{ lastPositions[hash] };
+			lastPositions[hash] = static_cast<uint32_t>(position);
+
+			size_t length{};
+			if (candidate != UINT32_MAX && position - candidate <= windowSize && std::memcmp(pData + candidate, &word, sizeof(word)) == 0)
+			{
+				const size_t limit{ std::min(maxMatch, size - position) };
+				length = minMatch;
+				while (length < limit && pData[candidate + length] == pData[position + length])
+					++length;
+			}
+
+			if (length >= minMatch)
+			{
+				WriteMatch(writer, codes, static_cast<uint32_t>(length), static_cast<uint32_t>(position - candidate));
+				position += length;
+			}
+			else
+			{
+				writer.Write(codes[pData[position]].code, codes[pData[position]].nrBits);
+				++position;
+			}
+		}
+
+		for (; position < size; ++position)
+			writer.Write(codes[pData[position]].code, codes[pData[position]].nrBits);
+
+		writer.Write(codes[256].code, codes[256].nrBits);
+		writer.Flush();
+	}
+
+	//Stored blocks, the data is copied as is behind a 5 byte header per 64 KB
+	void DeflateStore(const uint8_t* pData, size_t size, std::vector<uint8_t>& output)
+	{
+		constexpr size_t maxBlockSize{ 65535 };
+		size_t position{};
+		do
+		{
+			const size_t blockSize{ std::min(maxBlockSize, size - position) };
+			const bool isFinal{ position + blockSize == size };
+			output.emplace_back(uint8_t(isFinal ? 1 : 0));
+			AppendLittleEndian(output, uint16_t(blockSize));
+			AppendLittleEndian(output, uint16_t(~blockSize));
+			AppendBytes(output, pData + position, blockSize);
+			position += blockSize;
+		} while (position < size);
+	}
+}
+
+ImageFormat ImageEncoders::GetImageFormat(const std::string& path)
+{
+	const size_t dot{ path.find_last_of('.') };
+	std::string extension{ dot == std::string::npos ? std::string{} : path.substr(dot + 1) };
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+	if (extension == "ppm") return ImageFormat::ppm;
+	if (extension == "pfm") return ImageFormat::pfm;
+	if (extension == "qoi") return ImageFormat::qoi;
+	if (extension == "png") return ImageFormat::png;
+	if (extension == "exr") return ImageFormat::exr;
+	return ImageFormat::bmp;
+}
+
+bool ImageEncoders::IsImageExtension(std::string extension)
+{
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return extension == "bmp" || GetImageFormat("." + extension) != ImageFormat::bmp;
+}
+
+bool ImageEncoders::IsFloatFormat(ImageFormat format)
+{
+	return format == ImageFormat::pfm || format == ImageFormat::exr;
+}
+
+void ImageEncoders::Encode(ImageFormat format, const uint8_t* pRgb, uint32_t width, uint32_t height, std::vector<uint8_t>& output)
+{
+	switch (format)
+	{
+	case ImageFormat::ppm:
+		EncodePpm(pRgb, width, height, output);
+		break;
+	case ImageFormat::qoi:
+		EncodeQoi(pRgb, width, height, output);
+		break;
+	case ImageFormat::pngStore:
+		EncodePng(pRgb, width, height, false, output);
+		break;
+	case ImageFormat::png:
+		EncodePng(pRgb, width, height, true, output);
+		break;
+	default:
+		EncodeBmp(pRgb, width, height, output);
+		break;
+	}
+}
+
+void ImageEncoders::Encode(ImageFormat format, const float* pRgb, uint32_t width, uint32_t height, std::vector<uint8_t>& output)
+{
+	if (format == ImageFormat::exr)
+		EncodeExr(pRgb, width, height, output);
+	else
+		EncodePfm(pRgb, width, height, output);
+}
+
+void ImageEncoders::EncodeBmp(const uint8_t* pRgb, uint32_t width, uint32_t height, std::vector<uint8_t>& output)
+{
+	constexpr uint32_t headerSize{ 54 };
+	const uint32_t rowSize{ (width * 3 + 3) & ~3u };
+	const uint32_t imageSize{ rowSize * height };
+
+	output.clear();
+	output.reserve(headerSize + imageSize);
+
+	//File header
+	AppendString(output, "BM");
+	AppendLittleEndian(output, headerSize + imageSize);
+	AppendLittleEndian(output, uint32_t{});
+	AppendLittleEndian(output, headerSize);
+
+	//BITMAPINFOHEADER, a positive height stores the rows bottom up
+	AppendLittleEndian(output, uint32_t{ 40 });
+	AppendLittleEndian(output, static_cast<int32_t>(width));
+	AppendLittleEndian(output, static_cast<int32_t>(height));
+	AppendLittleEndian(output, uint16_t{ 1 });
+	AppendLittleEndian(output, uint16_t{ 24 });
+	AppendLittleEndian(output, uint32_t{});
+	AppendLittleEndian(output, imageSize);
+	AppendLittleEndian(output, int32_t{ 2835 });
+	AppendLittleEndian(output, int32_t{ 2835 });
+	AppendLittleEndian(output, uint32_t{});
+	AppendLittleEndian(output, uint32_t{});
+
+	output.resize(headerSize + imageSize);
+	for (uint32_t row{}; row < height; ++row)
+	{
+		const uint8_t* pSource{ pRgb + size_t(height - 1 - row) * width * 3 };
+		uint8_t* pDestination{ &output[headerSize + size_t(row) * rowSize] };
+		for (uint32_t x{}; x < width; ++x)
+		{
+			pDestination[x * 3] = pSource[x * 3 + 2];
+			pDestination[x * 3 + 1] = pSource[x * 3 + 1];
+			pDestination[x * 3 + 2] = pSource[x * 3];
+		}
+		std::fill(pDestination + width * 3, pDestination + rowSize, uint8_t{});
+	}
+}
+
+void ImageEncoders::EncodePpm(const uint8_t* pRgb, uint32_t width, uint32_t height, std::vector<uint8_t>& output)
+{
+	output.clear();
+	AppendString(output, "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n");
+	AppendBytes(output, pRgb, size_t(width) * height * 3);
+}
+
+void ImageEncoders::EncodeQoi(const uint8_t* pRgb, uint32_t width, uint32_t height, std::vector<uint8_t>& output)
+{
+	//Op codes of the "Quite OK Image" format, every pixel is opaque so the RGBA op is never needed
+	constexpr uint8_t opIndex{ 0x00 };
+	constexpr uint8_t opDiff{ 0x40 };
+	constexpr uint8_t opLuma{ 0x80 };
+	constexpr uint8_t opRun{ 0xC0 };
+	constexpr uint8_t opRgb{ 0xFE };
+	constexpr uint32_t maxRun{ 62 };
+
+	struct Pixel
+	{
+		uint8_t r{}, g{}, b{}, a{};
+		bool operator==(const Pixel&) const = default;
+	};
+
+	const size_t nrPixels{ size_t(width) * height };
+	output.clear();
+	//Worst case is the 4 byte RGB op for every pixel
+	output.reserve(14 + nrPixels * 4 + 8);
+
+	AppendString(output, "qoif");
+	AppendBigEndian(output, width);
+	AppendBigEndian(output, height);
+	output.emplace_back(uint8_t{ 3 });
+	output.emplace_back(uint8_t{ 0 });
+
+	Pixel seen[64]{};
+	Pixel previous{ 0, 0, 0, 255 };
+	uint32_t run{};
+
+	for (size_t index{}; index < nrPixels; ++index)
+	{
+		const Pixel pixel{ pRgb[index * 3], pRgb[index * 3 + 1], pRgb[index * 3 + 2], 255 };
+
+		if (pixel == previous)
+		{
+			++run;
+			if (run == maxRun || index + 1 == nrPixels)
+			{
+				output.emplace_back(uint8_t(opRun | (run - 1)));
+				run = 0;
+			}
+			continue;
+		}
+
+		if (run > 0)
+		{
+			output.emplace_back(uint8_t(opRun | (run - 1)));
+			run = 0;
+		}
+
+		const uint32_t hash{ (pixel.r * 3u + pixel.g * 5u + pixel.b * 7u + pixel.a * 11u) % 64 };
+		if (seen[hash] == pixel)
+		{
+			output.emplace_back(uint8_t(opIndex | hash));
+		}
+		else
+		{
+			seen[hash] = pixel;
+
+			//Differences wrap around, as the format specifies
+			const int8_t dr{ static_cast<int8_t>(pixel.r - previous.r) };
+			const int8_t dg{ static_cast<int8_t>(pixel.g - previous.g) };
+			const int8_t db{ static_cast<int8_t>(pixel.b - previous.b) };
+			const int drg{ dr - dg };
+			const int dbg{ db - dg };
+
+			if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+			{
+				output.emplace_back(uint8_t(opDiff | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+			}
+			else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7)
+			{
+				output.emplace_back(uint8_t(opLuma | (dg + 32)));
+				output.emplace_back(uint8_t((drg + 8) << 4 | (dbg + 8)));
+			}
+			else
+			{
+				const uint8_t bytes[4]{ opRgb, pixel.r, pixel.g, pixel.b };
+				AppendBytes(output, bytes, sizeof(bytes));
+			}
+		}
+
+		previous = pixel;
+	}
+
+	const uint8_t endMarker[8]{ 0, 0, 0, 0, 0, 0, 0, 1 };
+	AppendBytes(output, endMarker, sizeof(endMarker));
+}
+
+void ImageEncoders::EncodePng(const uint8_t* pRgb, uint32_t width, uint32_t height, bool compress, std::vector<uint8_t>& output)
+{
+	const size_t rowSize{ size_t(width) * 3 };
+
+	//Every row starts with its filter type: none when storing, sub when compressing, which turns flat and
+	//slowly changing rows into runs of small values the LZ77 pass finds
+	std::vector<uint8_t> filtered(height * (rowSize + 1));
+	for (uint32_t row{}; row < height; ++row)
+	{
+		const uint8_t* pSource{ pRgb + row * rowSize };
+		uint8_t* pDestination{ &filtered[row * (rowSize + 1)] };
+		if (!compress)
+		{
+			pDestination[0] = 0;
+			std::memcpy(pDestination + 1, pSource, rowSize);
+			continue;
+		}
+
+		pDestination[0] = 1;
+		for (size_t index{}; index < rowSize; ++index)
+			pDestination[index + 1] = uint8_t(pSource[index] - (index >= 3 ? pSource[index - 3] : 0));
+	}
+
+	output.clear();
+	output.reserve(compress ? filtered.size() / 2 : filtered.size() + filtered.size() / 65535 * 5 + 64);
+
+	const uint8_t signature[8]{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	AppendBytes(output, signature, sizeof(signature));
+
+	size_t chunkStart{ output.size() };
+	AppendBigEndian(output, 0);
+	AppendString(output, "IHDR");
+	AppendBigEndian(output, width);
+	AppendBigEndian(output, height);
+	//8 bits per channel, truecolor, deflate, adaptive filtering, not interlaced
+	const uint8_t header[5]{ 8, 2, 0, 0, 0 };
+	AppendBytes(output, header, sizeof(header));
+	FinishPngChunk(output, chunkStart);
+
+	chunkStart = output.size();
+	AppendBigEndian(output, 0);
+	AppendString(output, "IDAT");
+	//zlib header: deflate with a 32 KB window, fastest compression level
+	output.emplace_back(uint8_t{ 0x78 });
+	output.emplace_back(uint8_t{ 0x01 });
+	if (compress)
+		DeflateFast(filtered.data(), filtered.size(), output);
+	else
+		DeflateStore(filtered.data(), filtered.size(), output);
+	AppendBigEndian(output, Adler32(filtered.data(), filtered.size()));
+	FinishPngChunk(output, chunkStart);
+
+	chunkStart = output.size();
+	AppendBigEndian(output, 0);
+	AppendString(output, "IEND");
+	FinishPngChunk(output, chunkStart);
+}
+
+void ImageEncoders::EncodePfm(const float* pRgb, uint32_t width, uint32_t height, std::vector<uint8_t>& output)
+{
+	//A negative scale marks little endian data, rows are stored bottom up
+	output.clear();
+	AppendString(output, "PF\n" + std::to_string(width) + " " + std::to_string(height) + "\n-1.0\n");
+
+	const size_t rowSize{ size_t(width) * 3 };
+	output.reserve(output.size() + rowSize * height * sizeof(float));
+	for (uint32_t row{}; row < height; ++row)
+		AppendBytes(output, pRgb + (height - 1 - row) * rowSize, rowSize * sizeof(float));
+}
+
+void ImageEncoders::EncodeExr(const float* pRgb, uint32_t width, uint32_t height, std::vector<uint8_t>& output)
+{
+	constexpr int32_t pixelTypeFloat{ 2 };
+
+	output.clear();
+
+	//Magic number, version 2, single part scanline file
+	AppendLittleEndian(output, uint32_t{ 20000630 });
+	AppendLittleEndian(output, uint32_t{ 2 });
+
+	//Channels are listed, and stored, in alphabetical order
+	const char* channelNames[3]{ "B", "G", "R" };
+	AppendName(output, "channels");
+	AppendName(output, "chlist");
+	AppendLittleEndian(output, int32_t{ 3 * 18 + 1 });
+	for (const char* pName : channelNames)
+	{
+		AppendName(output, pName);
+		AppendLittleEndian(output, pixelTypeFloat);
+		//Not perceptually linear, 3 reserved bytes, x and y sampling
+		AppendLittleEndian(output, uint32_t{});
+		AppendLittleEndian(output, int32_t{ 1 });
+		AppendLittleEndian(output, int32_t{ 1 });
+	}
+	output.emplace_back(uint8_t{});
+
+	AppendName(output, "compression");
+	AppendName(output, "compression");
+	AppendLittleEndian(output, int32_t{ 1 });
+	output.emplace_back(uint8_t{});
+
+	const int32_t window[4]{ 0, 0, static_cast<int32_t>(width) - 1, static_cast<int32_t>(height) - 1 };
+	for (const char* pName : { "dataWindow", "displayWindow" })
+	{
+		AppendName(output, pName);
+		AppendName(output, "box2i");
+		AppendLittleEndian(output, int32_t{ sizeof(window) });
+		AppendBytes(output, window, sizeof(window));
+	}
+
+	//Increasing y
+	AppendName(output, "lineOrder");
+	AppendName(output, "lineOrder");
+	AppendLittleEndian(output, int32_t{ 1 });
+	output.emplace_back(uint8_t{});
+
+	AppendName(output, "pixelAspectRatio");
+	AppendName(output, "float");
+	AppendLittleEndian(output, int32_t{ 4 });
+	AppendLittleEndian(output, 1.f);
+
+	AppendName(output, "screenWindowCenter");
+	AppendName(output, "v2f");
+	AppendLittleEndian(output, int32_t{ 8 });
+	AppendLittleEndian(output, 0.f);
+	AppendLittleEndian(output, 0.f);
+
+	AppendName(output, "screenWindowWidth");
+	AppendName(output, "float");
+	AppendLittleEndian(output, int32_t{ 4 });
+	AppendLittleEndian(output, 1.f);
+
+	//End of the header
+	output.emplace_back(uint8_t{});
+
+	//Offset table, uncompressed files have one scanline per chunk: y, data size, then every channel's row
+	const uint32_t dataSize{ width * 3 * static_cast<uint32_t>(sizeof(float)) };
+	const uint64_t firstChunk{ output.size() + uint64_t(height) * sizeof(uint64_t) };
+	output.reserve(firstChunk + uint64_t(height) * (8 + dataSize));
+	for (uint32_t row{}; row < height; ++row)
+		AppendLittleEndian(output, firstChunk + uint64_t(row) * (8 + dataSize));
+
+	for (uint32_t row{}; row < height; ++row)
+	{
+		AppendLittleEndian(output, static_cast<int32_t>(row));
+		AppendLittleEndian(output, dataSize);
+
+		const size_t rowStart{ output.size() };
+		output.resize(rowStart + dataSize);
+		uint8_t* pDestination{ &output[rowStart] };
+		const float* pSource{ pRgb + size_t(row) * width * 3 };
+		const size_t channelSize{ size_t(width) * sizeof(float) };
+		for (uint32_t x{}; x < width; ++x)
+		{
+			std::memcpy(pDestination + x * sizeof(float), &pSource[x * 3 + 2], sizeof(float));
+			std::memcpy(pDestination + channelSize + x * sizeof(float), &pSource[x * 3 + 1], sizeof(float));
+			std::memcpy(pDestination + 2 * channelSize + x * sizeof(float), &pSource[x * 3], sizeof(float));
+		}
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace dae
+{
+	enum class ImageFormat
+	{
+		bmp,
+		ppm,
+		pfm, //Portable float map, linear colors
+		qoi,
+		pngStore, //Uncompressed deflate blocks, the fastest valid PNG
+		png, //Sub filter and a single-probe LZ77 with the fixed Huffman codes
+		exr //Uncompressed scanline OpenEXR with 32-bit float channels, linear colors
+	};
+
+	namespace ImageEncoders
+	{
+		//Format from the extension of path, .png selects the compressed variant, unknown extensions write a BMP
+		ImageFormat GetImageFormat(const std::string& path);
+		//Whether extension (without the dot, in any case) is one GetImageFormat knows
+		bool IsImageExtension(std::string extension);
+		//Float formats keep the linear HDR colors, the others store the tone mapped pixels
+		bool IsFloatFormat(ImageFormat format);
+
+		//The encoders replace output with the complete file, its capacity is reused.
+		//8-bit input is tightly packed RGB rows, float input packed RGB triplets, top row first.
+		//The 8-bit dispatch writes every format but PFM and EXR, those come from the float one.
+		void Encode(ImageFormat format, const uint8_t* pRgb, uint32_t width, uint32_t height, std::vector<uint8_t>& output);
+		void Encode(ImageFormat format, const float* pRgb, uint32_t width, uint32_t height, std::vector<uint8_t>& output);
+
+		void EncodeBmp(const uint8_t* pRgb, uint32_t width, uint32_t height, std::vector<uint8_t>& output);
+		void EncodePpm(const uint8_t* pRgb, uint32_t width, uint32_t height, std::vector<uint8_t>& output);
+		void EncodeQoi(const uint8_t* pRgb, uint32_t width, uint32_t height, std::vector<uint8_t>& output);
+		void EncodePng(const uint8_t* pRgb, uint32_t width, uint32_t height, bool compress, std::vector<uint8_t>& output);
+		void EncodePfm(const float* pRgb, uint32_t width, uint32_t height, std::vector<uint8_t>& output);
+		void EncodeExr(const float* pRgb, uint32_t width, uint32_t height, std::vector<uint8_t>& output);
+	}
+}
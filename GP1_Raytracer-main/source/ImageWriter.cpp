@@ -0,0 +1,218 @@
+#include "ImageWriter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "SDL.h"
+
+using namespace dae;
+
+ImageWriter::ImageWriter(uint32_t nrBuffers) :
+	m_Jobs(nrBuffers > 0 ? nrBuffers : 1)
+{
+	for (Job& job : m_Jobs)
+		m_FreeJobs.emplace_back(&job);
+
+	m_Thread = std::thread{ &ImageWriter::WriterLoop, this };
+}
+
+ImageWriter::~ImageWriter()
+{
+	Flush();
+
+	{
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+		m_Quit = true;
+	}
+	m_JobQueued.notify_one();
+	m_Thread.join();
+}
+
+float ImageWriter::Write(const SDL_Surface* pSurface, const std::string& path)
+{
+	float waitTime{};
+	Job* pJob{ AcquireJob(pSurface->w, pSurface->h, path, waitTime) };
+
+	//The buffers keep their capacity, after the first frames a snapshot allocates nothing
+	const size_t rowSize{ static_cast<size_t>(pSurface->w) };
+	pJob->pixels.resize(rowSize * pSurface->h);
+	for (int row{}; row < pSurface->h; ++row)
+		std::memcpy(&pJob->pixels[row * rowSize], static_cast<const uint8_t*>(pSurface->pixels) + row * pSurface->pitch, rowSize * sizeof(uint32_t));
+
+	pJob->pixelFormat = pSurface->format->format;
+	pJob->hasColors = false;
+
+	QueueJob(pJob);
+	return waitTime;
+}
+
+float ImageWriter::Write(const ColorRGB* pColors, int width, int height, float scale, const std::string& path)
+{
+	float waitTime{};
+	Job* pJob{ AcquireJob(width, height, path, waitTime) };
+
+	pJob->colors.assign(pColors, pColors + static_cast<size_t>(width) * height);
+	pJob->scale = scale;
+	pJob->hasColors = true;
+
+	QueueJob(pJob);
+	return waitTime;
+}
+
+void ImageWriter::Flush()
+{
+	std::unique_lock<std::mutex> lock{ m_Mutex };
+	m_JobDone.wait(lock, [this] { return m_QueuedJobs.empty() && !m_IsWriting; });
+}
+
+ImageWriter::EncodeStats ImageWriter::GetEncodeStats()
+{
+	std::lock_guard<std::mutex> lock{ m_Mutex };
+	return m_EncodeStats;
+}
+
+ImageWriter::Job* ImageWriter::AcquireJob(int width, int height, const std::string& path, float& waitTime)
+{
+	const uint64_t waitStart{ SDL_GetPerformanceCounter() };
+
+	Job* pJob{};
+	{
+		std::unique_lock<std::mutex> lock{ m_Mutex };
+		m_JobDone.wait(lock, [this] { return !m_FreeJobs.empty(); });
+		pJob = m_FreeJobs.back();
+		m_FreeJobs.pop_back();
+	}
+
+	waitTime = static_cast<float>(SDL_GetPerformanceCounter() - waitStart) / SDL_GetPerformanceFrequency();
+
+	pJob->width = width;
+	pJob->height = height;
+	pJob->path = path;
+	pJob->format = ImageEncoders::GetImageFormat(path);
+	if (pJob->format == ImageFormat::png && !m_CompressPng)
+		pJob->format = ImageFormat::pngStore;
+
+	return pJob;
+}
+
+void ImageWriter::QueueJob(Job* pJob)
+{
+	{
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+		m_QueuedJobs.push(pJob);
+	}
+	m_JobQueued.notify_one();
+}
+
+void ImageWriter::WriterLoop()
+{
+	while (true)
+	{
+		Job* pJob{};
+		{
+			std::unique_lock<std::mutex> lock{ m_Mutex };
+			m_JobQueued.wait(lock, [this] { return m_Quit || !m_QueuedJobs.empty(); });
+
+			if (m_QueuedJobs.empty())
+				return;
+
+			pJob = m_QueuedJobs.front();
+			m_QueuedJobs.pop();
+			m_IsWriting = true;
+		}
+
+		const bool saved{ WriteJob(*pJob) };
+
+		{
+			std::lock_guard<std::mutex> lock{ m_Mutex };
+			saved ? ++m_NrWritten : ++m_NrFailed;
+			m_FreeJobs.emplace_back(pJob);
+			m_IsWriting = false;
+		}
+		m_JobDone.notify_all();
+	}
+}
+
+bool ImageWriter::WriteJob(const Job& job)
+{
+	const uint64_t encodeStart{ SDL_GetPerformanceCounter() };
+
+	const size_t nrPixels{ static_cast<size_t>(job.width) * job.height };
+	const bool isFloatFormat{ ImageEncoders::IsFloatFormat(job.format) };
+	const uint32_t width{ static_cast<uint32_t>(job.width) };
+	const uint32_t height{ static_cast<uint32_t>(job.height) };
+
+	//Surface pixels go through SDL's converter, which handles every layout a target can have
+	if (!job.hasColors)
+	{
+		m_Rgb.resize(nrPixels * 3);
+		if (SDL_ConvertPixels(job.width, job.height, job.pixelFormat, job.pixels.data(), job.width * static_cast<int>(sizeof(uint32_t)),
+			SDL_PIXELFORMAT_RGB24, m_Rgb.data(), job.width * 3) != 0)
+			return false;
+	}
+
+	if (isFloatFormat)
+	{
+		m_RgbFloat.resize(nrPixels * 3);
+		if (job.hasColors)
+		{
+			for (size_t index{}; index < nrPixels; ++index)
+			{
+				m_RgbFloat[index * 3] = job.colors[index].r * job.scale;
+				m_RgbFloat[index * 3 + 1] = job.colors[index].g * job.scale;
+				m_RgbFloat[index * 3 + 2] = job.colors[index].b * job.scale;
+			}
+		}
+		else
+		{
+			for (size_t index{}; index < nrPixels * 3; ++index)
+				m_RgbFloat[index] = m_Rgb[index] / 255.f;
+		}
+
+		ImageEncoders::Encode(job.format, m_RgbFloat.data(), width, height, m_Encoded);
+	}
+	else
+	{
+		if (job.hasColors)
+		{
+			m_Rgb.resize(nrPixels * 3);
+			const auto toChannel = [&job](float value) { return static_cast<uint8_t>(std::min(std::max(0.f, value * job.scale * 255), 255.f)); };
+			for (size_t index{}; index < nrPixels; ++index)
+			{
+				m_Rgb[index * 3] = toChannel(job.colors[index].r);
+				m_Rgb[index * 3 + 1] = toChannel(job.colors[index].g);
+				m_Rgb[index * 3 + 2] = toChannel(job.colors[index].b);
+			}
+		}
+
+		ImageEncoders::Encode(job.format, m_Rgb.data(), width, height, m_Encoded);
+	}
+
+	const double encodeTime{ static_cast<double>(SDL_GetPerformanceCounter() - encodeStart) / SDL_GetPerformanceFrequency() };
+	const uint64_t nrInputBytes{ nrPixels * 3 * (isFloatFormat ? sizeof(float) : sizeof(uint8_t)) };
+
+	std::ofstream file{ job.path, std::ios::binary };
+	file.write(reinterpret_cast<const char*>(m_Encoded.data()), static_cast<std::streamsize>(m_Encoded.size()));
+	const bool saved{ file.good() };
+
+	{
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+		++m_EncodeStats.nrImages;
+		m_EncodeStats.nrInputBytes += nrInputBytes;
+		m_EncodeStats.nrOutputBytes += m_Encoded.size();
+		m_EncodeStats.encodeTime += encodeTime;
+	}
+
+	if (m_LogWrites)
+	{
+		if (saved)
+			std::cout << "Saved " << job.path << ": " << m_Encoded.size() / 1024 << " KB, encoded in " << encodeTime * 1000.0 << " ms ("
+				<< (encodeTime > 0.0 ? nrInputBytes / encodeTime / 1'000'000.0 : 0.0) << " MB/s)" << std::endl;
+		else
+			std::cout << "Could not write " << job.path << std::endl;
+	}
+
+	return saved;
+}
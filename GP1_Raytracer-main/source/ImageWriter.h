@@ -0,0 +1,115 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ColorRGB.h"
+#include "ImageEncoders.h"
+
+struct SDL_Surface;
+
+namespace dae
+{
+	//Encodes and saves frames on a background thread. Write copies the frame into one of a fixed set of preallocated
+	//buffers and returns, so the render loop only waits when every buffer is still queued for the disk.
+	//The format follows the extension of the path, see ImageEncoders::GetImageFormat.
+	class ImageWriter final
+	{
+	public:
+		//Totals over every image encoded so far, the encode time excludes the disk
+		struct EncodeStats
+		{
+			uint32_t nrImages{};
+			//Size of the RGB input, 3 bytes per pixel for the 8-bit formats and 12 for the float ones
+			uint64_t nrInputBytes{};
+			uint64_t nrOutputBytes{};
+			double encodeTime{};
+
+			//Input megabytes encoded per second
+			double GetThroughput() const { return encodeTime > 0.0 ? nrInputBytes / encodeTime / 1'000'000.0 : 0.0; }
+		};
+
+		ImageWriter(uint32_t nrBuffers = 4);
+		//Writes everything that is still queued
+		~ImageWriter();
+
+		ImageWriter(const ImageWriter&) = delete;
+		ImageWriter(ImageWriter&&) noexcept = delete;
+		ImageWriter& operator=(const ImageWriter&) = delete;
+		ImageWriter& operator=(ImageWriter&&) noexcept = delete;
+
+		/**
+		 * \brief Queues a snapshot of the tone mapped surface. Float formats store its 8-bit values divided by 255.
+		 * \return seconds spent waiting for a free buffer
+		 */
+		float Write(const SDL_Surface* pSurface, const std::string& path);
+		/**
+		 * \brief Queues a snapshot of linear colors, for the float formats. 8-bit formats clamp them to [0, 1].
+		 * \param scale multiplies every color, e.g. one over the number of accumulated samples
+		 * \return seconds spent waiting for a free buffer
+		 */
+		float Write(const ColorRGB* pColors, int width, int height, float scale, const std::string& path);
+		//Blocks until the queue is empty
+		void Flush();
+
+		//.png files are compressed by default, without compression they are written as stored deflate blocks
+		void SetPngCompression(bool compress) { m_CompressPng = compress; }
+		//Prints a line per saved image with its size and encode throughput
+		void SetLogWrites(bool logWrites) { m_LogWrites = logWrites; }
+
+		uint32_t GetNrWritten() const { return m_NrWritten; }
+		uint32_t GetNrFailed() const { return m_NrFailed; }
+		EncodeStats GetEncodeStats();
+
+	private:
+		struct Job
+		{
+			//Either surface pixels in pixelFormat or linear colors
+			std::vector<uint32_t> pixels{};
+			uint32_t pixelFormat{};
+			std::vector<ColorRGB> colors{};
+			bool hasColors{ false };
+			float scale{ 1.f };
+			int width{};
+			int height{};
+			ImageFormat format{};
+			std::string path{};
+		};
+
+		std::vector<Job> m_Jobs{};
+		std::vector<Job*> m_FreeJobs{};
+		std::queue<Job*> m_QueuedJobs{};
+		bool m_IsWriting{ false };
+		bool m_Quit{ false };
+
+		bool m_CompressPng{ true };
+		std::atomic<bool> m_LogWrites{ false };
+
+		uint32_t m_NrWritten{};
+		uint32_t m_NrFailed{};
+		EncodeStats m_EncodeStats{};
+
+		//Writer thread only, keep their capacity between images
+		std::vector<uint8_t> m_Rgb{};
+		std::vector<float> m_RgbFloat{};
+		std::vector<uint8_t> m_Encoded{};
+
+		std::mutex m_Mutex{};
+		std::condition_variable m_JobQueued{};
+		std::condition_variable m_JobDone{};
+		std::thread m_Thread{};
+
+		//Waits for a free buffer and fills in the fields every job has
+		Job* AcquireJob(int width, int height, const std::string& path, float& waitTime);
+		void QueueJob(Job* pJob);
+
+		void WriterLoop();
+		//Converts, encodes and saves one job, returns false when the file could not be written
+		bool WriteJob(const Job& job);
+	};
+}
@@ -0,0 +1,78 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace dae;
+
+MappedFile::MappedFile(const std::string& path)
+{
+#ifdef _WIN32
+	const HANDLE file{ CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr) };
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+	m_FileHandle = file;
+
+	LARGE_INTEGER size{};
+	if (!GetFileSizeEx(file, &size))
+		return;
+
+	m_Size = static_cast<size_t>(size.QuadPart);
+	m_IsOpen = true;
+	if (m_Size == 0)
+		return;
+
+	m_MappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_MappingHandle)
+		m_pData = static_cast<const char*>(MapViewOfFile(m_MappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+	m_FileDescriptor = open(path.c_str(), O_RDONLY);
+	if (m_FileDescriptor < 0)
+		return;
+
+	struct stat status{};
+	if (fstat(m_FileDescriptor, &status) != 0)
+		return;
+
+	m_Size = static_cast<size_t>(status.st_size);
+	m_IsOpen = true;
+	if (m_Size == 0)
+		return;
+
+	void* pData{ mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, m_FileDescriptor, 0) };
+	if (pData != MAP_FAILED)
+	{
+		//The parsers read front to back
+		madvise(pData, m_Size, MADV_SEQUENTIAL);
+		m_pData = static_cast<const char*>(pData);
+	}
+#endif
+
+	//Mapping failed, a non-empty file without data is not usable
+	m_IsOpen = m_pData != nullptr;
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+	if (m_pData)
+		UnmapViewOfFile(m_pData);
+	if (m_MappingHandle)
+		CloseHandle(m_MappingHandle);
+	if (m_FileHandle)
+		CloseHandle(m_FileHandle);
+#else
+	if (m_pData)
+		munmap(const_cast<char*>(m_pData), m_Size);
+	if (m_FileDescriptor >= 0)
+		close(m_FileDescriptor);
+#endif
+}
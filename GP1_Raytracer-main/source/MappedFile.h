@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+namespace dae
+{
+	//Read-only memory mapping of a whole file, the pages are loaded by the OS as they are touched
+	class MappedFile final
+	{
+	public:
+		MappedFile(const std::string& path);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile(MappedFile&&) noexcept = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile& operator=(MappedFile&&) noexcept = delete;
+
+		//An empty file is open but has no data
+		bool IsOpen() const { return m_IsOpen; }
+		const char* GetData() const { return m_pData; }
+		size_t GetSize() const { return m_Size; }
+
+	private:
+		const char* m_pData{};
+		size_t m_Size{};
+		bool m_IsOpen{ false };
+
+#ifdef _WIN32
+		void* m_FileHandle{};
+		void* m_MappingHandle{};
+#else
+		int m_FileDescriptor{ -1 };
+#endif
+	};
+}
@@ -0,0 +1,318 @@
+#include "MeshCache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+
+#include "ObjLoader.h"
+
+using namespace dae;
+
+namespace
+{
+	constexpr char Magic[8]{ 'D', 'A', 'E', 'M', 'E', 'S', 'H', '\0' };
+
+	struct FileHeader
+	{
+		char magic[8]{};
+		uint32_t version{};
+		uint32_t nrMeshes{};
+		//Of the whole cache file, catches a write that didn't complete
+		uint64_t fileSize{};
+		uint64_t sourceSize{};
+		int64_t sourceWriteTime{};
+		uint64_t sourceHash{};
+		uint8_t padding[16]{};
+	};
+
+	//Offsets are from the start of the file
+	struct MeshEntry
+	{
+		uint64_t nameOffset{};
+		uint64_t materialNameOffset{};
+		uint64_t positionsOffset{};
+		uint64_t vertexNormalsOffset{};
+		uint64_t normalsOffset{};
+		uint64_t indicesOffset{};
+		uint32_t nameLength{};
+		uint32_t materialNameLength{};
+		uint32_t nrPositions{};
+		uint32_t nrVertexNormals{};
+		uint32_t nrTriangles{};
+		float minAABB[3]{};
+		float maxAABB[3]{};
+		uint32_t padding{};
+	};
+
+	static_assert(sizeof(FileHeader) == 64 && sizeof(MeshEntry) == 96, "The layout is part of the file format");
+	static_assert(std::is_trivially_copyable_v<Vector3> && sizeof(Vector3) == 12, "Positions are used straight from the file");
+
+	uint64_t AlignUp(uint64_t offset, uint64_t alignment)
+	{
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+
+	//FNV-1a over 8 byte words with a fold, it only has to notice edits
+	uint64_t HashData(const char* pData, size_t size)
+	{
+		constexpr uint64_t prime{ 1099511628211ull };
+		uint64_t hash{ 14695981039346656037ull };
+
+		size_t index{};
+		for (; index + sizeof(uint64_t) <= size; index += sizeof(uint64_t))
+		{
+			uint64_t word{};
+			std::memcpy(&word, pData + index, sizeof(word));
+			hash = (hash ^ word) * prime;
+			hash ^= hash >> 29;
+		}
+		for (; index < size; ++index)
+			hash = (hash ^ static_cast<uint8_t>(pData[index])) * prime;
+
+		return hash;
+	}
+
+	//Whether count elements of elementSize at offset lie within the file and are aligned for the element type
+	bool IsInFile(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t elementAlignment, uint64_t fileSize)
+	{
+		return offset % elementAlignment == 0 && offset <= fileSize && count <= (fileSize - offset) / elementSize;
+	}
+}
+
+MeshCache::MeshCache(const std::string& path)
+	: m_File{ path }
+{
+	if (!m_File.IsOpen() || m_File.GetSize() < sizeof(FileHeader))
+		return;
+
+	const char* pData{ m_File.GetData() };
+	const uint64_t size{ m_File.GetSize() };
+
+	FileHeader header{};
+	std::memcpy(&header, pData, sizeof(header));
+	if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version || header.fileSize != size
+		|| !IsInFile(sizeof(FileHeader), header.nrMeshes, sizeof(MeshEntry), alignof(MeshEntry), size))
+		return;
+
+	m_Source = SourceStamp{ header.sourceSize, header.sourceWriteTime, header.sourceHash };
+
+	//The contents are trusted beyond their structure, reading every index would touch every page of the mapping
+	m_Meshes.reserve(header.nrMeshes);
+	for (uint32_t index{}; index < header.nrMeshes; ++index)
+	{
+		MeshEntry entry{};
+		std::memcpy(&entry, pData + sizeof(FileHeader) + index * sizeof(MeshEntry), sizeof(entry));
+
+		const bool isValid{ IsInFile(entry.nameOffset, entry.nameLength, 1, 1, size)
+			&& IsInFile(entry.materialNameOffset, entry.materialNameLength, 1, 1, size)
+			&& IsInFile(entry.positionsOffset, entry.nrPositions, sizeof(Vector3), alignof(Vector3), size)
+			&& IsInFile(entry.vertexNormalsOffset, entry.nrVertexNormals, sizeof(Vector3), alignof(Vector3), size)
+			&& IsInFile(entry.normalsOffset, entry.nrTriangles, sizeof(Vector3), alignof(Vector3), size)
+			&& IsInFile(entry.indicesOffset, uint64_t{ entry.nrTriangles } * 3, sizeof(int), alignof(int), size)
+			&& (entry.nrVertexNormals == 0 || entry.nrVertexNormals == entry.nrPositions) };
+		if (!isValid)
+		{
+			m_Meshes.clear();
+			return;
+		}
+
+		MeshView& mesh{ m_Meshes.emplace_back() };
+		mesh.name = std::string_view{ pData + entry.nameOffset, entry.nameLength };
+		mesh.materialName = std::string_view{ pData + entry.materialNameOffset, entry.materialNameLength };
+		mesh.positions = std::span{ reinterpret_cast<const Vector3*>(pData + entry.positionsOffset), entry.nrPositions };
+		mesh.vertexNormals = std::span{ reinterpret_cast<const Vector3*>(pData + entry.vertexNormalsOffset), entry.nrVertexNormals };
+		mesh.normals = std::span{ reinterpret_cast<const Vector3*>(pData + entry.normalsOffset), entry.nrTriangles };
+		mesh.indices = std::span{ reinterpret_cast<const int*>(pData + entry.indicesOffset), size_t{ entry.nrTriangles } * 3 };
+		mesh.minAABB = Vector3{ entry.minAABB[0], entry.minAABB[1], entry.minAABB[2] };
+		mesh.maxAABB = Vector3{ entry.maxAABB[0], entry.maxAABB[1], entry.maxAABB[2] };
+	}
+
+	m_IsOpen = true;
+}
+
+std::string MeshCache::UpdateCache(const std::string& objPath)
+{
+	const std::string cachePath{ GetCachePath(objPath) };
+
+	SourceStamp stamp{};
+	if (!ReadStamp(objPath, stamp, false))
+	{
+		std::cout << "Could not open " << objPath << std::endl;
+		return {};
+	}
+
+	bool isCurrent{ false };
+	bool isTouched{ false };
+	{
+		const MeshCache cache{ cachePath };
+		if (cache.IsOpen() && cache.GetSource().size == stamp.size)
+		{
+			isCurrent = cache.GetSource().writeTime == stamp.writeTime;
+			if (!isCurrent && ReadStamp(objPath, stamp, true))
+				isCurrent = isTouched = cache.GetSource().hash == stamp.hash;
+		}
+	}
+
+	//Same contents, store the new time so the next start doesn't hash the file again
+	if (isTouched)
+	{
+		std::fstream file{ cachePath, std::ios::in | std::ios::out | std::ios::binary };
+		file.seekp(offsetof(FileHeader, sourceWriteTime));
+		file.write(reinterpret_cast<const char*>(&stamp.writeTime), sizeof(stamp.writeTime));
+	}
+
+	if (isCurrent)
+		return cachePath;
+
+	return Convert(objPath, cachePath) ? cachePath : std::string{};
+}
+
+bool MeshCache::Convert(const std::string& objPath, const std::string& cachePath)
+{
+	//Stamped before loading, an edit during the conversion makes the cache stale rather than wrong
+	SourceStamp stamp{};
+	if (!ReadStamp(objPath, stamp, true))
+	{
+		std::cout << "Could not open " << objPath << std::endl;
+		return false;
+	}
+
+	std::vector<ObjMesh> meshes{};
+	if (!ObjLoader{}.Load(objPath, meshes))
+		return false;
+
+	const auto writeStart{ std::chrono::steady_clock::now() };
+	if (!Write(cachePath, meshes, stamp))
+	{
+		std::cout << "Could not write " << cachePath << std::endl;
+		return false;
+	}
+
+	std::cout << "Wrote " << cachePath << " in "
+		<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - writeStart).count() << " ms" << std::endl;
+	return true;
+}
+
+bool MeshCache::Write(const std::string& path, const std::vector<ObjMesh>& meshes, const SourceStamp& source)
+{
+	//Lay out the table first, the data follows in the same order
+	std::vector<MeshEntry> entries(meshes.size());
+	uint64_t offset{ sizeof(FileHeader) + meshes.size() * sizeof(MeshEntry) };
+	for (size_t index{}; index < meshes.size(); ++index)
+	{
+		const ObjMesh& mesh{ meshes[index] };
+		MeshEntry& entry{ entries[index] };
+
+		entry.nameLength = static_cast<uint32_t>(mesh.name.size());
+		entry.materialNameLength = static_cast<uint32_t>(mesh.materialName.size());
+		entry.nrPositions = static_cast<uint32_t>(mesh.positions.size());
+		entry.nrVertexNormals = static_cast<uint32_t>(mesh.vertexNormals.size());
+		entry.nrTriangles = static_cast<uint32_t>(mesh.indices.size() / 3);
+
+		entry.nameOffset = offset;
+		offset += entry.nameLength;
+		entry.materialNameOffset = offset;
+		offset += entry.materialNameLength;
+		entry.positionsOffset = offset = AlignUp(offset, Alignment);
+		offset += mesh.positions.size() * sizeof(Vector3);
+		entry.vertexNormalsOffset = offset = AlignUp(offset, Alignment);
+		offset += mesh.vertexNormals.size() * sizeof(Vector3);
+		entry.normalsOffset = offset = AlignUp(offset, Alignment);
+		offset += mesh.normals.size() * sizeof(Vector3);
+		entry.indicesOffset = offset = AlignUp(offset, Alignment);
+		offset += mesh.indices.size() * sizeof(int);
+
+		if (!mesh.positions.empty())
+		{
+			Vector3 minAABB{ mesh.positions.front() };
+			Vector3 maxAABB{ minAABB };
+			for (const Vector3& position : mesh.positions)
+			{
+				minAABB = Vector3::Min(minAABB, position);
+				maxAABB = Vector3::Max(maxAABB, position);
+			}
+
+			std::memcpy(entry.minAABB, &minAABB, sizeof(entry.minAABB));
+			std::memcpy(entry.maxAABB, &maxAABB, sizeof(entry.maxAABB));
+		}
+	}
+
+	FileHeader header{};
+	std::memcpy(header.magic, Magic, sizeof(Magic));
+	header.version = Version;
+	header.nrMeshes = static_cast<uint32_t>(meshes.size());
+	header.fileSize = offset;
+	header.sourceSize = source.size;
+	header.sourceWriteTime = source.writeTime;
+	header.sourceHash = source.hash;
+
+	const std::string temporaryPath{ path + ".tmp" };
+	{
+		std::ofstream file{ temporaryPath, std::ios::binary | std::ios::trunc };
+		if (!file)
+			return false;
+
+		//Zero padding up to offset, then the data
+		uint64_t position{};
+		const auto writeAt = [&](uint64_t at, const void* pData, size_t size)
+		{
+			static constexpr char zeros[Alignment]{};
+			file.write(zeros, static_cast<std::streamsize>(at - position));
+			file.write(static_cast<const char*>(pData), static_cast<std::streamsize>(size));
+			position = at + size;
+		};
+
+		writeAt(0, &header, sizeof(header));
+		writeAt(position, entries.data(), entries.size() * sizeof(MeshEntry));
+		for (size_t index{}; index < meshes.size(); ++index)
+		{
+			const ObjMesh& mesh{ meshes[index] };
+			const MeshEntry& entry{ entries[index] };
+			writeAt(entry.nameOffset, mesh.name.data(), mesh.name.size());
+			writeAt(entry.materialNameOffset, mesh.materialName.data(), mesh.materialName.size());
+			writeAt(entry.positionsOffset, mesh.positions.data(), mesh.positions.size() * sizeof(Vector3));
+			writeAt(entry.vertexNormalsOffset, mesh.vertexNormals.data(), mesh.vertexNormals.size() * sizeof(Vector3));
+			writeAt(entry.normalsOffset, mesh.normals.data(), mesh.normals.size() * sizeof(Vector3));
+			writeAt(entry.indicesOffset, mesh.indices.data(), mesh.indices.size() * sizeof(int));
+		}
+
+		if (!file.flush())
+			return false;
+	}
+
+	std::error_code error{};
+	std::filesystem::rename(temporaryPath, path, error);
+	if (error)
+	{
+		std::filesystem::remove(temporaryPath, error);
+		return false;
+	}
+
+	return true;
+}
+
+bool MeshCache::ReadStamp(const std::string& path, SourceStamp& stamp, bool withHash)
+{
+	std::error_code error{};
+	stamp.size = std::filesystem::file_size(path, error);
+	if (error)
+		return false;
+	stamp.writeTime = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+	if (error)
+		return false;
+
+	if (withHash)
+	{
+		const MappedFile file{ path };
+		if (!file.IsOpen())
+			return false;
+		stamp.hash = HashData(file.GetData(), file.GetSize());
+	}
+
+	return true;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "MappedFile.h"
+#include "Vector3.h"
+
+namespace dae
+{
+	struct ObjMesh;
+
+	//Binary mesh file that is used in place through a read-only memory mapping, nothing is parsed or converted.
+	//A header (magic, version, stamp of the source OBJ) and a table with an entry per mesh are followed by the
+	//names and the positions, vertex normals, face normals and indices, every array aligned to a cache line.
+	//The file is written in the byte order of the machine, little endian on every platform the renderer runs on.
+	class MeshCache final
+	{
+	public:
+		//2: meshes are cleaned up (MeshCleanup) before they are written
+		static constexpr uint32_t Version{ 2 };
+
+		//What the cache was converted from, a differing size or write time makes it stale
+		struct SourceStamp
+		{
+			uint64_t size{};
+			int64_t writeTime{};
+			//Of the file contents, lets a cache survive a touch or a checkout that doesn't change the file
+			uint64_t hash{};
+		};
+
+		//Points into the mapping, valid as long as the MeshCache is
+		struct MeshView
+		{
+			std::string_view name{};
+			std::string_view materialName{};
+			std::span<const Vector3> positions{};
+			//Empty or one per position
+			std::span<const Vector3> vertexNormals{};
+			//One per triangle
+			std::span<const Vector3> normals{};
+			std::span<const int> indices{};
+			Vector3 minAABB{};
+			Vector3 maxAABB{};
+		};
+
+		//Maps the file and checks its structure, IsOpen is false for a missing, truncated or older file
+		MeshCache(const std::string& path);
+		~MeshCache() = default;
+
+		MeshCache(const MeshCache&) = delete;
+		MeshCache(MeshCache&&) noexcept = delete;
+		MeshCache& operator=(const MeshCache&) = delete;
+		MeshCache& operator=(MeshCache&&) noexcept = delete;
+
+		bool IsOpen() const { return m_IsOpen; }
+		const SourceStamp& GetSource() const { return m_Source; }
+		const std::vector<MeshView>& GetMeshes() const { return m_Meshes; }
+
+		//The cache lives next to the OBJ file, "bunny.obj" is cached as "bunny.obj.mesh"
+		static std::string GetCachePath(const std::string& objPath) { return objPath + ".mesh"; }
+
+		/**
+		 * \brief Makes sure the cache of objPath is current, converting the OBJ file when there is no cache yet,
+		 * it is from an older version or the OBJ file changed since.
+		 * \return path of the cache, empty when the OBJ file can't be loaded or the cache can't be written
+		 */
+		static std::string UpdateCache(const std::string& objPath);
+
+		//Loads objPath and writes its meshes to cachePath, whether or not it is current
+		static bool Convert(const std::string& objPath, const std::string& cachePath);
+
+		//Writes to a temporary file that replaces path once complete, a failed write leaves the old cache intact
+		static bool Write(const std::string& path, const std::vector<ObjMesh>& meshes, const SourceStamp& source);
+
+	private:
+		//Every array starts on a cache line
+		static constexpr uint64_t Alignment{ 64 };
+
+		MappedFile m_File;
+		bool m_IsOpen{ false };
+		SourceStamp m_Source{};
+		std::vector<MeshView> m_Meshes{};
+
+		//Size and write time, the hash only when withHash is set as it reads the whole file
+		static bool ReadStamp(const std::string& path, SourceStamp& stamp, bool withHash);
+	};
+}
@@ -0,0 +1,345 @@
+#include "MeshCleanup.h"
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <execution>
+#include <numeric>
+
+#define PARALLEL_EXECUTION
+
+using namespace dae;
+
+namespace
+{
+	using Triangle = std::array<int, 3>;
+
+	struct SortedTriangle
+	{
+		Triangle vertices{};
+		uint32_t index{};
+
+		auto operator<=>(const SortedTriangle&) const = default;
+	};
+
+	//Grid cells along an axis are limited so their coordinates, and a neighbour on either side, fit 21 bits of the key
+	constexpr float MaxCellsPerAxis{ static_cast<float>(1 << 20) };
+
+	bool IsFinite(const Vector3& vector)
+	{
+		return std::isfinite(vector.x) && std::isfinite(vector.y) && std::isfinite(vector.z);
+	}
+
+	uint64_t GetCellKey(int x, int y, int z)
+	{
+		return static_cast<uint64_t>(x & 0x1FFFFF) | static_cast<uint64_t>(y & 0x1FFFFF) << 21 | static_cast<uint64_t>(z & 0x1FFFFF) << 42;
+	}
+
+	//Open addressing map from cell key to the first vertex of the cell's list, a node based map spends most of the weld
+	//time allocating. Never holds more cells than vertices, so at most half full.
+	class CellMap final
+	{
+	public:
+		explicit CellMap(size_t nrVertices)
+		{
+			size_t capacity{ 16 };
+			while (capacity < nrVertices * 2)
+				capacity *= 2;
+
+			m_Keys.resize(capacity, EmptyKey);
+			m_Heads.resize(capacity, -1);
+			m_Mask = capacity - 1;
+		}
+
+		int Find(uint64_t key) const
+		{
+			for (size_t slot{ GetSlot(key) };; slot = (slot + 1) & m_Mask)
+			{
+				if (m_Keys[slot] == key)
+					return m_Heads[slot];
+				if (m_Keys[slot] == EmptyKey)
+					return -1;
+			}
+		}
+
+		int& operator[](uint64_t key)
+		{
+			size_t slot{ GetSlot(key) };
+			while (m_Keys[slot] != key && m_Keys[slot] != EmptyKey)
+				slot = (slot + 1) & m_Mask;
+
+			m_Keys[slot] = key;
+			return m_Heads[slot];
+		}
+
+	private:
+		//Cell keys use 63 bits
+		static constexpr uint64_t EmptyKey{ UINT64_MAX };
+
+		std::vector<uint64_t> m_Keys{};
+		std::vector<int> m_Heads{};
+		size_t m_Mask{};
+
+		size_t GetSlot(uint64_t key) const
+		{
+			return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & m_Mask;
+		}
+	};
+
+	//Moves the lower 10 bits apart so two zero bits follow each one
+	uint32_t SpreadBits(uint32_t value)
+	{
+		value &= 0x3FF;
+		value = (value | value << 16) & 0x030000FF;
+		value = (value | value << 8) & 0x0300F00F;
+		value = (value | value << 4) & 0x030C30C3;
+		value = (value | value << 2) & 0x09249249;
+		return value;
+	}
+
+	//Maps every vertex to an earlier one within weldDistance whose normal agrees, or to itself. Vertices are kept in a grid
+	//of cells at least twice the weld distance, so a match can only be in a neighbouring cell along the axes where the
+	//vertex is that close to the border of its own cell. Mostly that is no axis and only one cell is searched.
+	std::vector<int> Weld(const std::vector<Vector3>& positions, const std::vector<Vector3>& vertexNormals, const Vector3& minBounds,
+		float weldDistance, float cellSize, float normalTolerance, size_t& nrWelded)
+	{
+		std::vector<int> remap(positions.size());
+		std::iota(remap.begin(), remap.end(), 0);
+		if (weldDistance <= 0.f)
+			return remap;
+
+		CellMap cellHeads{ positions.size() };
+		std::vector<int> nextInCell(positions.size(), -1);
+		const float sqrWeldDistance{ weldDistance * weldDistance };
+		const float borderFraction{ weldDistance / cellSize };
+		const bool hasNormals{ !vertexNormals.empty() };
+
+		for (int vertex{}; vertex < static_cast<int>(positions.size()); ++vertex)
+		{
+			const Vector3& position{ positions[vertex] };
+			if (!IsFinite(position))
+				continue;
+
+			const Vector3 cell{ (position - minBounds) / cellSize };
+			int cellCoordinates[3]{};
+			int neighbourOffsets[3]{};
+			for (int axis{}; axis < 3; ++axis)
+			{
+				cellCoordinates[axis] = static_cast<int>(cell[axis]);
+				const float fraction{ cell[axis] - static_cast<float>(cellCoordinates[axis]) };
+				neighbourOffsets[axis] = fraction < borderFraction ? -1 : fraction > 1.f - borderFraction ? 1 : 0;
+			}
+
+			//Bit n of the mask steps into the neighbour along axis n
+			int match{ -1 };
+			for (int mask{}; mask < 8 && match < 0; ++mask)
+			{
+				if ((mask & 1 && !neighbourOffsets[0]) || (mask & 2 && !neighbourOffsets[1]) || (mask & 4 && !neighbourOffsets[2]))
+					continue;
+
+				const int cellHead{ cellHeads.Find(GetCellKey(cellCoordinates[0] + (mask & 1 ? neighbourOffsets[0] : 0),
+					cellCoordinates[1] + (mask & 2 ? neighbourOffsets[1] : 0), cellCoordinates[2] + (mask & 4 ? neighbourOffsets[2] : 0))) };
+
+				for (int other{ cellHead }; other >= 0; other = nextInCell[other])
+				{
+					if ((positions[other] - position).SqrMagnitude() <= sqrWeldDistance
+						&& (!hasNormals || Vector3::Dot(vertexNormals[other], vertexNormals[vertex]) >= normalTolerance))
+					{
+						match = other;
+						break;
+					}
+				}
+			}
+
+			if (match >= 0)
+			{
+				remap[vertex] = match;
+				++nrWelded;
+				continue;
+			}
+
+			int& cellHead{ cellHeads[GetCellKey(cellCoordinates[0], cellCoordinates[1], cellCoordinates[2])] };
+			nextInCell[vertex] = cellHead;
+			cellHead = vertex;
+		}
+
+		return remap;
+	}
+}
+
+MeshCleanup::Statistics& MeshCleanup::Statistics::operator+=(const Statistics& other)
+{
+	nrWeldedVertices += other.nrWeldedVertices;
+	nrDegenerateTriangles += other.nrDegenerateTriangles;
+	nrDuplicateTriangles += other.nrDuplicateTriangles;
+	nrUnusedVertices += other.nrUnusedVertices;
+	return *this;
+}
+
+MeshCleanup::Statistics MeshCleanup::Clean(std::vector<Vector3>& positions, std::vector<Vector3>& vertexNormals, std::vector<int>& indices, const Settings& settings)
+{
+	Statistics statistics{};
+
+	Vector3 minBounds{ FLT_MAX, FLT_MAX, FLT_MAX };
+	Vector3 maxBounds{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (const Vector3& position : positions)
+	{
+		if (!IsFinite(position))
+			continue;
+
+		minBounds = Vector3::Min(minBounds, position);
+		maxBounds = Vector3::Max(maxBounds, position);
+	}
+
+	if (minBounds.x > maxBounds.x)
+		minBounds = maxBounds = Vector3{};
+
+	const Vector3 extent{ maxBounds - minBounds };
+	const float diagonal{ extent.Magnitude() };
+	const float weldDistance{ settings.weldTolerance * diagonal };
+	const float cellSize{ std::max(2.f * weldDistance, diagonal / MaxCellsPerAxis) };
+
+	const std::vector<int> remap{ Weld(positions, vertexNormals, minBounds, weldDistance, cellSize, settings.normalTolerance, statistics.nrWeldedVertices) };
+
+	//Welded corners, rotated so the smallest index comes first without changing the winding
+	std::vector<Triangle> triangles{};
+	triangles.reserve(indices.size() / 3);
+	const float sqrWeldDistance{ weldDistance * weldDistance };
+
+	for (size_t index{}; index + 2 < indices.size(); index += 3)
+	{
+		const int a{ remap[indices[index]] };
+		const int b{ remap[indices[index + 1]] };
+		const int c{ remap[indices[index + 2]] };
+
+		//The height over the longest edge is twice the area divided by that edge, compared squared. NaN fails the first test.
+		const Vector3 edgeAB{ positions[b] - positions[a] };
+		const Vector3 edgeAC{ positions[c] - positions[a] };
+		const Vector3 edgeBC{ positions[c] - positions[b] };
+		const float sqrDoubleArea{ Vector3::Cross(edgeAB, edgeAC).SqrMagnitude() };
+		const float sqrLongestEdge{ std::max({ edgeAB.SqrMagnitude(), edgeAC.SqrMagnitude(), edgeBC.SqrMagnitude() }) };
+
+		if (a == b || b == c || a == c || !(sqrDoubleArea > 0.f) || sqrDoubleArea <= sqrWeldDistance * sqrLongestEdge)
+		{
+			++statistics.nrDegenerateTriangles;
+			continue;
+		}
+
+		if (b < a && b < c)
+			triangles.emplace_back(Triangle{ b, c, a });
+		else if (c < a && c < b)
+			triangles.emplace_back(Triangle{ c, a, b });
+		else
+			triangles.emplace_back(Triangle{ a, b, c });
+	}
+
+	//Equal triangles end up next to each other, the first one in the file is kept
+	std::vector<SortedTriangle> sortedTriangles(triangles.size());
+	for (uint32_t triangle{}; triangle < triangles.size(); ++triangle)
+		sortedTriangles[triangle] = SortedTriangle{ triangles[triangle], triangle };
+
+#ifdef PARALLEL_EXECUTION
+	std::sort(std::execution::par, sortedTriangles.begin(), sortedTriangles.end());
+#else
+	std::sort(sortedTriangles.begin(), sortedTriangles.end());
+#endif
+
+	std::vector<bool> isDuplicate(triangles.size(), false);
+	for (size_t index{ 1 }; index < sortedTriangles.size(); ++index)
+	{
+		if (sortedTriangles[index].vertices == sortedTriangles[index - 1].vertices)
+			isDuplicate[sortedTriangles[index].index] = true;
+	}
+
+	std::vector<uint32_t> keptTriangles{};
+	keptTriangles.reserve(triangles.size());
+	for (uint32_t triangle{}; triangle < triangles.size(); ++triangle)
+	{
+		if (!isDuplicate[triangle])
+			keptTriangles.emplace_back(triangle);
+	}
+	statistics.nrDuplicateTriangles = triangles.size() - keptTriangles.size();
+
+	if (settings.reorder)
+	{
+		//Morton code of the centroid, 10 bits per axis of the bounds
+		std::vector<uint64_t> sortKeys(keptTriangles.size());
+		const Vector3 scale{ extent.x > 0.f ? 1023.f / extent.x : 0.f, extent.y > 0.f ? 1023.f / extent.y : 0.f, extent.z > 0.f ? 1023.f / extent.z : 0.f };
+
+		for (size_t index{}; index < keptTriangles.size(); ++index)
+		{
+			const Triangle& triangle{ triangles[keptTriangles[index]] };
+			const Vector3 centroid{ (positions[triangle[0]] + positions[triangle[1]] + positions[triangle[2]]) / 3.f - minBounds };
+			const uint32_t code{ SpreadBits(static_cast<uint32_t>(centroid.x * scale.x)) | SpreadBits(static_cast<uint32_t>(centroid.y * scale.y)) << 1
+				| SpreadBits(static_cast<uint32_t>(centroid.z * scale.z)) << 2 };
+			sortKeys[index] = static_cast<uint64_t>(code) << 32 | keptTriangles[index];
+		}
+
+#ifdef PARALLEL_EXECUTION
+		std::sort(std::execution::par, sortKeys.begin(), sortKeys.end());
+#else
+		std::sort(sortKeys.begin(), sortKeys.end());
+#endif
+
+		for (size_t index{}; index < keptTriangles.size(); ++index)
+			keptTriangles[index] = static_cast<uint32_t>(sortKeys[index]);
+	}
+
+	//Vertices are numbered in order of first use when reordering, in their old order otherwise
+	std::vector<int> vertexIndices(positions.size(), -1);
+	int nrVertices{};
+	if (settings.reorder)
+	{
+		for (const uint32_t triangle : keptTriangles)
+		{
+			for (const int vertex : triangles[triangle])
+			{
+				if (vertexIndices[vertex] < 0)
+					vertexIndices[vertex] = nrVertices++;
+			}
+		}
+	}
+	else
+	{
+		for (const uint32_t triangle : keptTriangles)
+		{
+			for (const int vertex : triangles[triangle])
+				vertexIndices[vertex] = 0;
+		}
+
+		for (int& vertexIndex : vertexIndices)
+		{
+			if (vertexIndex == 0)
+				vertexIndex = nrVertices++;
+		}
+	}
+
+	std::vector<Vector3> cleanPositions(nrVertices);
+	std::vector<Vector3> cleanVertexNormals(vertexNormals.empty() ? 0 : nrVertices);
+	for (size_t vertex{}; vertex < vertexIndices.size(); ++vertex)
+	{
+		if (vertexIndices[vertex] < 0)
+			continue;
+
+		cleanPositions[vertexIndices[vertex]] = positions[vertex];
+		if (!vertexNormals.empty())
+			cleanVertexNormals[vertexIndices[vertex]] = vertexNormals[vertex];
+	}
+
+	std::vector<int> cleanIndices{};
+	cleanIndices.reserve(keptTriangles.size() * 3);
+	for (const uint32_t triangle : keptTriangles)
+	{
+		for (const int vertex : triangles[triangle])
+			cleanIndices.emplace_back(vertexIndices[vertex]);
+	}
+
+	statistics.nrUnusedVertices = positions.size() - statistics.nrWeldedVertices - cleanPositions.size();
+
+	positions = std::move(cleanPositions);
+	vertexNormals = std::move(cleanVertexNormals);
+	indices = std::move(cleanIndices);
+	return statistics;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+#include "Vector3.h"
+
+namespace dae
+{
+	//Load time repair of indexed triangle meshes, the OBJ loader runs it on every mesh it builds
+	namespace MeshCleanup
+	{
+		struct Settings
+		{
+			//Vertices closer than this fraction of the bounding box diagonal are welded, 0 only drops collapsed triangles
+			float weldTolerance{ 1e-6f };
+			//Minimum cosine between the vertex normals of vertices that are welded, keeps hard edges apart
+			float normalTolerance{ 0.9999f };
+			//Sorts the triangles along a Morton curve of their centroids and numbers the vertices in order of first use
+			bool reorder{ true };
+		};
+
+		struct Statistics
+		{
+			size_t nrWeldedVertices{};
+			size_t nrDegenerateTriangles{};
+			size_t nrDuplicateTriangles{};
+			//Only referenced by removed triangles
+			size_t nrUnusedVertices{};
+
+			Statistics& operator+=(const Statistics& other);
+		};
+
+		/**
+		 * \brief Welds vertices, removes degenerate and duplicate triangles and drops the vertices nothing refers to.
+		 * A triangle is degenerate when it is thinner than the weld distance over its longest edge, which includes
+		 * triangles whose corners were welded together. Those would get a NaN normal. A duplicate uses the same
+		 * vertices in the same winding as an earlier triangle, the reversed winding is a back face and stays.
+		 * \param vertexNormals one per position or empty, kept in step with positions
+		 * \param indices 3 per triangle
+		 */
+		Statistics Clean(std::vector<Vector3>& positions, std::vector<Vector3>& vertexNormals, std::vector<int>& indices, const Settings& settings = {});
+	}
+}
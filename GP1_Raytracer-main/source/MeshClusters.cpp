@@ -0,0 +1,495 @@
+#include "MeshClusters.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+#include <utility>
+
+#include "DataTypes.h"
+#include "GeometryCache.h"
+#include "Utils.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace dae;
+
+namespace
+{
+	constexpr char Magic[8]{ 'D', 'A', 'E', 'C', 'L', 'U', 'S', 'T' };
+
+	struct FileHeader
+	{
+		char magic[8]{};
+		uint32_t version{};
+		uint32_t pageSize{};
+		uint32_t nrMeshes{};
+		uint32_t nrClusters{};
+		//Of the whole file, catches a write that didn't complete
+		uint64_t fileSize{};
+		//The first cluster, the tables and names come before it
+		uint64_t dataOffset{};
+		//Of the OBJ file the mesh cache was converted from
+		uint64_t sourceSize{};
+		uint64_t sourceHash{};
+		uint8_t padding[8]{};
+	};
+
+	struct MeshRecord
+	{
+		uint64_t nameOffset{};
+		uint64_t materialNameOffset{};
+		uint32_t nameLength{};
+		uint32_t materialNameLength{};
+		uint32_t firstCluster{};
+		uint32_t nrClusters{};
+		uint32_t nrTriangles{};
+		uint32_t hasVertexNormals{};
+		float minAABB[3]{};
+		float maxAABB[3]{};
+	};
+
+	struct ClusterRecord
+	{
+		float minAABB[3]{};
+		float maxAABB[3]{};
+		uint32_t nrTriangles{};
+		uint32_t padding{};
+	};
+
+	static_assert(sizeof(FileHeader) == 64 && sizeof(MeshRecord) == 64 && sizeof(ClusterRecord) == 32, "The layout is part of the file format");
+	static_assert(std::is_trivially_copyable_v<Vector3> && sizeof(Vector3) == 12, "Pages are read straight into Vector3s");
+
+	uint64_t AlignUp(uint64_t offset, uint64_t alignment)
+	{
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+
+	uint32_t GetTrianglesPerPage(bool hasVertexNormals)
+	{
+		return MeshClusters::PageSize / static_cast<uint32_t>((hasVertexNormals ? 7 : 4) * sizeof(Vector3));
+	}
+
+	//Distance along the ray to where it enters the box, false when it misses it or only enters beyond maxT
+	bool SlabTest(const Vector3& minAABB, const Vector3& maxAABB, const Ray& ray, const Vector3& inverseDirection, float maxT, float& entryT)
+	{
+		float nearT{ ray.min };
+		float farT{ maxT };
+		for (int axis{}; axis < 3; ++axis)
+		{
+			float t0{ (minAABB[axis] - ray.origin[axis]) * inverseDirection[axis] };
+			float t1{ (maxAABB[axis] - ray.origin[axis]) * inverseDirection[axis] };
+			if (t0 > t1)
+				std::swap(t0, t1);
+
+			nearT = std::max(nearT, t0);
+			farT = std::min(farT, t1);
+		}
+
+		entryT = nearT;
+		return nearT <= farT;
+	}
+}
+
+//Positional reads, so the render threads can fault pages of the same file at once without sharing a file position
+class MeshClusters::File final
+{
+public:
+	File(const std::string& path, uint64_t dataOffset) :
+		m_DataOffset{ dataOffset },
+		m_SourceId{ GeometryCache::GetInstance().NewSourceId() }
+	{
+#ifdef _WIN32
+		const HANDLE file{ CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr) };
+		if (file != INVALID_HANDLE_VALUE)
+			m_FileHandle = file;
+#else
+		m_FileDescriptor = open(path.c_str(), O_RDONLY);
+#endif
+	}
+
+	~File()
+	{
+		GeometryCache::GetInstance().Release(m_SourceId);
+
+#ifdef _WIN32
+		if (m_FileHandle)
+			CloseHandle(m_FileHandle);
+#else
+		if (m_FileDescriptor >= 0)
+			close(m_FileDescriptor);
+#endif
+	}
+
+	File(const File&) = delete;
+	File(File&&) noexcept = delete;
+	File& operator=(const File&) = delete;
+	File& operator=(File&&) noexcept = delete;
+
+#ifdef _WIN32
+	bool IsOpen() const { return m_FileHandle != nullptr; }
+#else
+	bool IsOpen() const { return m_FileDescriptor >= 0; }
+#endif
+	uint32_t GetSourceId() const { return m_SourceId; }
+
+	bool Read(uint32_t pageIndex, void* pData, size_t size) const
+	{
+		const uint64_t offset{ m_DataOffset + static_cast<uint64_t>(pageIndex) * PageSize };
+
+#ifdef _WIN32
+		OVERLAPPED overlapped{};
+		overlapped.Offset = static_cast<DWORD>(offset);
+		overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+		DWORD nrBytesRead{};
+		return ReadFile(m_FileHandle, pData, static_cast<DWORD>(size), &nrBytesRead, &overlapped) && nrBytesRead == size;
+#else
+		return pread(m_FileDescriptor, pData, size, static_cast<off_t>(offset)) == static_cast<ssize_t>(size);
+#endif
+	}
+
+private:
+	uint64_t m_DataOffset{};
+	uint32_t m_SourceId{};
+
+#ifdef _WIN32
+	void* m_FileHandle{};
+#else
+	int m_FileDescriptor{ -1 };
+#endif
+};
+
+MeshClusters::~MeshClusters() = default;
+
+bool MeshClusters::HitTest(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord) const
+{
+	//The direction isn't normalized, t stays the distance along the world ray
+	const Ray localRay{ mesh.inverseTransform.TransformPoint(ray.origin), mesh.inverseTransform.TransformVector(ray.direction), ray.min, ray.max };
+	const Vector3 inverseDirection{ 1.f / localRay.direction.x, 1.f / localRay.direction.y, 1.f / localRay.direction.z };
+
+	//Clusters the ray enters before the closest hit so far. Nearest first for closest hits, the remaining ones are
+	//skipped once a hit is closer than where they start, and are never paged in.
+	thread_local std::vector<std::pair<float, uint32_t>> candidates{};
+	candidates.clear();
+
+	const float maxT{ std::min(hitRecord.t, ray.max) };
+	for (uint32_t index{}; index < m_Clusters.size(); ++index)
+	{
+		float entryT{};
+		if (SlabTest(m_Clusters[index].minAABB, m_Clusters[index].maxAABB, localRay, inverseDirection, maxT, entryT))
+			candidates.emplace_back(entryT, index);
+	}
+
+	if (!ignoreHitRecord)
+		std::sort(candidates.begin(), candidates.end());
+
+	Triangle triangle{};
+	triangle.cullMode = mesh.cullMode;
+	triangle.materialIndex = mesh.materialIndex;
+	const uint32_t stride{ GetStride() };
+	bool isHit{ false };
+
+	for (const auto& [entryT, index] : candidates)
+	{
+		if (entryT > hitRecord.t)
+			break;
+
+		const Cluster& cluster{ m_Clusters[index] };
+		const std::shared_ptr<const GeometryCache::Page> pPage{ GeometryCache::GetInstance().Acquire(m_pFile->GetSourceId(), cluster.pageIndex,
+			[this, &cluster, stride](GeometryCache::Page& page)
+			{
+				page.resize(static_cast<size_t>(cluster.nrTriangles) * stride);
+				return m_pFile->Read(cluster.pageIndex, page.data(), page.size() * sizeof(Vector3));
+			}) };
+
+		if (!pPage)
+			continue;
+
+		const Vector3* pTriangle{ pPage->data() };
+		for (uint32_t triangleIndex{}; triangleIndex < cluster.nrTriangles; ++triangleIndex, pTriangle += stride)
+		{
+			triangle.v0 = pTriangle[0];
+			triangle.v1 = pTriangle[1];
+			triangle.v2 = pTriangle[2];
+			triangle.normal = pTriangle[3];
+
+			if (!GeometryUtils::HitTest_Triangle(triangle, localRay, hitRecord, ignoreHitRecord))
+				continue;
+
+			if (ignoreHitRecord)
+				return true;
+
+			isHit = true;
+			if (!m_HasVertexNormals)
+				continue;
+
+			hitRecord.normal = GeometryUtils::InterpolateNormal(triangle, hitRecord.origin, pTriangle[4], pTriangle[5], pTriangle[6]);
+		}
+	}
+
+	//Back to world space, once for the closest hit
+	if (isHit)
+	{
+		hitRecord.origin = ray.origin + ray.direction * hitRecord.t;
+		hitRecord.normal = mesh.finalTransform.TransformVector(hitRecord.normal).Normalized();
+	}
+
+	return hitRecord.didHit;
+}
+
+std::string MeshClusters::UpdateClusters(const std::string& objPath)
+{
+	const std::string cachePath{ MeshCache::UpdateCache(objPath) };
+	if (cachePath.empty())
+		return {};
+
+	const MeshCache cache{ cachePath };
+	if (!cache.IsOpen())
+	{
+		std::cout << "Could not read " << cachePath << std::endl;
+		return {};
+	}
+
+	//The mesh cache always has the hash of the OBJ file, its write time may have been updated since
+	const std::string clusterPath{ GetClusterPath(objPath) };
+	MeshCache::SourceStamp source{};
+	if (ReadSource(clusterPath, source) && source.size == cache.GetSource().size && source.hash == cache.GetSource().hash)
+		return clusterPath;
+
+	const auto writeStart{ std::chrono::steady_clock::now() };
+	if (!Write(clusterPath, cache))
+	{
+		std::cout << "Could not write " << clusterPath << std::endl;
+		return {};
+	}
+
+	std::cout << "Wrote " << clusterPath << " in "
+		<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - writeStart).count() << " ms" << std::endl;
+	return clusterPath;
+}
+
+bool MeshClusters::Write(const std::string& clusterPath, const MeshCache& cache)
+{
+	const std::vector<MeshCache::MeshView>& meshes{ cache.GetMeshes() };
+
+	//Tables first, the names follow them and the clusters start on the next page
+	std::vector<MeshRecord> meshRecords(meshes.size());
+	uint32_t nrClusters{};
+	uint64_t namesSize{};
+	for (size_t index{}; index < meshes.size(); ++index)
+	{
+		const MeshCache::MeshView& mesh{ meshes[index] };
+		MeshRecord& record{ meshRecords[index] };
+
+		const uint32_t trianglesPerPage{ GetTrianglesPerPage(!mesh.vertexNormals.empty()) };
+		record.nrTriangles = static_cast<uint32_t>(mesh.normals.size());
+		record.hasVertexNormals = mesh.vertexNormals.empty() ? 0 : 1;
+		record.firstCluster = nrClusters;
+		record.nrClusters = (record.nrTriangles + trianglesPerPage - 1) / trianglesPerPage;
+		record.nameLength = static_cast<uint32_t>(mesh.name.size());
+		record.materialNameLength = static_cast<uint32_t>(mesh.materialName.size());
+		std::memcpy(record.minAABB, &mesh.minAABB, sizeof(record.minAABB));
+		std::memcpy(record.maxAABB, &mesh.maxAABB, sizeof(record.maxAABB));
+
+		nrClusters += record.nrClusters;
+		namesSize += record.nameLength + record.materialNameLength;
+	}
+
+	uint64_t nameOffset{ sizeof(FileHeader) + meshRecords.size() * sizeof(MeshRecord) + static_cast<uint64_t>(nrClusters) * sizeof(ClusterRecord) };
+	for (size_t index{}; index < meshes.size(); ++index)
+	{
+		meshRecords[index].nameOffset = nameOffset;
+		nameOffset += meshRecords[index].nameLength;
+		meshRecords[index].materialNameOffset = nameOffset;
+		nameOffset += meshRecords[index].materialNameLength;
+	}
+
+	FileHeader header{};
+	std::memcpy(header.magic, Magic, sizeof(Magic));
+	header.version = Version;
+	header.pageSize = PageSize;
+	header.nrMeshes = static_cast<uint32_t>(meshes.size());
+	header.nrClusters = nrClusters;
+	header.dataOffset = AlignUp(nameOffset, PageSize);
+	header.fileSize = header.dataOffset + static_cast<uint64_t>(nrClusters) * PageSize;
+	header.sourceSize = cache.GetSource().size;
+	header.sourceHash = cache.GetSource().hash;
+
+	//The clusters are built before the table is written, a table record per cluster is kept until then
+	std::vector<ClusterRecord> clusterRecords{};
+	clusterRecords.reserve(nrClusters);
+
+	const std::string temporaryPath{ clusterPath + ".tmp" };
+	{
+		std::ofstream file{ temporaryPath, std::ios::binary | std::ios::trunc };
+		if (!file)
+			return false;
+
+		file.seekp(static_cast<std::streamoff>(header.dataOffset));
+
+		std::vector<Vector3> page{};
+		for (const MeshCache::MeshView& mesh : meshes)
+		{
+			const bool hasVertexNormals{ !mesh.vertexNormals.empty() };
+			const uint32_t trianglesPerPage{ GetTrianglesPerPage(hasVertexNormals) };
+			const size_t nrTriangles{ mesh.normals.size() };
+
+			for (size_t firstTriangle{}; firstTriangle < nrTriangles; firstTriangle += trianglesPerPage)
+			{
+				const size_t endTriangle{ std::min(nrTriangles, firstTriangle + trianglesPerPage) };
+				page.assign(PageSize / sizeof(Vector3) + 1, Vector3{});
+
+				Vector3 minAABB{ mesh.positions[mesh.indices[firstTriangle * 3]] };
+				Vector3 maxAABB{ minAABB };
+				Vector3* pTriangle{ page.data() };
+				for (size_t triangle{ firstTriangle }; triangle < endTriangle; ++triangle)
+				{
+					for (int corner{}; corner < 3; ++corner)
+					{
+						const int vertex{ mesh.indices[triangle * 3 + corner] };
+						*pTriangle++ = mesh.positions[vertex];
+						minAABB = Vector3::Min(minAABB, mesh.positions[vertex]);
+						maxAABB = Vector3::Max(maxAABB, mesh.positions[vertex]);
+					}
+					*pTriangle++ = mesh.normals[triangle];
+
+					if (hasVertexNormals)
+					{
+						for (int corner{}; corner < 3; ++corner)
+							*pTriangle++ = mesh.vertexNormals[mesh.indices[triangle * 3 + corner]];
+					}
+				}
+
+				ClusterRecord& record{ clusterRecords.emplace_back() };
+				std::memcpy(record.minAABB, &minAABB, sizeof(record.minAABB));
+				std::memcpy(record.maxAABB, &maxAABB, sizeof(record.maxAABB));
+				record.nrTriangles = static_cast<uint32_t>(endTriangle - firstTriangle);
+
+				file.write(reinterpret_cast<const char*>(page.data()), PageSize);
+			}
+		}
+
+		file.seekp(0);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(meshRecords.data()), static_cast<std::streamsize>(meshRecords.size() * sizeof(MeshRecord)));
+		file.write(reinterpret_cast<const char*>(clusterRecords.data()), static_cast<std::streamsize>(clusterRecords.size() * sizeof(ClusterRecord)));
+		for (const MeshCache::MeshView& mesh : meshes)
+		{
+			file.write(mesh.name.data(), static_cast<std::streamsize>(mesh.name.size()));
+			file.write(mesh.materialName.data(), static_cast<std::streamsize>(mesh.materialName.size()));
+		}
+
+		if (!file.flush())
+			return false;
+	}
+
+	std::error_code error{};
+	std::filesystem::rename(temporaryPath, clusterPath, error);
+	if (error)
+	{
+		std::filesystem::remove(temporaryPath, error);
+		return false;
+	}
+
+	return true;
+}
+
+std::vector<std::shared_ptr<const MeshClusters>> MeshClusters::Open(const std::string& clusterPath)
+{
+	std::ifstream file{ clusterPath, std::ios::binary };
+	FileHeader header{};
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || std::memcmp(header.magic, Magic, sizeof(Magic)) != 0
+		|| header.version != Version || header.pageSize != PageSize || header.dataOffset < sizeof(header))
+		return {};
+
+	std::error_code error{};
+	if (std::filesystem::file_size(clusterPath, error) != header.fileSize || error)
+		return {};
+
+	//Everything up to the first cluster: the tables and the names
+	std::vector<char> tables(header.dataOffset - sizeof(header));
+	if (!file.read(tables.data(), static_cast<std::streamsize>(tables.size())))
+		return {};
+
+	const uint64_t tablesSize{ header.nrMeshes * sizeof(MeshRecord) + static_cast<uint64_t>(header.nrClusters) * sizeof(ClusterRecord) };
+	if (tablesSize > tables.size())
+		return {};
+
+	const auto pFile{ std::make_shared<File>(clusterPath, header.dataOffset) };
+	if (!pFile->IsOpen())
+		return {};
+
+	const auto isInTables = [&header](uint64_t offset, uint64_t size)
+	{
+		return offset >= sizeof(FileHeader) && offset + size <= header.dataOffset;
+	};
+
+	std::vector<std::shared_ptr<const MeshClusters>> meshes{};
+	for (uint32_t meshIndex{}; meshIndex < header.nrMeshes; ++meshIndex)
+	{
+		MeshRecord record{};
+		std::memcpy(&record, tables.data() + meshIndex * sizeof(MeshRecord), sizeof(record));
+
+		if (static_cast<uint64_t>(record.firstCluster) + record.nrClusters > header.nrClusters
+			|| !isInTables(record.nameOffset, record.nameLength) || !isInTables(record.materialNameOffset, record.materialNameLength))
+			return {};
+
+		//The constructor is private, make_shared can't reach it
+		std::shared_ptr<MeshClusters> pMesh{ new MeshClusters{} };
+		pMesh->m_pFile = pFile;
+		pMesh->m_Name.assign(tables.data() + (record.nameOffset - sizeof(FileHeader)), record.nameLength);
+		pMesh->m_MaterialName.assign(tables.data() + (record.materialNameOffset - sizeof(FileHeader)), record.materialNameLength);
+		std::memcpy(&pMesh->m_MinAABB, record.minAABB, sizeof(Vector3));
+		std::memcpy(&pMesh->m_MaxAABB, record.maxAABB, sizeof(Vector3));
+		pMesh->m_NrTriangles = record.nrTriangles;
+		pMesh->m_HasVertexNormals = record.hasVertexNormals != 0;
+
+		const uint32_t trianglesPerPage{ GetTrianglesPerPage(pMesh->m_HasVertexNormals) };
+		pMesh->m_Clusters.resize(record.nrClusters);
+		for (uint32_t clusterIndex{}; clusterIndex < record.nrClusters; ++clusterIndex)
+		{
+			ClusterRecord clusterRecord{};
+			std::memcpy(&clusterRecord, tables.data() + header.nrMeshes * sizeof(MeshRecord)
+				+ static_cast<size_t>(record.firstCluster + clusterIndex) * sizeof(ClusterRecord), sizeof(clusterRecord));
+			if (clusterRecord.nrTriangles > trianglesPerPage)
+				return {};
+
+			Cluster& cluster{ pMesh->m_Clusters[clusterIndex] };
+			std::memcpy(&cluster.minAABB, clusterRecord.minAABB, sizeof(Vector3));
+			std::memcpy(&cluster.maxAABB, clusterRecord.maxAABB, sizeof(Vector3));
+			cluster.nrTriangles = clusterRecord.nrTriangles;
+			cluster.pageIndex = record.firstCluster + clusterIndex;
+		}
+
+		meshes.emplace_back(std::move(pMesh));
+	}
+
+	return meshes;
+}
+
+bool MeshClusters::ReadSource(const std::string& clusterPath, MeshCache::SourceStamp& source)
+{
+	std::ifstream file{ clusterPath, std::ios::binary };
+	FileHeader header{};
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || std::memcmp(header.magic, Magic, sizeof(Magic)) != 0
+		|| header.version != Version || header.pageSize != PageSize)
+		return false;
+
+	std::error_code error{};
+	if (std::filesystem::file_size(clusterPath, error) != header.fileSize || error)
+		return false;
+
+	source.size = header.sourceSize;
+	source.hash = header.sourceHash;
+	return true;
+}
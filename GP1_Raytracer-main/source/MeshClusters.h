@@ -0,0 +1,98 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MeshCache.h"
+#include "Vector3.h"
+
+namespace dae
+{
+	struct Ray;
+	struct HitRecord;
+	struct TriangleMesh;
+
+	//Geometry of a mesh that stays on disk and is read a cluster at a time through the GeometryCache, for meshes that
+	//don't fit in memory next to the rest of the scene. Only the bounds of the clusters are kept in memory.
+	//
+	//The cluster file of an OBJ file is converted from its mesh cache and lives next to it. A header and tables with the
+	//meshes and clusters are followed by the clusters, every one of them a page of PageSize bytes. A cluster holds
+	//consecutive triangles of a mesh, which the cleanup at load sorted along a Morton curve, so its bounds are tight.
+	//Triangles are stored without indices: the three positions and the face normal, then the three vertex normals when
+	//the mesh has them.
+	class MeshClusters final
+	{
+	public:
+		static constexpr uint32_t Version{ 1 };
+		static constexpr uint32_t PageSize{ 64 * 1024 };
+
+		~MeshClusters();
+
+		MeshClusters(const MeshClusters&) = delete;
+		MeshClusters(MeshClusters&&) noexcept = delete;
+		MeshClusters& operator=(const MeshClusters&) = delete;
+		MeshClusters& operator=(MeshClusters&&) noexcept = delete;
+
+		const std::string& GetName() const { return m_Name; }
+		const std::string& GetMaterialName() const { return m_MaterialName; }
+		const Vector3& GetMinAABB() const { return m_MinAABB; }
+		const Vector3& GetMaxAABB() const { return m_MaxAABB; }
+		size_t GetNrTriangles() const { return m_NrTriangles; }
+		size_t GetNrClusters() const { return m_Clusters.size(); }
+		//Of the bounds kept in memory, the pages are accounted for by the GeometryCache
+		size_t GetMemoryUsage() const { return sizeof(MeshClusters) + m_Clusters.capacity() * sizeof(Cluster); }
+
+		/**
+		 * \brief Tests the ray against the clusters it passes through, nearest first, paging them in as needed.
+		 * The ray is moved into object space with the mesh's inverse transform, the hit is moved back.
+		 * \return whether anything was hit, like GeometryUtils::HitTest_TriangleMesh
+		 */
+		bool HitTest(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord) const;
+
+		//The cluster file lives next to the OBJ file, "scan.obj" becomes "scan.obj.clusters"
+		static std::string GetClusterPath(const std::string& objPath) { return objPath + ".clusters"; }
+
+		/**
+		 * \brief Brings the mesh cache of objPath up to date, then converts it to clusters when the cluster file is
+		 * missing, from another version or converted from another version of the OBJ file
+		 * \return path of the cluster file, empty on failure
+		 */
+		static std::string UpdateClusters(const std::string& objPath);
+
+		//Writes to a temporary file that replaces clusterPath once complete
+		static bool Write(const std::string& clusterPath, const MeshCache& cache);
+
+		//One per mesh of the file, in the order of the mesh cache. Empty when the file can't be read.
+		static std::vector<std::shared_ptr<const MeshClusters>> Open(const std::string& clusterPath);
+
+	private:
+		struct Cluster
+		{
+			Vector3 minAABB{};
+			Vector3 maxAABB{};
+			uint32_t nrTriangles{};
+			//Into the file, for the GeometryCache
+			uint32_t pageIndex{};
+		};
+
+		//Shared by the meshes of one file
+		class File;
+
+		MeshClusters() = default;
+
+		std::shared_ptr<File> m_pFile{};
+		std::string m_Name{};
+		std::string m_MaterialName{};
+		Vector3 m_MinAABB{};
+		Vector3 m_MaxAABB{};
+		size_t m_NrTriangles{};
+		bool m_HasVertexNormals{ false };
+		std::vector<Cluster> m_Clusters{};
+
+		//Vector3s per triangle
+		uint32_t GetStride() const { return m_HasVertexNormals ? 7 : 4; }
+
+		static bool ReadSource(const std::string& clusterPath, MeshCache::SourceStamp& source);
+	};
+}
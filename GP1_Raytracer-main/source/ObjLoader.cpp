@@ -0,0 +1,555 @@
+#include "ObjLoader.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <execution>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+#include "MappedFile.h"
+#include "MeshCleanup.h"
+
+#define PARALLEL_EXECUTION
+
+using namespace dae;
+
+namespace
+{
+	bool IsBlank(char character)
+	{
+		return character == ' ' || character == '\t';
+	}
+
+	bool IsLineEnd(char character)
+	{
+		return character == '\n' || character == '\r';
+	}
+
+	const char* SkipBlanks(const char* pCurrent, const char* pEnd)
+	{
+		while (pCurrent < pEnd && IsBlank(*pCurrent))
+			++pCurrent;
+		return pCurrent;
+	}
+
+	//Past the end of the line pCurrent is on
+	const char* NextLine(const char* pCurrent, const char* pEnd)
+	{
+		const void* pNewLine{ std::memchr(pCurrent, '\n', pEnd - pCurrent) };
+		return pNewLine ? static_cast<const char*>(pNewLine) + 1 : pEnd;
+	}
+
+	bool ParseVector(const char*& pCurrent, const char* pEnd, Vector3& vector)
+	{
+		float values[3]{};
+		for (float& value : values)
+		{
+			pCurrent = SkipBlanks(pCurrent, pEnd);
+			const std::from_chars_result result{ std::from_chars(pCurrent, pEnd, value) };
+			if (result.ec != std::errc{})
+				return false;
+			pCurrent = result.ptr;
+		}
+
+		vector = Vector3{ values[0], values[1], values[2] };
+		return true;
+	}
+
+	//One index of a face corner made 0-based, a negative one counts back from count, the elements read so far
+	bool ParseIndex(const char*& pCurrent, const char* pEnd, size_t count, int& index, bool& isRelative)
+	{
+		int value{};
+		const std::from_chars_result result{ std::from_chars(pCurrent, pEnd, value) };
+		if (result.ec != std::errc{} || value == 0)
+			return false;
+
+		pCurrent = result.ptr;
+		isRelative = value < 0;
+		index = isRelative ? static_cast<int>(count) + value : value - 1;
+		return true;
+	}
+
+	//The rest of the line without surrounding blanks
+	std::string ParseName(const char* pCurrent, const char* pEnd)
+	{
+		pCurrent = SkipBlanks(pCurrent, pEnd);
+		const char* pNameEnd{ pCurrent };
+		while (pNameEnd < pEnd && !IsLineEnd(*pNameEnd))
+			++pNameEnd;
+		while (pNameEnd > pCurrent && IsBlank(pNameEnd[-1]))
+			--pNameEnd;
+
+		return std::string{ pCurrent, pNameEnd };
+	}
+}
+
+bool ObjLoader::Load(const std::string& filename, std::vector<ObjMesh>& meshes)
+{
+	const auto loadStart{ std::chrono::steady_clock::now() };
+
+	if (!Parse(filename))
+	{
+		Clear();
+		return false;
+	}
+
+	CollectMeshes();
+
+	const size_t firstMesh{ meshes.size() };
+	meshes.resize(firstMesh + m_Meshes.size());
+
+	std::vector<uint32_t> meshIndices(m_Meshes.size());
+	std::iota(meshIndices.begin(), meshIndices.end(), 0);
+
+	const auto buildMesh = [&](uint32_t index)
+	{
+		BuildMesh(m_Meshes[index], meshes[firstMesh + index]);
+	};
+
+#ifdef PARALLEL_EXECUTION
+	std::for_each(std::execution::par, meshIndices.begin(), meshIndices.end(), buildMesh);
+#else
+	std::for_each(meshIndices.begin(), meshIndices.end(), buildMesh);
+#endif
+
+	//Face normals are only calculated once the triangles that would give NaN are gone
+	const auto cleanupStart{ std::chrono::steady_clock::now() };
+	std::vector<MeshCleanup::Statistics> cleanupStatistics(meshIndices.size());
+
+	const auto cleanMesh = [&](uint32_t index)
+	{
+		ObjMesh& mesh{ meshes[firstMesh + index] };
+		cleanupStatistics[index] = MeshCleanup::Clean(mesh.positions, mesh.vertexNormals, mesh.indices);
+		CalculateNormals(mesh);
+	};
+
+#ifdef PARALLEL_EXECUTION
+	std::for_each(std::execution::par, meshIndices.begin(), meshIndices.end(), cleanMesh);
+#else
+	std::for_each(meshIndices.begin(), meshIndices.end(), cleanMesh);
+#endif
+
+	MeshCleanup::Statistics cleanup{};
+	for (const MeshCleanup::Statistics& statistics : cleanupStatistics)
+		cleanup += statistics;
+	const double cleanupTime{ std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cleanupStart).count() };
+
+	size_t nrVertices{};
+	size_t nrTriangles{};
+	for (size_t index{ firstMesh }; index < meshes.size(); ++index)
+	{
+		nrVertices += meshes[index].positions.size();
+		nrTriangles += meshes[index].normals.size();
+	}
+
+	const size_t nrChunks{ m_Chunks.size() };
+	Clear();
+
+	m_LoadTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+
+	std::cout << "Loaded " << filename << ": " << meshIndices.size() << " meshes, " << nrVertices << " unique vertices for "
+		<< nrTriangles * 3 << " corners, " << nrTriangles << " triangles in " << m_LoadTime * 1000.0 << " ms ("
+		<< GetThroughput() << " MB/s, " << nrChunks << " chunks)" << std::endl;
+	std::cout << "  Cleanup in " << cleanupTime << " ms: welded " << cleanup.nrWeldedVertices << " vertices, removed " << cleanup.nrDegenerateTriangles
+		<< " degenerate and " << cleanup.nrDuplicateTriangles << " duplicate triangles and " << cleanup.nrUnusedVertices << " unused vertices" << std::endl;
+
+	return true;
+}
+
+bool ObjLoader::Load(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices)
+{
+	const auto loadStart{ std::chrono::steady_clock::now() };
+
+	if (!Parse(filename))
+	{
+		Clear();
+		return false;
+	}
+
+	//Appended to what the vectors already hold
+	const int firstVertex{ static_cast<int>(positions.size()) };
+	const size_t firstIndex{ indices.size() };
+	positions.insert(positions.end(), m_Positions.begin(), m_Positions.end());
+	indices.resize(firstIndex + m_CornerPositions.size());
+
+	const auto offsetIndex = [firstVertex](int index) { return index + firstVertex; };
+
+#ifdef PARALLEL_EXECUTION
+	std::transform(std::execution::par, m_CornerPositions.begin(), m_CornerPositions.end(), indices.begin() + firstIndex, offsetIndex);
+#else
+	std::transform(m_CornerPositions.begin(), m_CornerPositions.end(), indices.begin() + firstIndex, offsetIndex);
+#endif
+
+	//Precompute normals
+	const size_t firstTriangle{ firstIndex / 3 };
+	const size_t nrTriangles{ m_CornerPositions.size() / 3 };
+	const size_t firstNormal{ normals.size() };
+	normals.resize(firstNormal + nrTriangles);
+
+	std::vector<uint32_t> triangleIndices(nrTriangles);
+	std::iota(triangleIndices.begin(), triangleIndices.end(), 0);
+
+	const auto computeNormal = [&](uint32_t triangle)
+	{
+		const size_t index{ (firstTriangle + triangle) * 3 };
+		const Vector3 edgeV0V1{ positions[indices[index + 1]] - positions[indices[index]] };
+		const Vector3 edgeV0V2{ positions[indices[index + 2]] - positions[indices[index]] };
+		normals[firstNormal + triangle] = Vector3::Cross(edgeV0V1, edgeV0V2).Normalized();
+	};
+
+#ifdef PARALLEL_EXECUTION
+	std::for_each(std::execution::par, triangleIndices.begin(), triangleIndices.end(), computeNormal);
+#else
+	std::for_each(triangleIndices.begin(), triangleIndices.end(), computeNormal);
+#endif
+
+	const size_t nrVertices{ m_Positions.size() };
+	const size_t nrChunks{ m_Chunks.size() };
+	Clear();
+
+	m_LoadTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+
+	std::cout << "Loaded " << filename << ": " << nrVertices << " vertices, " << nrTriangles << " triangles in "
+		<< m_LoadTime * 1000.0 << " ms (" << GetThroughput() << " MB/s, " << nrChunks << " chunks)" << std::endl;
+
+	return true;
+}
+
+bool ObjLoader::Parse(const std::string& filename)
+{
+	const MappedFile file{ filename };
+	if (!file.IsOpen())
+	{
+		std::cout << "Could not open " << filename << std::endl;
+		return false;
+	}
+
+	const char* pData{ file.GetData() };
+	const size_t size{ file.GetSize() };
+	m_FileSize = size;
+
+	//Split at the first line break after every even share of the file
+	const size_t maxChunks{ std::max(1u, std::thread::hardware_concurrency()) * 4 };
+	const size_t nrChunks{ std::clamp<size_t>(size / MinChunkSize, 1, maxChunks) };
+	m_Chunks.clear();
+	m_Chunks.resize(nrChunks);
+
+	const char* pChunkBegin{ pData };
+	for (size_t index{}; index < nrChunks; ++index)
+	{
+		Chunk& chunk{ m_Chunks[index] };
+		chunk.pBegin = pChunkBegin;
+		chunk.pEnd = index + 1 == nrChunks ? pData + size : std::max(pChunkBegin, NextLine(pData + size * (index + 1) / nrChunks, pData + size));
+		pChunkBegin = chunk.pEnd;
+	}
+
+#ifdef PARALLEL_EXECUTION
+	std::for_each(std::execution::par, m_Chunks.begin(), m_Chunks.end(), ParseChunk);
+#else
+	std::for_each(m_Chunks.begin(), m_Chunks.end(), ParseChunk);
+#endif
+
+	const auto isValid = [](const Chunk& chunk) { return chunk.isValid; };
+	if (!std::all_of(m_Chunks.begin(), m_Chunks.end(), isValid))
+	{
+		std::cout << filename << " has malformed vertices or faces" << std::endl;
+		return false;
+	}
+
+	//Exclusive prefix sums, relative indices of a chunk are offset by what the chunks before it hold
+	size_t nrPositions{};
+	size_t nrNormals{};
+	size_t nrCorners{};
+	m_NrTexCoords = 0;
+	for (Chunk& chunk : m_Chunks)
+	{
+		chunk.firstPosition = nrPositions;
+		chunk.firstNormal = nrNormals;
+		chunk.firstTexCoord = m_NrTexCoords;
+		chunk.firstCorner = nrCorners;
+		nrPositions += chunk.positions.size();
+		nrNormals += chunk.normals.size();
+		m_NrTexCoords += chunk.nrTexCoords;
+		nrCorners += chunk.corners.size();
+	}
+
+	m_Positions.resize(nrPositions);
+	m_Normals.resize(nrNormals);
+	m_CornerPositions.resize(nrCorners);
+	m_CornerNormals.resize(nrCorners);
+
+	//Faces may refer to vertices of any chunk, they can only be checked once every chunk has its place
+	const auto resolveChunk = [this](Chunk& chunk) { ResolveChunk(chunk); };
+
+#ifdef PARALLEL_EXECUTION
+	std::for_each(std::execution::par, m_Chunks.begin(), m_Chunks.end(), resolveChunk);
+#else
+	std::for_each(m_Chunks.begin(), m_Chunks.end(), resolveChunk);
+#endif
+
+	if (!std::all_of(m_Chunks.begin(), m_Chunks.end(), isValid))
+	{
+		std::cout << filename << " has faces with vertex indices out of range" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+void ObjLoader::ParseChunk(Chunk& chunk)
+{
+	const char* pCurrent{ chunk.pBegin };
+	const char* const pEnd{ chunk.pEnd };
+
+	//Corners of the current face, before triangulation
+	std::vector<Corner> polygon{};
+
+	while (pCurrent < pEnd)
+	{
+		pCurrent = SkipBlanks(pCurrent, pEnd);
+
+		const char* pCommandEnd{ pCurrent };
+		while (pCommandEnd < pEnd && !IsBlank(*pCommandEnd) && !IsLineEnd(*pCommandEnd))
+			++pCommandEnd;
+		const std::string_view command{ pCurrent, static_cast<size_t>(pCommandEnd - pCurrent) };
+		pCurrent = pCommandEnd;
+
+		if (command == "v" || command == "vn")
+		{
+			Vector3 vector{};
+			if (!ParseVector(pCurrent, pEnd, vector))
+				chunk.isValid = false;
+			else if (command == "v")
+				chunk.positions.emplace_back(vector);
+			else
+				chunk.normals.emplace_back(vector);
+		}
+		else if (command == "vt")
+		{
+			//Only counted, faces may still refer to them
+			++chunk.nrTexCoords;
+		}
+		else if (command == "f")
+		{
+			polygon.clear();
+
+			bool isValid{ true };
+			while (isValid)
+			{
+				pCurrent = SkipBlanks(pCurrent, pEnd);
+				if (pCurrent == pEnd || IsLineEnd(*pCurrent) || *pCurrent == '#')
+					break;
+
+				//"v", "v/vt", "v//vn" or "v/vt/vn"
+				Corner corner{};
+				bool isRelative{};
+				isValid = ParseIndex(pCurrent, pEnd, chunk.positions.size(), corner.position, isRelative);
+				corner.flags |= isRelative ? RelativePosition : 0;
+
+				if (isValid && pCurrent < pEnd && *pCurrent == '/')
+				{
+					++pCurrent;
+					if (pCurrent < pEnd && *pCurrent != '/')
+					{
+						isValid = ParseIndex(pCurrent, pEnd, chunk.nrTexCoords, corner.texCoord, isRelative);
+						corner.flags |= HasTexCoord | (isRelative ? RelativeTexCoord : 0);
+					}
+
+					if (isValid && pCurrent < pEnd && *pCurrent == '/')
+					{
+						++pCurrent;
+						isValid = ParseIndex(pCurrent, pEnd, chunk.normals.size(), corner.normal, isRelative);
+						corner.flags |= HasNormal | (isRelative ? RelativeNormal : 0);
+					}
+				}
+
+				isValid = isValid && (pCurrent == pEnd || IsBlank(*pCurrent) || IsLineEnd(*pCurrent));
+				polygon.emplace_back(corner);
+			}
+
+			if (!isValid || polygon.size() < 3)
+			{
+				chunk.isValid = false;
+			}
+			else
+			{
+				//Fan around the first corner, exact for the convex polygons exporters write
+				for (size_t index{ 1 }; index + 1 < polygon.size(); ++index)
+				{
+					chunk.corners.emplace_back(polygon[0]);
+					chunk.corners.emplace_back(polygon[index]);
+					chunk.corners.emplace_back(polygon[index + 1]);
+				}
+			}
+		}
+		else if (command == "o" || command == "g" || command == "usemtl")
+		{
+			chunk.stateChanges.emplace_back(StateChange{ static_cast<uint32_t>(chunk.corners.size() / 3), command[0], ParseName(pCurrent, pEnd) });
+		}
+
+		//Comments, other commands and whatever is left of the line
+		pCurrent = NextLine(pCurrent, pEnd);
+	}
+}
+
+void ObjLoader::ResolveChunk(Chunk& chunk)
+{
+	std::copy(chunk.positions.begin(), chunk.positions.end(), m_Positions.begin() + chunk.firstPosition);
+	std::copy(chunk.normals.begin(), chunk.normals.end(), m_Normals.begin() + chunk.firstNormal);
+
+	bool isValid{ true };
+	const auto resolve = [&isValid](int index, bool isRelative, size_t first, size_t count)
+	{
+		const int64_t resolved{ isRelative ? static_cast<int64_t>(first) + index : index };
+		isValid = isValid && resolved >= 0 && resolved < static_cast<int64_t>(count);
+		return static_cast<int>(resolved);
+	};
+
+	for (size_t index{}; index < chunk.corners.size(); ++index)
+	{
+		const Corner& corner{ chunk.corners[index] };
+		const size_t cornerIndex{ chunk.firstCorner + index };
+
+		m_CornerPositions[cornerIndex] = resolve(corner.position, corner.flags & RelativePosition, chunk.firstPosition, m_Positions.size());
+		m_CornerNormals[cornerIndex] = corner.flags & HasNormal ? resolve(corner.normal, corner.flags & RelativeNormal, chunk.firstNormal, m_Normals.size()) : -1;
+		if (corner.flags & HasTexCoord)
+			resolve(corner.texCoord, corner.flags & RelativeTexCoord, chunk.firstTexCoord, m_NrTexCoords);
+	}
+
+	chunk.isValid = isValid;
+}
+
+void ObjLoader::CollectMeshes()
+{
+	m_Meshes.clear();
+
+	//Keyed on name and material, the same combination may come back later in the file
+	std::map<std::string, uint32_t> meshIndices{};
+	std::string objectName{};
+	std::string groupName{};
+	std::string materialName{};
+	constexpr uint32_t noMesh{ UINT32_MAX };
+	uint32_t meshIndex{ noMesh };
+
+	const auto addRun = [&](size_t firstTriangle, size_t endTriangle)
+	{
+		if (firstTriangle == endTriangle)
+			return;
+
+		if (meshIndex == noMesh)
+		{
+			std::string name{ objectName.empty() ? groupName : groupName.empty() ? objectName : objectName + '/' + groupName };
+			const auto [meshIt, isNew] { meshIndices.try_emplace(name + '\n' + materialName, static_cast<uint32_t>(m_Meshes.size())) };
+			if (isNew)
+				m_Meshes.emplace_back(MeshRuns{ std::move(name), materialName, {} });
+			meshIndex = meshIt->second;
+		}
+
+		std::vector<TriangleRun>& runs{ m_Meshes[meshIndex].runs };
+		if (!runs.empty() && runs.back().firstTriangle + runs.back().nrTriangles == firstTriangle)
+			runs.back().nrTriangles += endTriangle - firstTriangle;
+		else
+			runs.emplace_back(TriangleRun{ firstTriangle, endTriangle - firstTriangle });
+	};
+
+	for (const Chunk& chunk : m_Chunks)
+	{
+		const size_t chunkTriangle{ chunk.firstCorner / 3 };
+		size_t runStart{ chunkTriangle };
+
+		for (const StateChange& change : chunk.stateChanges)
+		{
+			addRun(runStart, chunkTriangle + change.firstTriangle);
+			runStart = chunkTriangle + change.firstTriangle;
+
+			switch (change.command)
+			{
+			case 'o':
+				objectName = change.name;
+				groupName.clear();
+				break;
+			case 'g':
+				groupName = change.name;
+				break;
+			default:
+				materialName = change.name;
+				break;
+			}
+			meshIndex = noMesh;
+		}
+
+		addRun(runStart, chunkTriangle + chunk.corners.size() / 3);
+	}
+}
+
+void ObjLoader::BuildMesh(const MeshRuns& meshRuns, ObjMesh& mesh) const
+{
+	mesh.name = meshRuns.name;
+	mesh.materialName = meshRuns.materialName;
+
+	//Vertex normals are only kept when the whole mesh has them, a mesh can't be partly smooth
+	size_t nrCorners{};
+	bool hasVertexNormals{ true };
+	for (const TriangleRun& run : meshRuns.runs)
+	{
+		const auto runBegin{ m_CornerNormals.begin() + run.firstTriangle * 3 };
+		nrCorners += run.nrTriangles * 3;
+		hasVertexNormals = hasVertexNormals && std::all_of(runBegin, runBegin + run.nrTriangles * 3, [](int normal) { return normal >= 0; });
+	}
+
+	//Corners that share position and normal become one vertex
+	std::unordered_map<uint64_t, int> vertexIndices{};
+	vertexIndices.reserve(nrCorners / 4);
+	mesh.indices.reserve(nrCorners);
+
+	for (const TriangleRun& run : meshRuns.runs)
+	{
+		const size_t endCorner{ (run.firstTriangle + run.nrTriangles) * 3 };
+		for (size_t corner{ run.firstTriangle * 3 }; corner < endCorner; ++corner)
+		{
+			const int position{ m_CornerPositions[corner] };
+			const int normal{ hasVertexNormals ? m_CornerNormals[corner] : 0 };
+			const uint64_t key{ static_cast<uint64_t>(position) << 32 | static_cast<uint32_t>(normal) };
+
+			const auto [vertexIt, isNew] { vertexIndices.try_emplace(key, static_cast<int>(mesh.positions.size())) };
+			if (isNew)
+			{
+				mesh.positions.emplace_back(m_Positions[position]);
+				if (hasVertexNormals)
+					mesh.vertexNormals.emplace_back(m_Normals[normal].Normalized());
+			}
+			mesh.indices.emplace_back(vertexIt->second);
+		}
+	}
+
+	mesh.positions.shrink_to_fit();
+	mesh.vertexNormals.shrink_to_fit();
+}
+
+void ObjLoader::CalculateNormals(ObjMesh& mesh)
+{
+	mesh.normals.clear();
+	mesh.normals.reserve(mesh.indices.size() / 3);
+	for (size_t index{}; index < mesh.indices.size(); index += 3)
+	{
+		const Vector3 edgeV0V1{ mesh.positions[mesh.indices[index + 1]] - mesh.positions[mesh.indices[index]] };
+		const Vector3 edgeV0V2{ mesh.positions[mesh.indices[index + 2]] - mesh.positions[mesh.indices[index]] };
+		mesh.normals.emplace_back(Vector3::Cross(edgeV0V1, edgeV0V2).Normalized());
+	}
+}
+
+void ObjLoader::Clear()
+{
+	m_Chunks = {};
+	m_Positions = {};
+	m_Normals = {};
+	m_CornerPositions = {};
+	m_CornerNormals = {};
+	m_Meshes = {};
+}
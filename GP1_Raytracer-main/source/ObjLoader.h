@@ -0,0 +1,147 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Vector3.h"
+
+namespace dae
+{
+	//Triangles of one group/material combination of an OBJ file, every vertex is a unique position/normal pair
+	struct ObjMesh
+	{
+		//Object and group name joined by a '/', either may be missing
+		std::string name{};
+		//Of the usemtl statement, empty when the faces have none
+		std::string materialName{};
+
+		std::vector<Vector3> positions{};
+		//One per position, empty unless every face of the mesh supplies vertex normals
+		std::vector<Vector3> vertexNormals{};
+		//One per triangle
+		std::vector<Vector3> normals{};
+		std::vector<int> indices{};
+	};
+
+	//Loads Wavefront OBJ files. The file is memory mapped and split into line-aligned chunks that are parsed in parallel
+	//with std::from_chars, prefix sums over the per-chunk counts then give every chunk its place in the merged lists.
+	//Reads v, vt, vn, f (any polygon, v, v/vt, v//vn and v/vt/vn corners, negative indices), o, g and usemtl.
+	class ObjLoader final
+	{
+	public:
+		ObjLoader() = default;
+		~ObjLoader() = default;
+
+		ObjLoader(const ObjLoader&) = delete;
+		ObjLoader(ObjLoader&&) noexcept = delete;
+		ObjLoader& operator=(const ObjLoader&) = delete;
+		ObjLoader& operator=(ObjLoader&&) noexcept = delete;
+
+		/**
+		 * \brief Appends a mesh per group/material combination to meshes and prints the load time. Polygons are
+		 * triangulated as fans, identical position/normal corners are merged into one vertex through a hash map.
+		 * Every mesh then goes through MeshCleanup, so no degenerate triangles remain, before its face normals are
+		 * calculated. Texture coordinates are checked but not kept, the renderer has no textures.
+		 * \return false when the file can't be read, has malformed faces or a face refers to a vertex that doesn't exist
+		 */
+		bool Load(const std::string& filename, std::vector<ObjMesh>& meshes);
+
+		/**
+		 * \brief Appends every face of the file as a single mesh: all 'v' positions in file order, triangle indices
+		 * and face normals. Groups, materials and vertex normals are ignored, nothing is cleaned up.
+		 */
+		bool Load(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices);
+
+		//Of the last Load
+		double GetLoadTime() const { return m_LoadTime; }
+		uint64_t GetFileSize() const { return m_FileSize; }
+		//Megabytes of OBJ text per second
+		double GetThroughput() const { return m_LoadTime > 0.0 ? m_FileSize / m_LoadTime / 1'000'000.0 : 0.0; }
+
+	private:
+		//Chunks get at least this many bytes, smaller files are parsed by fewer threads
+		static constexpr size_t MinChunkSize{ 256 * 1024 };
+
+		//One vertex of a face as written: indices into the file's v, vt and vn lists. Negative (relative) indices
+		//are counted from the chunk's own lists while parsing and offset once the chunks are merged.
+		struct Corner
+		{
+			int position{};
+			int texCoord{};
+			int normal{};
+			uint8_t flags{};
+		};
+		static constexpr uint8_t HasTexCoord{ 1 };
+		static constexpr uint8_t HasNormal{ 2 };
+		static constexpr uint8_t RelativePosition{ 4 };
+		static constexpr uint8_t RelativeTexCoord{ 8 };
+		static constexpr uint8_t RelativeNormal{ 16 };
+
+		//An o, g or usemtl statement, applies to the chunk's triangles from firstTriangle on
+		struct StateChange
+		{
+			uint32_t firstTriangle{};
+			char command{};
+			std::string name{};
+		};
+
+		struct Chunk
+		{
+			const char* pBegin{};
+			const char* pEnd{};
+			std::vector<Vector3> positions{};
+			std::vector<Vector3> normals{};
+			uint32_t nrTexCoords{};
+			//3 per triangle
+			std::vector<Corner> corners{};
+			std::vector<StateChange> stateChanges{};
+			bool isValid{ true };
+
+			//Where the chunk's data starts in the merged lists, from the prefix sums
+			size_t firstPosition{};
+			size_t firstNormal{};
+			size_t firstTexCoord{};
+			size_t firstCorner{};
+		};
+
+		//Consecutive triangles of the merged corner list that belong to the same mesh
+		struct TriangleRun
+		{
+			size_t firstTriangle{};
+			size_t nrTriangles{};
+		};
+
+		struct MeshRuns
+		{
+			std::string name{};
+			std::string materialName{};
+			std::vector<TriangleRun> runs{};
+		};
+
+		std::vector<Chunk> m_Chunks{};
+
+		//Merged lists of the last parse, corners reduced to their position and normal index (-1 without normal)
+		std::vector<Vector3> m_Positions{};
+		std::vector<Vector3> m_Normals{};
+		std::vector<int> m_CornerPositions{};
+		std::vector<int> m_CornerNormals{};
+		size_t m_NrTexCoords{};
+		std::vector<MeshRuns> m_Meshes{};
+
+		double m_LoadTime{};
+		uint64_t m_FileSize{};
+
+		//Maps, parses and merges the file into the lists above
+		bool Parse(const std::string& filename);
+		static void ParseChunk(Chunk& chunk);
+		//Copies the chunk into the merged lists, offsets the relative indices and clears isValid when one is out of range
+		void ResolveChunk(Chunk& chunk);
+		//Splits the merged triangles into runs per object/group/material combination
+		void CollectMeshes();
+		//Vertices and indices only, the normals follow the cleanup
+		void BuildMesh(const MeshRuns& meshRuns, ObjMesh& mesh) const;
+		static void CalculateNormals(ObjMesh& mesh);
+		//Frees the parse results once they are copied out
+		void Clear();
+	};
+}
@@ -0,0 +1,179 @@
+#include "PixelPacker.h"
+
+#include <algorithm>
+#include "SDL.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PIXELPACKER_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace dae;
+
+namespace
+{
+	//ACES fit coefficients, (c * (A * c + B)) / (c * (C * c + D) + E)
+	constexpr float AcesA{ 2.51f };
+	constexpr float AcesB{ 0.03f };
+	constexpr float AcesC{ 2.43f };
+	constexpr float AcesD{ 0.59f };
+	constexpr float AcesE{ 0.14f };
+
+#ifdef PIXELPACKER_SSE2
+	__m128 AcesChannel(__m128 value)
+	{
+		const __m128 numerator{ _mm_mul_ps(value, _mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(AcesA)), _mm_set1_ps(AcesB))) };
+		const __m128 denominator{ _mm_add_ps(_mm_mul_ps(value, _mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(AcesC)), _mm_set1_ps(AcesD))), _mm_set1_ps(AcesE)) };
+		return _mm_div_ps(numerator, denominator);
+	}
+#endif
+
+	float AcesChannel(float value)
+	{
+		return (value * (AcesA * value + AcesB)) / (value * (AcesC * value + AcesD) + AcesE);
+	}
+}
+
+PixelPacker::PixelPacker(const SDL_PixelFormat* pFormat) :
+	m_pFormat(pFormat)
+{
+	//Every channel a full byte of a 32-bit pixel, then packing is a shift per channel
+	m_IsVectorized = pFormat->BytesPerPixel == 4
+		&& pFormat->Rloss == 0 && pFormat->Gloss == 0 && pFormat->Bloss == 0;
+
+	m_RedShift = pFormat->Rshift;
+	m_GreenShift = pFormat->Gshift;
+	m_BlueShift = pFormat->Bshift;
+	//SDL_MapRGB returns opaque pixels for formats with alpha
+	m_AlphaMask = pFormat->Amask;
+}
+
+void PixelPacker::Pack(const ColorRGB* pColors, uint32_t* pPixels, uint32_t nrPixels, float scale) const
+{
+	uint32_t index{};
+
+	if (m_IsVectorized)
+	{
+		switch (m_ToneMapping)
+		{
+		case ToneMapping::maxToOne:
+			index = PackVectorized<ToneMapping::maxToOne>(pColors, pPixels, nrPixels, scale);
+			break;
+		case ToneMapping::reinhard:
+			index = PackVectorized<ToneMapping::reinhard>(pColors, pPixels, nrPixels, scale);
+			break;
+		case ToneMapping::aces:
+			index = PackVectorized<ToneMapping::aces>(pColors, pPixels, nrPixels, scale);
+			break;
+		}
+	}
+
+	for (; index < nrPixels; ++index)
+		pPixels[index] = PackPixel(pColors[index], scale);
+}
+
+template<PixelPacker::ToneMapping toneMapping>
+uint32_t PixelPacker::PackVectorized(const ColorRGB* pColors, uint32_t* pPixels, uint32_t nrPixels, float scale) const
+{
+	uint32_t index{};
+
+#ifdef PIXELPACKER_SSE2
+	const __m128 one{ _mm_set1_ps(1.f) };
+	const __m128 zero{ _mm_setzero_ps() };
+	const __m128 maxChannel{ _mm_set1_ps(255.f) };
+	const __m128 exposure{ _mm_set1_ps(scale * m_Exposure) };
+	const __m128i redShift{ _mm_cvtsi32_si128(static_cast<int>(m_RedShift)) };
+	const __m128i greenShift{ _mm_cvtsi32_si128(static_cast<int>(m_GreenShift)) };
+	const __m128i blueShift{ _mm_cvtsi32_si128(static_cast<int>(m_BlueShift)) };
+	const __m128i alpha{ _mm_set1_epi32(static_cast<int>(m_AlphaMask)) };
+
+	for (; index + 4 <= nrPixels; index += 4)
+	{
+		//4 packed rgb triplets: a = r0 g0 b0 r1, b = g1 b1 r2 g2, c = b2 r3 g3 b3
+		const float* pSource{ &pColors[index].r };
+		const __m128 a{ _mm_loadu_ps(pSource) };
+		const __m128 b{ _mm_loadu_ps(pSource + 4) };
+		const __m128 c{ _mm_loadu_ps(pSource + 8) };
+
+		__m128 red{ _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0)) };
+		__m128 green{ _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0)) };
+		__m128 blue{ _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0)) };
+
+		red = _mm_mul_ps(red, exposure);
+		green = _mm_mul_ps(green, exposure);
+		blue = _mm_mul_ps(blue, exposure);
+
+		if constexpr (toneMapping == ToneMapping::maxToOne)
+		{
+			//Divide by the largest channel when it is above one, the divide by one elsewhere is exact
+			const __m128 maxValue{ _mm_max_ps(red, _mm_max_ps(green, blue)) };
+			const __m128 aboveOne{ _mm_cmpgt_ps(maxValue, one) };
+			const __m128 divisor{ _mm_or_ps(_mm_and_ps(aboveOne, maxValue), _mm_andnot_ps(aboveOne, one)) };
+
+			red = _mm_div_ps(red, divisor);
+			green = _mm_div_ps(green, divisor);
+			blue = _mm_div_ps(blue, divisor);
+		}
+		else if constexpr (toneMapping == ToneMapping::reinhard)
+		{
+			red = _mm_div_ps(red, _mm_add_ps(red, one));
+			green = _mm_div_ps(green, _mm_add_ps(green, one));
+			blue = _mm_div_ps(blue, _mm_add_ps(blue, one));
+		}
+		else
+		{
+			red = AcesChannel(red);
+			green = AcesChannel(green);
+			blue = AcesChannel(blue);
+		}
+
+		//Clamping at zero also turns NaN into black
+		red = _mm_min_ps(_mm_max_ps(_mm_mul_ps(red, maxChannel), zero), maxChannel);
+		green = _mm_min_ps(_mm_max_ps(_mm_mul_ps(green, maxChannel), zero), maxChannel);
+		blue = _mm_min_ps(_mm_max_ps(_mm_mul_ps(blue, maxChannel), zero), maxChannel);
+
+		__m128i pixels{ _mm_sll_epi32(_mm_cvttps_epi32(red), redShift) };
+		pixels = _mm_or_si128(pixels, _mm_sll_epi32(_mm_cvttps_epi32(green), greenShift));
+		pixels = _mm_or_si128(pixels, _mm_sll_epi32(_mm_cvttps_epi32(blue), blueShift));
+		pixels = _mm_or_si128(pixels, alpha);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pPixels + index), pixels);
+	}
+#else
+	(void)pColors;
+	(void)pPixels;
+	(void)nrPixels;
+	(void)scale;
+#endif
+
+	return index;
+}
+
+uint32_t PixelPacker::PackPixel(ColorRGB color, float scale) const
+{
+	color *= scale * m_Exposure;
+
+	switch (m_ToneMapping)
+	{
+	case ToneMapping::maxToOne:
+		color.MaxToOne();
+		break;
+	case ToneMapping::reinhard:
+		color = { color.r / (color.r + 1.f), color.g / (color.g + 1.f), color.b / (color.b + 1.f) };
+		break;
+	case ToneMapping::aces:
+		color = { AcesChannel(color.r), AcesChannel(color.g), AcesChannel(color.b) };
+		break;
+	}
+
+	//Same order as the vectorized clamp, NaN ends up as 0
+	const auto toChannel = [](float value) { return static_cast<uint8_t>(std::min(std::max(0.f, value * 255), 255.f)); };
+	const uint8_t red{ toChannel(color.r) };
+	const uint8_t green{ toChannel(color.g) };
+	const uint8_t blue{ toChannel(color.b) };
+
+	if (m_IsVectorized)
+		return (red << m_RedShift) | (green << m_GreenShift) | (blue << m_BlueShift) | m_AlphaMask;
+
+	return SDL_MapRGB(m_pFormat, red, green, blue);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+
+#include "ColorRGB.h"
+
+struct SDL_PixelFormat;
+
+namespace dae
+{
+	//Tone maps linear HDR colors and converts them to the pixel layout of a surface. The layout is inspected once:
+	//32-bit formats with 8-bit channels are packed 4 pixels per iteration with SSE2, anything else goes through SDL_MapRGB.
+	class PixelPacker final
+	{
+	public:
+		enum class ToneMapping
+		{
+			maxToOne, //Divides by the largest channel when it exceeds one, keeps the hue
+			reinhard, //c / (1 + c) per channel
+			aces //Narkowicz's fit of the ACES filmic curve
+		};
+		static constexpr int NrToneMappings{ 3 };
+
+		PixelPacker(const SDL_PixelFormat* pFormat);
+		~PixelPacker() = default;
+
+		PixelPacker(const PixelPacker&) = delete;
+		PixelPacker(PixelPacker&&) noexcept = delete;
+		PixelPacker& operator=(const PixelPacker&) = delete;
+		PixelPacker& operator=(PixelPacker&&) noexcept = delete;
+
+		/**
+		 * \brief Tone maps nrPixels colors and writes them to the surface pixels. With maxToOne and an exposure
+		 * of one the result is the same as ColorRGB::MaxToOne followed by SDL_MapRGB.
+		 * \param pColors linear colors
+		 * \param pPixels destination in the surface's pixel format
+		 * \param scale multiplies the colors before the exposure, e.g. one over the number of accumulated samples
+		 */
+		void Pack(const ColorRGB* pColors, uint32_t* pPixels, uint32_t nrPixels, float scale = 1.f) const;
+
+		void SetToneMapping(ToneMapping toneMapping) { m_ToneMapping = toneMapping; }
+		ToneMapping GetToneMapping() const { return m_ToneMapping; }
+		void SetExposure(float exposure) { m_Exposure = exposure; }
+		float GetExposure() const { return m_Exposure; }
+
+		bool IsVectorized() const { return m_IsVectorized; }
+
+	private:
+		const SDL_PixelFormat* m_pFormat{};
+		bool m_IsVectorized{ false };
+
+		//Only valid for the vectorized layouts
+		uint32_t m_RedShift{};
+		uint32_t m_GreenShift{};
+		uint32_t m_BlueShift{};
+		uint32_t m_AlphaMask{};
+
+		ToneMapping m_ToneMapping{ ToneMapping::maxToOne };
+		float m_Exposure{ 1.f };
+
+		//Packs the largest multiple of 4 pixels, returns how many it packed
+		template<ToneMapping toneMapping>
+		uint32_t PackVectorized(const ColorRGB* pColors, uint32_t* pPixels, uint32_t nrPixels, float scale) const;
+		uint32_t PackPixel(ColorRGB color, float scale) const;
+	};
+}
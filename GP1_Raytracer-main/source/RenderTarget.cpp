@@ -0,0 +1,30 @@
+#include "RenderTarget.h"
+
+#include "SDL.h"
+
+using namespace dae;
+
+WindowRenderTarget::WindowRenderTarget(SDL_Window* pWindow) :
+	m_pWindow(pWindow)
+{
+	m_pSurface = SDL_GetWindowSurface(pWindow);
+	SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
+}
+
+void WindowRenderTarget::Present()
+{
+	SDL_UpdateWindowSurface(m_pWindow);
+}
+
+MemoryRenderTarget::MemoryRenderTarget(int width, int height)
+{
+	m_Width = width;
+	m_Height = height;
+	//Same layout as a typical window surface, so both backends take the vectorized packing path
+	m_pSurface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888);
+}
+
+MemoryRenderTarget::~MemoryRenderTarget()
+{
+	SDL_FreeSurface(m_pSurface);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+
+struct SDL_Surface;
+struct SDL_Window;
+
+namespace dae
+{
+	//Surface the renderer packs its frames into. The surface always holds 32-bit pixels with rows of width pixels.
+	class RenderTarget
+	{
+	public:
+		RenderTarget() = default;
+		virtual ~RenderTarget() = default;
+
+		RenderTarget(const RenderTarget&) = delete;
+		RenderTarget(RenderTarget&&) noexcept = delete;
+		RenderTarget& operator=(const RenderTarget&) = delete;
+		RenderTarget& operator=(RenderTarget&&) noexcept = delete;
+
+		//Called once the surface holds a finished frame
+		virtual void Present() = 0;
+
+		SDL_Surface* GetSurface() const { return m_pSurface; }
+		int GetWidth() const { return m_Width; }
+		int GetHeight() const { return m_Height; }
+
+	protected:
+		SDL_Surface* m_pSurface{};
+		int m_Width{};
+		int m_Height{};
+	};
+
+	//Renders into the surface of a window
+	class WindowRenderTarget final : public RenderTarget
+	{
+	public:
+		WindowRenderTarget(SDL_Window* pWindow);
+		~WindowRenderTarget() override = default;
+
+		void Present() override;
+
+	private:
+		SDL_Window* m_pWindow{};
+	};
+
+	//Renders into a surface in memory, needs no display and no video subsystem
+	class MemoryRenderTarget final : public RenderTarget
+	{
+	public:
+		MemoryRenderTarget(int width, int height);
+		~MemoryRenderTarget() override;
+
+		void Present() override { ++m_NrPresentedFrames; }
+
+		uint32_t GetNrPresentedFrames() const { return m_NrPresentedFrames; }
+
+	private:
+		uint32_t m_NrPresentedFrames{};
+	};
+}
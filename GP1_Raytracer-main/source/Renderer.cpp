@@ -1,10 +1,14 @@
 //External includes
-#include <execution>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <numeric>
 #include "SDL.h"
 #include "SDL_surface.h"
 
 //Project includes
 #include "Renderer.h"
+#include "RenderTarget.h"
 #include "Math.h"
 #include "Matrix.h"
 #include "Material.h"
@@ -15,28 +19,110 @@
 
 using namespace dae;
 
-Renderer::Renderer(SDL_Window * pWindow) :
-	m_pWindow(pWindow),
-	m_pBuffer(SDL_GetWindowSurface(pWindow))
+namespace
 {
+	//True when every material that is referenced by geometry is of the given (final) type
+	template<typename MaterialType>
+	bool UsesOnlyMaterialType(const std::vector<Material*>& materials, const std::bitset<256>& usedMaterials)
+	{
+		for (size_t index = 0; index < materials.size(); ++index)
+		{
+			if (usedMaterials.test(index) && dynamic_cast<const MaterialType*>(materials[index]) == nullptr)
+				return false;
+		}
+
+		return usedMaterials.any();
+	}
+
+	//Stateless hash to [0, 1), gives every pixel a fixed jitter so the anti-aliased edges don't shimmer
+	float HashToUnitFloat(uint32_t value)
+	{
+		value ^= value >> 16;
+		value *= 0x7feb352du;
+		value ^= value >> 15;
+		value *= 0x846ca68bu;
+		value ^= value >> 16;
+		return (value >> 8) * (1.f / 16777216.f);
+	}
+
+	//Resets count elements of buffer from first on, one row of a tile
+	template<typename T>
+	void ResetRow(std::vector<T>& buffer, uint32_t first, uint32_t count, const T& value = T{})
+	{
+		std::fill_n(buffer.begin() + first, count, value);
+	}
+
+	//Radical inverse of index in the given base, low-discrepancy sample positions for the accumulate mode
+	float Halton(uint32_t index, uint32_t base)
+	{
+		float fraction{ 1.f };
+		float result{};
+		while (index > 0)
+		{
+			fraction /= base;
+			result += fraction * (index % base);
+			index /= base;
+		}
+		return result;
+	}
+
+	float Luminance(ColorRGB color)
+	{
+		color.MaxToOne();
+		return 0.2126f * color.r + 0.7152f * color.g + 0.0722f * color.b;
+	}
+}
+
+Renderer::Renderer(RenderTarget* pTarget) :
+	m_pTarget(pTarget),
+	m_pBuffer(pTarget->GetSurface()),
+	m_PixelPacker(m_pBuffer->format)
+{
+
 
-	
 
 	//Initialize
-	SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
+	m_Width = pTarget->GetWidth();
+	m_Height = pTarget->GetHeight();
 	m_pBufferPixels = static_cast<uint32_t*>(m_pBuffer->pixels);
 
 	m_NrPixels = m_Width * m_Height;
 
-	m_PixelIndeces.reserve(m_NrPixels);
-	for (size_t index{}; index < m_NrPixels; ++index) m_PixelIndeces.emplace_back(index);
+	m_GBuffer.positions.resize(m_NrPixels);
+	m_GBuffer.normals.resize(m_NrPixels);
+	m_GBuffer.viewDirections.resize(m_NrPixels);
+	m_GBuffer.materialIndices.resize(m_NrPixels);
+	m_GBuffer.primitiveIds.resize(m_NrPixels);
+	m_GBuffer.hitMask.resize(m_NrPixels);
+	m_ColorBuffer.resize(m_NrPixels);
+	m_FrameBuffer.resize(m_NrPixels);
+	m_AccumulationBuffer.resize(m_NrPixels);
+
+	m_NrTilesX = (m_Width + TileSize - 1) / TileSize;
+	m_NrTilesY = (m_Height + TileSize - 1) / TileSize;
+	m_DirtyTiles.resize(m_NrTilesX * m_NrTilesY);
+	m_DirtyTileIndeces.reserve(m_NrTilesX * m_NrTilesY);
+	m_TileFrames.resize(m_NrTilesX * m_NrTilesY);
+	m_TileOrder.resize(m_NrTilesX * m_NrTilesY);
+	std::iota(m_TileOrder.begin(), m_TileOrder.end(), 0);
+
+	m_DepthBuffer.resize(m_NrPixels);
+	m_HistoryColorBuffer.resize(m_NrPixels);
+	m_HistoryDepthBuffer.resize(m_NrPixels);
+
+	for (ShadingCache& cache : m_ShadingCaches)
+	{
+		cache.positions.resize(m_NrPixels);
+		cache.normals.resize(m_NrPixels);
+		cache.colors.resize(m_NrPixels);
+		cache.materialIndices.resize(m_NrPixels);
+		cache.ages.resize(m_NrPixels, InvalidShadingAge);
+	}
 }
 
-void Renderer::Render(Scene* pScene) const
+bool Renderer::Render(Scene* pScene)
 {
 	Camera& camera = pScene->GetCamera();
-	auto& materials = pScene->GetMaterials();
-	auto& lights = pScene->GetLights();
 
 	const Matrix cameraToWorld = camera.CalculateCameraToWorld();
 
@@ -45,103 +131,816 @@ void Renderer::Render(Scene* pScene) const
 	const float fovAngle = camera.fovAngle * TO_RADIANS;
 	const float fov = tan(fovAngle / 2.f);
 
-	
+	//Pick the specialized kernels once per frame, the pixel loops themselves have no mode branches
+	const PixelKernels& kernels = SelectKernels(pScene);
+
+	m_DirtyBounds.clear();
+	const bool sceneDirty{ pScene->ConsumeChanges(m_DirtyBounds) };
+
+	const bool shadingChanged{ &kernels != m_pPreviousKernels || fov != m_PreviousFov };
+	const bool settingsChanged{ sceneDirty || shadingChanged };
+	const bool viewChanged{ settingsChanged || !(cameraToWorld == m_PreviousCameraToWorld) };
+	m_pPreviousKernels = &kernels;
+	m_PreviousFov = fov;
+	m_PreviousCameraToWorld = cameraToWorld;
+	//Moving meshes only show up in the dirty bounds, whatever was built up over several frames is stale too
+	const bool imageChanged{ viewChanged || !m_DirtyBounds.empty() };
+
+	//Whether the surface ends up holding a full quality image of the current view
+	bool frameComplete{ true };
+	m_NrAntiAliasingSamples = 0;
+
+	switch (m_RenderMode)
+	{
+	case RenderMode::forward:
+		if (m_DynamicResolutionEnabled && m_FrameBudget.GetScale() < 1.f)
+		{
+			RenderScaled(pScene, kernels, fov, aspectRatio, cameraToWorld);
+			frameComplete = false;
+		}
+		else if (m_FrameCacheEnabled && m_HasCachedFrame && !viewChanged && (m_DirtyBounds.empty() || m_AntiAliasingLevel == 0))
+		{
+			//Nothing changed, keep the presented frame
+			if (m_DirtyBounds.empty())
+			{
+				if (!m_PresentPending)
+					return false;
+			}
+			else
+			{
+				CollectDirtyTiles(pScene, cameraToWorld, fov, aspectRatio);
+				RenderDirtyTiles(pScene, kernels, fov, aspectRatio, cameraToWorld);
+			}
+		}
+		else if (m_AntiAliasingLevel > 0)
+		{
+			//Edge detection needs the whole frame, the anti-aliased path doesn't re-render dirty tiles only
+			RenderAntiAliased(pScene, kernels, fov, aspectRatio, cameraToWorld);
+		}
+		else
+		{
+			frameComplete = RenderForwardCancellable(pScene, kernels, fov, aspectRatio, cameraToWorld);
+		}
+		break;
+	case RenderMode::deferred:
+		RenderDeferred(pScene, kernels, fov, aspectRatio, cameraToWorld);
+		break;
+	case RenderMode::progressive:
+		frameComplete = RenderProgressive(pScene, kernels, fov, aspectRatio, cameraToWorld, imageChanged);
+		break;
+	case RenderMode::checkerboard:
+		//Camera motion is what the reprojection handles, other changes make the history useless
+		RenderCheckerboard(pScene, kernels, fov, aspectRatio, cameraToWorld, !settingsChanged);
+		frameComplete = false;
+		break;
+	case RenderMode::shadingCache:
+		//Moving meshes are caught by the per-pixel validation, the shadows they move are bounded by the entry age.
+		//Material and light edits pass that validation, they invalidate the whole cache.
+		RenderShadingCache(pScene, kernels, fov, aspectRatio, cameraToWorld, !settingsChanged);
+		frameComplete = false;
+		break;
+	case RenderMode::accumulate:
+		//Converged, nothing left to add
+		if (!RenderAccumulated(pScene, kernels, fov, aspectRatio, cameraToWorld, imageChanged) && !m_PresentPending)
+			return false;
+		frameComplete = false;
+		break;
+	}
+
+	m_HasCachedFrame = frameComplete;
+
+	if (m_RenderMode == RenderMode::accumulate)
+		PresentFrameBuffer(m_AccumulationBuffer, 1.f / m_NrAccumulatedFrames);
+	else
+		PresentFrameBuffer(m_FrameBuffer, 1.f);
+	m_PresentPending = false;
+
+	//@END
+	//Update SDL Surface
+	m_pTarget->Present();
+	return true;
+}
+
+template<typename PixelTask>
+void Renderer::ForEachPixel(const PixelTask& pixelTask)
+{
+	const auto runTile = [&](uint32_t tileIndex)
+	{
+		const uint32_t firstX{ (tileIndex % m_NrTilesX) * TileSize }, firstY{ (tileIndex / m_NrTilesX) * TileSize };
+		const uint32_t lastX{ std::min(firstX + TileSize, uint32_t(m_Width)) }, lastY{ std::min(firstY + TileSize, uint32_t(m_Height)) };
+
+		for (uint32_t py{ firstY }; py < lastY; ++py)
+		{
+			for (uint32_t px{ firstX }; px < lastX; ++px)
+				pixelTask(px + py * m_Width);
+		}
+	};
+
+	const uint32_t nrTiles{ m_NrTilesX * m_NrTilesY };
+
 #ifdef PARALLEL_EXECUTION
+	m_pThreadPool->ParallelFor(nrTiles, runTile);
+#else
+	for (uint32_t tileIndex{}; tileIndex < nrTiles; ++tileIndex)
+		runTile(tileIndex);
+#endif
+}
+
+void Renderer::RenderForward(Scene* pScene, const PixelKernels& kernels, float fov, float aspectRatio, const Matrix& cameraToWorld)
+{
+	const uint32_t nrTiles{ m_NrTilesX * m_NrTilesY };
 
+#ifdef PARALLEL_EXECUTION
+	//Row-major tiles, so every worker's slice is a horizontal band of the frame
+	m_pThreadPool->ParallelFor(nrTiles, [&](uint32_t tileIndex) {
+		RenderTile(tileIndex, pScene, kernels, fov, aspectRatio, cameraToWorld);
+		});
+#else
+	for (uint32_t tileIndex{}; tileIndex < nrTiles; ++tileIndex)
+		RenderTile(tileIndex, pScene, kernels, fov, aspectRatio, cameraToWorld);
+#endif
+}
 
-	std::for_each(std::execution::par, m_PixelIndeces.begin(), m_PixelIndeces.end(), [&](int i) {
-		RenderPixel(pScene, i, fov, aspectRatio, cameraToWorld, camera.origin,materials,lights);
-	});
+bool Renderer::RenderForwardCancellable(Scene* pScene, const PixelKernels& kernels, float fov, float aspectRatio, const Matrix& cameraToWorld)
+{
+	const uint32_t nrTiles{ m_NrTilesX * m_NrTilesY };
+	++m_FrameNumber;
 
+	//After a cancelled frame the stalest tiles go first, so continuous input can't starve the bottom of the screen.
+	//Otherwise all tiles have the same age and the stable sort keeps the row-major bands.
+	if (m_TilesOutdated)
+	{
+		std::iota(m_TileOrder.begin(), m_TileOrder.end(), 0);
+		std::stable_sort(m_TileOrder.begin(), m_TileOrder.end(), [this](uint32_t a, uint32_t b) { return m_TileFrames[a] < m_TileFrames[b]; });
+	}
 
+	const uint32_t epoch{ m_FrameEpoch.load() };
+	const bool hasDeadline{ m_FrameDeadline > 0.f };
+	const auto deadline{ std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(m_FrameDeadline)) };
+
+	std::atomic<uint32_t> nrRenderedTiles{};
+
+	const auto renderTile = [&](uint32_t index)
+	{
+		if (m_FrameEpoch.load(std::memory_order_relaxed) != epoch || (hasDeadline && std::chrono::steady_clock::now() > deadline))
+			return;
+
+		const uint32_t tileIndex{ m_TileOrder[index] };
+		RenderTile(tileIndex, pScene, kernels, fov, aspectRatio, cameraToWorld);
+		m_TileFrames[tileIndex] = m_FrameNumber;
+		++nrRenderedTiles;
+	};
+
+#ifdef PARALLEL_EXECUTION
+	if (m_CancelCheck)
+	{
+		m_pThreadPool->ParallelFor(nrTiles, renderTile, [&] {
+			if (m_FrameEpoch.load() == epoch && m_CancelCheck())
+				CancelFrame();
+			});
+	}
+	else
+	{
+		m_pThreadPool->ParallelFor(nrTiles, renderTile);
+	}
 #else
-	for (int px{}; px < m_Width; ++px)
+	for (uint32_t index{}; index < nrTiles; ++index)
+		renderTile(index);
+#endif
+
+	m_TilesOutdated = nrRenderedTiles != nrTiles;
+	return !m_TilesOutdated;
+}
+
+void Renderer::RenderAntiAliased(Scene* pScene, const PixelKernels& kernels, float fov, float aspectRatio, const Matrix& cameraToWorld)
+{
+	const Vector3& cameraOrigin = pScene->GetCamera().origin;
+	auto& materials = pScene->GetMaterials();
+	auto& lights = pScene->GetLights();
+
+	const uint32_t gridSize{ AntiAliasingGrids[m_AntiAliasingLevel] };
+	const float cellSize{ 1.f / gridSize };
+
+	const auto traceCenter = [&](uint32_t i)
+	{
+		HitRecord primaryHit{};
+		m_ColorBuffer[i] = (this->*kernels.tracePixel)(pScene, i % m_Width + 0.5f, i / m_Width + 0.5f, fov, aspectRatio, cameraToWorld, cameraOrigin, materials, lights, primaryHit);
+
+		m_GBuffer.hitMask[i] = primaryHit.didHit;
+		m_GBuffer.normals[i] = primaryHit.normal;
+		m_GBuffer.materialIndices[i] = primaryHit.materialIndex;
+		m_GBuffer.primitiveIds[i] = primaryHit.primitiveId;
+	};
+
+	std::atomic<uint32_t> nrEdgePixels{};
+
+	const auto resolve = [&](uint32_t i)
 	{
-		for (int py{}; py < m_Height; ++py)
+		if (!IsEdgePixel(i))
 		{
-			float gradient = px / static_cast<float>(m_Width);
-			gradient += py / static_cast<float>(m_Width);
-			gradient /= 2.0f;
+			WritePixel(i, m_ColorBuffer[i]);
+			return;
+		}
 
-			float pxc = px + 0.5f;
-			float pyc = py + 0.5f;
+		++nrEdgePixels;
 
-			Vector3 rayDirection;
-			rayDirection.x = ((((2.f * pxc) / m_Width) - 1.f) * ar * camera.halfFovTan);
-			rayDirection.y = (1.f - ((2.f * pyc) / m_Height))* camera.halfFovTan;
-			rayDirection.z = 1;
-			rayDirection.Normalize();
+		//Stratified: one jittered sample per grid cell, the center sample is replaced
+		const float px{ static_cast<float>(i % m_Width) }, py{ static_cast<float>(i / m_Width) };
+		ColorRGB color{};
+		for (uint32_t sample{}; sample < gridSize * gridSize; ++sample)
+		{
+			const uint32_t seed{ i * 16 + sample };
+			const float sx{ px + (sample % gridSize + HashToUnitFloat(seed * 2)) * cellSize };
+			const float sy{ py + (sample / gridSize + HashToUnitFloat(seed * 2 + 1)) * cellSize };
 
-			rayDirection = camera.cameraToWorld.TransformVector(rayDirection);
-			rayDirection.Normalize();
+			HitRecord hit{};
+			color += (this->*kernels.tracePixel)(pScene, sx, sy, fov, aspectRatio, cameraToWorld, cameraOrigin, materials, lights, hit);
+		}
 
-			Ray viewRay{camera.origin,rayDirection };
-			ColorRGB finalColor{ };
-			HitRecord closestHit{};
+		WritePixel(i, color / static_cast<float>(gridSize * gridSize));
+	};
 
-			pScene->GetClosestHit(viewRay, closestHit);
+	ForEachPixel(traceCenter);
+	ForEachPixel(resolve);
 
-			rayDirection = -rayDirection;
-			if (closestHit.didHit)
-			{
-				
+	m_NrAntiAliasingSamples = m_NrPixels + nrEdgePixels * gridSize * gridSize;
+}
 
-				for (auto& light : lights)
-				{
-					Vector3 LightRayDirection= LightUtils::GetDirectionToLight(light, closestHit.origin);
-					LightRayDirection.Normalize();
-					Vector3 lightDirection = light.origin - closestHit.origin;
-					Vector3 lightRayOrigin = closestHit.origin + closestHit.normal * 0.0000001f;
+bool Renderer::IsEdgePixel(uint32_t pixelIndex) const
+{
+	//Minimum cosine between neighboring normals and maximum luminance difference that still count as the same surface
+	constexpr float normalTolerance{ 0.95f };
+	constexpr float luminanceTolerance{ 0.1f };
 
-					Ray lightRay{ lightRayOrigin,lightDirection.Normalized()};
-					lightRay.max = lightDirection.Magnitude();
+	const int px{ static_cast<int>(pixelIndex % m_Width) }, py{ static_cast<int>(pixelIndex / m_Width) };
+	const float luminance{ Luminance(m_ColorBuffer[pixelIndex]) };
 
-					if (m_ShadowEnabled && pScene->DoesHit(lightRay))
-					{
-						continue;
-					}
-					
+	const int offsets[4][2]{ { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+	for (const auto& offset : offsets)
+	{
+		const int nx{ px + offset[0] }, ny{ py + offset[1] };
+		if (nx < 0 || ny < 0 || nx >= m_Width || ny >= m_Height)
+			continue;
+
+		const uint32_t neighborIndex{ static_cast<uint32_t>(nx + ny * m_Width) };
+
+		if (m_GBuffer.hitMask[neighborIndex] != m_GBuffer.hitMask[pixelIndex])
+			return true;
+
+		if (!m_GBuffer.hitMask[pixelIndex])
+			continue;
+
+		if (m_GBuffer.primitiveIds[neighborIndex] != m_GBuffer.primitiveIds[pixelIndex]
+			|| m_GBuffer.materialIndices[neighborIndex] != m_GBuffer.materialIndices[pixelIndex]
+			|| Vector3::Dot(m_GBuffer.normals[neighborIndex], m_GBuffer.normals[pixelIndex]) < normalTolerance
+			|| std::abs(Luminance(m_ColorBuffer[neighborIndex]) - luminance) > luminanceTolerance)
+			return true;
+	}
+
+	return false;
+}
+
+void Renderer::RenderDeferred(Scene* pScene, const PixelKernels& kernels, float fov, float aspectRatio, const Matrix& cameraToWorld)
+{
+	const Vector3& cameraOrigin = pScene->GetCamera().origin;
+	auto& materials = pScene->GetMaterials();
+	auto& lights = pScene->GetLights();
+
+	//Primary visibility for the whole frame
+	ForEachPixel([&](uint32_t i) {
+		RenderPrimaryHit(pScene, i, fov, aspectRatio, cameraToWorld, cameraOrigin);
+		});
+
+	//Lighting, light by light so all shadow rays in flight target the same light.
+	//Batches are row-major runs of pixels, every worker's slice is about the band of rows its tiles cover.
+	const uint32_t nrLightBatches{ (m_NrPixels + LightBatchSize - 1) / LightBatchSize };
+	for (const Light& light : lights)
+	{
+		const auto shadeBatch = [&](uint32_t batchIndex)
+		{
+			(this->*kernels.shadeLightBatch)(pScene, batchIndex * LightBatchSize, light, materials);
+		};
+
+#ifdef PARALLEL_EXECUTION
+		m_pThreadPool->ParallelFor(nrLightBatches, shadeBatch);
+#else
+		for (uint32_t batchIndex{}; batchIndex < nrLightBatches; ++batchIndex)
+			shadeBatch(batchIndex);
+#endif
+	}
+
+	//Resolve
+	ForEachPixel([&](uint32_t i) {
+		WritePixel(i, m_ColorBuffer[i]);
+		});
+}
+
+void Renderer::RenderScaled(Scene* pScene, const PixelKernels& kernels, float fov, float aspectRatio, const Matrix& cameraToWorld)
+{
+	const Vector3& cameraOrigin = pScene->GetCamera().origin;
+	auto& materials = pScene->GetMaterials();
+	auto& lights = pScene->GetLights();
+
+	const float scale{ m_FrameBudget.GetScale() };
+	const uint32_t scaledWidth{ std::max(static_cast<uint32_t>(m_Width * scale + 0.5f), 1u) };
+	const uint32_t scaledHeight{ std::max(static_cast<uint32_t>(m_Height * scale + 0.5f), 1u) };
+	const float pixelWidth{ m_Width / static_cast<float>(scaledWidth) };
+	const float pixelHeight{ m_Height / static_cast<float>(scaledHeight) };
+
+	//The low resolution image goes to the front of the color buffer
+	const auto traceSample = [&](uint32_t i)
+	{
+		const uint32_t sx{ i % scaledWidth }, sy{ i / scaledWidth };
+		HitRecord primaryHit{};
+		m_ColorBuffer[i] = (this->*kernels.tracePixel)(pScene, (sx + 0.5f) * pixelWidth, (sy + 0.5f) * pixelHeight, fov, aspectRatio, cameraToWorld, cameraOrigin, materials, lights, primaryHit);
+	};
+
+	const auto upscale = [&](uint32_t i)
+	{
+		const float sx{ std::clamp((i % m_Width + 0.5f) / pixelWidth - 0.5f, 0.f, scaledWidth - 1.f) };
+		const float sy{ std::clamp((i / m_Width + 0.5f) / pixelHeight - 0.5f, 0.f, scaledHeight - 1.f) };
+
+		const uint32_t x0{ static_cast<uint32_t>(sx) }, y0{ static_cast<uint32_t>(sy) };
+		const uint32_t x1{ std::min(x0 + 1, scaledWidth - 1) }, y1{ std::min(y0 + 1, scaledHeight - 1) };
+		const float fx{ sx - x0 }, fy{ sy - y0 };
 
-					auto dot = Vector3::Dot(closestHit.normal, LightRayDirection);
-					if (dot >= 0)
+		const ColorRGB top{ ColorRGB::Lerp(m_ColorBuffer[x0 + y0 * scaledWidth], m_ColorBuffer[x1 + y0 * scaledWidth], fx) };
+		const ColorRGB bottom{ ColorRGB::Lerp(m_ColorBuffer[x0 + y1 * scaledWidth], m_ColorBuffer[x1 + y1 * scaledWidth], fx) };
+		WritePixel(i, ColorRGB::Lerp(top, bottom, fy));
+	};
+
+	//Row by row, every worker's slice is still a horizontal band of the frame
+	const auto traceRow = [&](uint32_t sy)
+	{
+		for (uint32_t sx{}; sx < scaledWidth; ++sx)
+			traceSample(sx + sy * scaledWidth);
+	};
+
+#ifdef PARALLEL_EXECUTION
+	m_pThreadPool->ParallelFor(scaledHeight, traceRow);
+#else
+	for (uint32_t sy{}; sy < scaledHeight; ++sy)
+		traceRow(sy);
+#endif
+
+	ForEachPixel(upscale);
+}
+
+void Renderer::RenderCheckerboard(Scene* pScene, const PixelKernels& kernels, float fov, float aspectRatio, const Matrix& cameraToWorld, bool historyValid)
+{
+	const Vector3& cameraOrigin = pScene->GetCamera().origin;
+	auto& materials = pScene->GetMaterials();
+	auto& lights = pScene->GetLights();
+
+	//Without history the whole frame is traced once
+	const bool traceAll{ !historyValid || !m_HasHistory };
+
+	const auto tracePixel = [&](uint32_t i)
+	{
+		HitRecord primaryHit{};
+		m_ColorBuffer[i] = (this->*kernels.tracePixel)(pScene, i % m_Width + 0.5f, i / m_Width + 0.5f, fov, aspectRatio, cameraToWorld, cameraOrigin, materials, lights, primaryHit);
+		m_DepthBuffer[i] = primaryHit.t;
+		WritePixel(i, m_ColorBuffer[i]);
+	};
+
+	const auto reconstructPixel = [&](uint32_t i)
+	{
+		m_ColorBuffer[i] = ReconstructPixel(i, fov, aspectRatio, cameraToWorld, m_DepthBuffer[i]);
+		WritePixel(i, m_ColorBuffer[i]);
+	};
+
+	const auto isTraced = [this](uint32_t i) { return static_cast<int>((i % m_Width + i / m_Width) % 2) == m_CheckerboardParity; };
+
+	if (traceAll)
+	{
+		ForEachPixel(tracePixel);
+	}
+	else
+	{
+		//The reconstruction reads the traced 4-neighbors, they have to be done first
+		ForEachPixel([&](uint32_t i) {
+			if (isTraced(i))
+				tracePixel(i);
+			});
+		ForEachPixel([&](uint32_t i) {
+			if (!isTraced(i))
+				reconstructPixel(i);
+			});
+	}
+
+	m_ColorBuffer.swap(m_HistoryColorBuffer);
+	m_DepthBuffer.swap(m_HistoryDepthBuffer);
+	m_HistoryCameraToWorld = cameraToWorld;
+	m_HasHistory = true;
+	m_CheckerboardParity = 1 - m_CheckerboardParity;
+}
+
+ColorRGB Renderer::ReconstructPixel(uint32_t pixelIndex, float fov, float aspectRatio, const Matrix& cameraToWorld, float& depth) const
+{
+	//Relative difference between the expected and the stored history depth that counts as a disocclusion
+	constexpr float depthTolerance{ 0.02f };
+
+	const int px{ static_cast<int>(pixelIndex % m_Width) }, py{ static_cast<int>(pixelIndex / m_Width) };
+
+	//The 4-neighbors were traced this frame
+	ColorRGB neighborColor{};
+	float neighborDepths[4]{};
+	int nrNeighbors{};
+
+	const int offsets[4][2]{ { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+	for (const auto& offset : offsets)
+	{
+		const int nx{ px + offset[0] }, ny{ py + offset[1] };
+		if (nx < 0 || ny < 0 || nx >= m_Width || ny >= m_Height)
+			continue;
+
+		const uint32_t neighborIndex{ static_cast<uint32_t>(nx + ny * m_Width) };
+		neighborColor += m_ColorBuffer[neighborIndex];
+		neighborDepths[nrNeighbors++] = m_DepthBuffer[neighborIndex];
+	}
+
+	//Only a 1 pixel wide and high target has none, the pixel keeps what it had last frame
+	if (nrNeighbors == 0)
+	{
+		depth = m_HistoryDepthBuffer[pixelIndex];
+		return m_HistoryColorBuffer[pixelIndex];
+	}
+
+	const Vector3 rayDirection{ CalculateRayDirection(px + 0.5f, py + 0.5f, fov, aspectRatio, cameraToWorld) };
+
+	//This pixel most likely sees the same surface as one of its neighbors, try each neighbor's depth
+	//as the hit distance and keep the first whose reprojection agrees with the history depth
+	for (int index{}; index < nrNeighbors; ++index)
+	{
+		const float candidateDepth{ neighborDepths[index] };
+		if (candidateDepth == FLT_MAX)
+			continue;
+
+		const Vector3 position{ cameraToWorld.GetTranslation() + rayDirection * candidateDepth };
+
+		const Vector3 historyPoint{ ToCameraSpace(position, m_HistoryCameraToWorld) };
+		if (historyPoint.z <= FLT_EPSILON)
+			continue;
+
+		const Vector2 historyPixel{ CameraToScreen(historyPoint, fov, aspectRatio) };
+		if (historyPixel.x < 0.f || historyPixel.y < 0.f || historyPixel.x >= m_Width || historyPixel.y >= m_Height)
+			continue;
+
+		const uint32_t historyIndex{ static_cast<uint32_t>(historyPixel.x) + static_cast<uint32_t>(historyPixel.y) * m_Width };
+
+		const float historyDepth{ historyPoint.Magnitude() };
+		if (std::abs(m_HistoryDepthBuffer[historyIndex] - historyDepth) > historyDepth * depthTolerance)
+			continue;
+
+		depth = candidateDepth;
+		return m_HistoryColorBuffer[historyIndex];
+	}
+
+	//Disoccluded or off-screen in the history, interpolate the traced neighbors
+	depth = *std::min_element(neighborDepths, neighborDepths + nrNeighbors);
+	return neighborColor / static_cast<float>(nrNeighbors);
+}
+
+void Renderer::RenderShadingCache(Scene* pScene, const PixelKernels& kernels, float fov, float aspectRatio, const Matrix& cameraToWorld, bool cacheValid)
+{
+	//Maximum distance between the cached and the new hit position, relative to the hit distance
+	constexpr float positionTolerance{ 0.01f };
+	//Minimum cosine between the cached and the new hit normal
+	constexpr float normalTolerance{ 0.99f };
+
+	const Vector3& cameraOrigin = pScene->GetCamera().origin;
+	auto& materials = pScene->GetMaterials();
+	auto& lights = pScene->GetLights();
+
+	const ShadingCache& history{ m_ShadingCaches[m_ShadingCacheIndex] };
+	ShadingCache& current{ m_ShadingCaches[1 - m_ShadingCacheIndex] };
+
+	const bool useHistory{ cacheValid && m_HasShadingCache };
+
+	const auto renderPixel = [&](uint32_t i)
+	{
+		const Vector3 rayDirection{ CalculateRayDirection(i % m_Width + 0.5f, i / m_Width + 0.5f, fov, aspectRatio, cameraToWorld) };
+
+		HitRecord primaryHit{};
+		pScene->GetClosestHit(Ray{ cameraOrigin, rayDirection }, primaryHit);
+
+		if (!primaryHit.didHit)
+		{
+			current.ages[i] = InvalidShadingAge;
+			WritePixel(i, {});
+			return;
+		}
+
+		ColorRGB color{};
+		uint8_t age{ InvalidShadingAge };
+
+		if (useHistory)
+		{
+			//Pixel that held this surface point last frame
+			const Vector3 historyPoint{ ToCameraSpace(primaryHit.origin, m_ShadingCacheCameraToWorld) };
+			if (historyPoint.z > FLT_EPSILON)
+			{
+				const Vector2 historyPixel{ CameraToScreen(historyPoint, fov, aspectRatio) };
+				if (historyPixel.x >= 0.f && historyPixel.y >= 0.f && historyPixel.x < m_Width && historyPixel.y < m_Height)
+				{
+					const uint32_t historyIndex{ static_cast<uint32_t>(historyPixel.x) + static_cast<uint32_t>(historyPixel.y) * m_Width };
+
+					if (history.ages[historyIndex] < MaxShadingAge
+						&& history.materialIndices[historyIndex] == primaryHit.materialIndex
+						&& Vector3::Dot(history.normals[historyIndex], primaryHit.normal) > normalTolerance
+						&& (history.positions[historyIndex] - primaryHit.origin).SqrMagnitude() < Square(primaryHit.t * positionTolerance))
 					{
-						finalColor += LightUtils::GetRadiance(light, closestHit.origin) * materials[closestHit.materialIndex]->Shade(closestHit,LightRayDirection,rayDirection) * dot;
+						color = history.colors[historyIndex];
+						age = history.ages[historyIndex] + 1;
 					}
-
 				}
+			}
+		}
+
+		if (age == InvalidShadingAge)
+		{
+			color = (this->*kernels.shadeHit)(pScene, primaryHit, -rayDirection, materials, lights);
+			//A fresh cache starts every pixel at its own age, so the entries don't all expire in the same frame
+			age = useHistory ? uint8_t{} : static_cast<uint8_t>(HashToUnitFloat(i) * MaxShadingAge);
+		}
+
+		current.positions[i] = primaryHit.origin;
+		current.normals[i] = primaryHit.normal;
+		current.materialIndices[i] = primaryHit.materialIndex;
+		current.colors[i] = color;
+		current.ages[i] = age;
+
+		WritePixel(i, color);
+	};
+
+	ForEachPixel(renderPixel);
+
+	m_ShadingCacheIndex = 1 - m_ShadingCacheIndex;
+	m_ShadingCacheCameraToWorld = cameraToWorld;
+	m_HasShadingCache = true;
+}
+
+bool Renderer::RenderAccumulated(Scene* pScene, const PixelKernels& kernels, float fov, float aspectRatio, const Matrix& cameraToWorld, bool imageChanged)
+{
+	if (imageChanged)
+	{
+		std::fill(m_AccumulationBuffer.begin(), m_AccumulationBuffer.end(), ColorRGB{});
+		m_NrAccumulatedFrames = 0;
+	}
+
+	if (m_NrAccumulatedFrames >= MaxAccumulatedFrames)
+		return false;
+
+	const Vector3& cameraOrigin = pScene->GetCamera().origin;
+	auto& materials = pScene->GetMaterials();
+	auto& lights = pScene->GetLights();
+
+	//The first sample goes through the pixel center so a single frame matches the forward path
+	const float offsetX{ m_NrAccumulatedFrames == 0 ? 0.5f : Halton(m_NrAccumulatedFrames, 2) };
+	const float offsetY{ m_NrAccumulatedFrames == 0 ? 0.5f : Halton(m_NrAccumulatedFrames, 3) };
 
+	const auto accumulateTile = [&](uint32_t tileIndex)
+	{
+		const uint32_t firstX{ (tileIndex % m_NrTilesX) * TileSize }, firstY{ (tileIndex / m_NrTilesX) * TileSize };
+		const uint32_t lastX{ std::min(firstX + TileSize, uint32_t(m_Width)) }, lastY{ std::min(firstY + TileSize, uint32_t(m_Height)) };
+
+		for (uint32_t py{ firstY }; py < lastY; ++py)
+		{
+			for (uint32_t px{ firstX }; px < lastX; ++px)
+			{
+				HitRecord primaryHit{};
+				m_AccumulationBuffer[px + py * m_Width] += (this->*kernels.tracePixel)(pScene, px + offsetX, py + offsetY, fov, aspectRatio, cameraToWorld, cameraOrigin, materials, lights, primaryHit);
 			}
+		}
+	};
+
+	const uint32_t nrTiles{ m_NrTilesX * m_NrTilesY };
+
+#ifdef PARALLEL_EXECUTION
+	m_pThreadPool->ParallelFor(nrTiles, accumulateTile);
+#else
+	for (uint32_t tileIndex{}; tileIndex < nrTiles; ++tileIndex)
+		accumulateTile(tileIndex);
+#endif
+
+	++m_NrAccumulatedFrames;
+	return true;
+}
+
+bool Renderer::RenderProgressive(Scene* pScene, const PixelKernels& kernels, float fov, float aspectRatio, const Matrix& cameraToWorld, bool imageChanged)
+{
+	if (imageChanged)
+		m_ProgressiveLevel = 0;
+
+	//Fully refined, from here on it renders like the forward path so animated meshes keep updating
+	if (m_ProgressiveLevel >= NrProgressiveLevels)
+	{
+		RenderForward(pScene, kernels, fov, aspectRatio, cameraToWorld);
+		return true;
+	}
+
+	const Vector3& cameraOrigin = pScene->GetCamera().origin;
+	auto& materials = pScene->GetMaterials();
+	auto& lights = pScene->GetLights();
+
+	//Only the samples that are new at this level, the coarser ones are still in the color buffer.
+	//The strides divide TileSize, every tile holds whole grid cells.
+	const uint32_t stride{ ProgressiveStrides[m_ProgressiveLevel] };
+	const uint32_t coarserStride{ m_ProgressiveLevel > 0 ? ProgressiveStrides[m_ProgressiveLevel - 1] : 0u };
+	const auto traceSample = [&](uint32_t i)
+	{
+		const uint32_t px{ i % m_Width }, py{ i / m_Width };
+		if (px % stride != 0 || py % stride != 0 || (coarserStride != 0 && px % coarserStride == 0 && py % coarserStride == 0))
+			return;
 
-			//Update Color in Buffer;
-			finalColor.MaxToOne();
+		HitRecord primaryHit{};
+		m_ColorBuffer[i] = (this->*kernels.tracePixel)(pScene, i % m_Width + 0.5f, i / m_Width + 0.5f, fov, aspectRatio, cameraToWorld, cameraOrigin, materials, lights, primaryHit);
+	};
 
-			m_pBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBuffer->format,
-				static_cast<uint8_t>(finalColor.r * 255),
-				static_cast<uint8_t>(finalColor.g * 255),
-				static_cast<uint8_t>(finalColor.b * 255));
+	//Nearest sample upscale: every pixel shows the sample at the top-left of its grid cell
+	const auto upscale = [&](uint32_t i)
+	{
+		const uint32_t px{ i % m_Width }, py{ i / m_Width };
+		WritePixel(i, m_ColorBuffer[(px - px % stride) + (py - py % stride) * m_Width]);
+	};
+
+	ForEachPixel(traceSample);
+	ForEachPixel(upscale);
+
+	++m_ProgressiveLevel;
+	return stride == 1;
+}
+
+void Renderer::RenderDirtyTiles(Scene* pScene, const PixelKernels& kernels, float fov, float aspectRatio, const Matrix& cameraToWorld)
+{
+	m_DirtyTileIndeces.clear();
+	for (uint32_t tileIndex{}; tileIndex < m_DirtyTiles.size(); ++tileIndex)
+	{
+		if (m_DirtyTiles[tileIndex])
+			m_DirtyTileIndeces.emplace_back(tileIndex);
+
+		m_DirtyTiles[tileIndex] = false;
+	}
+
+#ifdef PARALLEL_EXECUTION
+	m_pThreadPool->ParallelFor(static_cast<uint32_t>(m_DirtyTileIndeces.size()), [&](uint32_t index) {
+		RenderTile(m_DirtyTileIndeces[index], pScene, kernels, fov, aspectRatio, cameraToWorld);
+		});
+#else
+	for (uint32_t tileIndex : m_DirtyTileIndeces)
+		RenderTile(tileIndex, pScene, kernels, fov, aspectRatio, cameraToWorld);
+#endif
+}
+
+void Renderer::RenderTile(uint32_t tileIndex, Scene* pScene, const PixelKernels& kernels, float fov, float aspectRatio, const Matrix& cameraToWorld)
+{
+	const Vector3& cameraOrigin = pScene->GetCamera().origin;
+	auto& materials = pScene->GetMaterials();
+	auto& lights = pScene->GetLights();
+
+	const uint32_t firstX{ (tileIndex % m_NrTilesX) * TileSize }, firstY{ (tileIndex / m_NrTilesX) * TileSize };
+	const uint32_t lastX{ std::min(firstX + TileSize, uint32_t(m_Width)) }, lastY{ std::min(firstY + TileSize, uint32_t(m_Height)) };
+
+	for (uint32_t py{ firstY }; py < lastY; ++py)
+	{
+		for (uint32_t px{ firstX }; px < lastX; ++px)
+		{
+			HitRecord primaryHit{};
+			WritePixel(px + py * m_Width, (this->*kernels.tracePixel)(pScene, px + 0.5f, py + 0.5f, fov, aspectRatio, cameraToWorld, cameraOrigin, materials, lights, primaryHit));
 		}
 	}
+}
 
+void Renderer::CollectDirtyTiles(const Scene* pScene, const Matrix& cameraToWorld, float fov, float aspectRatio)
+{
+	const auto& lights = pScene->GetLights();
 
-#endif 
+	//Marks the screen rect of the convex hull of a set of points. The hull is clipped against a near
+	//plane first: inside points plus the crossings of every inside-outside edge bound the visible part.
+	const auto markPoints = [&](const Vector3* pPoints, int nrPoints, float padding)
+	{
+		constexpr float nearPlane{ 0.01f };
 
+		Vector3 cameraPoints[8];
+		for (int index{}; index < nrPoints; ++index)
+			cameraPoints[index] = ToCameraSpace(pPoints[index], cameraToWorld);
 
+		float minX{ FLT_MAX }, minY{ FLT_MAX }, maxX{ -FLT_MAX }, maxY{ -FLT_MAX };
+		const auto addPoint = [&](const Vector3& cameraPoint)
+		{
+			const Vector2 screenPoint{ CameraToScreen(cameraPoint, fov, aspectRatio) };
+			minX = std::min(minX, screenPoint.x);
+			minY = std::min(minY, screenPoint.y);
+			maxX = std::max(maxX, screenPoint.x);
+			maxY = std::max(maxY, screenPoint.y);
+		};
+
+		for (int inside{}; inside < nrPoints; ++inside)
+		{
+			if (cameraPoints[inside].z < nearPlane)
+				continue;
 
+			addPoint(cameraPoints[inside]);
 
-	//@END
-	//Update SDL Surface
-	SDL_UpdateWindowSurface(m_pWindow);
+			for (int outside{}; outside < nrPoints; ++outside)
+			{
+				if (cameraPoints[outside].z >= nearPlane)
+					continue;
+
+				const float t{ (cameraPoints[inside].z - nearPlane) / (cameraPoints[inside].z - cameraPoints[outside].z) };
+				addPoint(cameraPoints[inside] + (cameraPoints[outside] - cameraPoints[inside]) * t);
+			}
+		}
+
+		if (minX <= maxX)
+			MarkDirtyRect(minX - padding, minY - padding, maxX + padding, maxY + padding);
+	};
+
+	for (const auto& [boundsA, boundsB] : m_DirtyBounds)
+	{
+		Vector3 corners[8];
+		for (int index{}; index < 8; ++index)
+		{
+			corners[index] = {
+				(index & 1) ? boundsB.x : boundsA.x,
+				(index & 2) ? boundsB.y : boundsA.y,
+				(index & 4) ? boundsB.z : boundsA.z };
+		}
+
+		//Screen rect of the object itself
+		markPoints(corners, 8, 1.f);
+
+		if (!m_ShadowEnabled)
+			continue;
+
+		//Shadow rect per light: cast the corners away from the light onto whatever receives them.
+		//The rays start beyond the farthest corner so they can't hit the object itself.
+		for (const Light& light : lights)
+		{
+			float farthestCorner{};
+			for (const Vector3& corner : corners)
+				farthestCorner = std::max(farthestCorner, (corner - light.origin).Magnitude());
+
+			Vector3 receivers[8];
+			int nrReceivers{};
+			for (const Vector3& corner : corners)
+			{
+				Ray shadowRay{ light.origin, (corner - light.origin).Normalized() };
+				shadowRay.min = farthestCorner;
+
+				HitRecord receiver{};
+				pScene->GetClosestHit(shadowRay, receiver);
+				if (receiver.didHit)
+					receivers[nrReceivers++] = receiver.origin;
+			}
+
+			//Pad by a tile, the corner hits only approximate the shadow on curved receivers
+			markPoints(receivers, nrReceivers, float(TileSize));
+		}
+	}
 }
 
-void Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, const Matrix cameraToWorld, const Vector3 cameraOrigin,const std::vector<dae::Material*>& materials, const std::vector<dae::Light>& lights) const
+void Renderer::MarkDirtyRect(float minX, float minY, float maxX, float maxY)
 {
+	if (maxX < 0.f || maxY < 0.f || minX >= m_Width || minY >= m_Height)
+		return;
 
-	const uint32_t px{ pixelIndex % m_Width }, py{ pixelIndex / m_Width };
+	const uint32_t firstTileX{ static_cast<uint32_t>(std::max(minX, 0.f)) / TileSize };
+	const uint32_t firstTileY{ static_cast<uint32_t>(std::max(minY, 0.f)) / TileSize };
+	const uint32_t lastTileX{ static_cast<uint32_t>(std::min(maxX, m_Width - 1.f)) / TileSize };
+	const uint32_t lastTileY{ static_cast<uint32_t>(std::min(maxY, m_Height - 1.f)) / TileSize };
+
+	for (uint32_t tileY{ firstTileY }; tileY <= lastTileY; ++tileY)
+	{
+		for (uint32_t tileX{ firstTileX }; tileX <= lastTileX; ++tileX)
+		{
+			m_DirtyTiles[tileX + tileY * m_NrTilesX] = true;
+		}
+	}
+}
+
+Vector3 Renderer::ToCameraSpace(const Vector3& position, const Matrix& cameraToWorld)
+{
+	//Inverse of the camera transform, the rotation part is orthonormal
+	const Vector3 toPosition{ position - cameraToWorld.GetTranslation() };
+	return {
+		Vector3::Dot(toPosition, cameraToWorld.GetAxisX()),
+		Vector3::Dot(toPosition, cameraToWorld.GetAxisY()),
+		Vector3::Dot(toPosition, cameraToWorld.GetAxisZ()) };
+}
+
+Renderer::Vector2 Renderer::CameraToScreen(const Vector3& cameraPoint, float fov, float aspectRatio) const
+{
+	return {
+		(cameraPoint.x / (cameraPoint.z * aspectRatio * fov) + 1.f) * 0.5f * m_Width,
+		(1.f - cameraPoint.y / (cameraPoint.z * fov)) * 0.5f * m_Height };
+}
 
-	float rx{ px + 0.5f }, ry{ py + 0.5f };
+Vector3 Renderer::CalculateRayDirection(float rx, float ry, float fov, float aspectRatio, const Matrix& cameraToWorld) const
+{
 	float cx{ (2 * (rx / float(m_Width)) - 1) * aspectRatio * fov };
 	float cy{ (1 - (2 * (ry / float(m_Height)))) * fov };
-	
+
 
 	Vector3 rayDirection;
 	rayDirection.x = cx;
@@ -152,90 +951,212 @@ void Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float
 	rayDirection = cameraToWorld.TransformVector(rayDirection);
 	rayDirection.Normalize();
 
-	Ray viewRay{cameraOrigin,rayDirection };
-	ColorRGB finalColor{ };
-	HitRecord closestHit{};
+	return rayDirection;
+}
+
+void Renderer::PresentFrameBuffer(const std::vector<ColorRGB>& colors, float scale)
+{
+	//Rows per task, large enough that the pool overhead disappears next to the packing
+	constexpr uint32_t rowsPerBlock{ 16 };
+	const uint32_t nrBlocks{ (m_Height + rowsPerBlock - 1) / rowsPerBlock };
+
+	const auto packBlock = [&](uint32_t block)
+	{
+		const uint32_t firstPixel{ block * rowsPerBlock * m_Width };
+		const uint32_t lastPixel{ std::min(firstPixel + rowsPerBlock * m_Width, m_NrPixels) };
+		m_PixelPacker.Pack(&colors[firstPixel], m_pBufferPixels + firstPixel, lastPixel - firstPixel, scale);
+	};
+
+#ifdef PARALLEL_EXECUTION
+	m_pThreadPool->ParallelFor(nrBlocks, packBlock);
+#else
+	for (uint32_t block{}; block < nrBlocks; ++block)
+		packBlock(block);
+#endif
+}
+
+template<Renderer::LightMode lightMode, typename MaterialType>
+ColorRGB Renderer::ShadeLight(const HitRecord& hit, MaterialType* pMaterial, const Light& light, const Vector3& l, const Vector3& v)
+{
+	if constexpr (lightMode == LightMode::observed)
+	{
+		const float dot = std::max(Vector3::Dot(hit.normal, l), 0.0f);
+
+		return ColorRGB{ dot,dot,dot };
+	}
+	else if constexpr (lightMode == LightMode::radiance)
+	{
+		return LightUtils::GetRadiance(light, hit.origin);
+	}
+	else if constexpr (lightMode == LightMode::bdrf)
+	{
+		return pMaterial->Shade(hit, l, v);
+	}
+	else
+	{
+		const float dot = std::max(Vector3::Dot(hit.normal, l), 0.0f);
+
+		return LightUtils::GetRadiance(light, hit.origin) * pMaterial->Shade(hit, l, v) * dot;
+	}
+}
+
+template<Renderer::LightMode lightMode, bool shadowsEnabled, typename MaterialType>
+ColorRGB Renderer::TracePixel(Scene* pScene, float rx, float ry, float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin, const std::vector<Material*>& materials, const std::vector<Light>& lights, HitRecord& closestHit) const
+{
+	const Vector3 rayDirection{ CalculateRayDirection(rx, ry, fov, aspectRatio, cameraToWorld) };
+
+	const Ray viewRay{ cameraOrigin,rayDirection };
 
 	pScene->GetClosestHit(viewRay, closestHit);
 
-	rayDirection = -rayDirection;
+	if (!closestHit.didHit)
+		return {};
+
+	return ShadeHit<lightMode, shadowsEnabled, MaterialType>(pScene, closestHit, -rayDirection, materials, lights);
+}
+
+template<Renderer::LightMode lightMode, bool shadowsEnabled, typename MaterialType>
+ColorRGB Renderer::ShadeHit(Scene* pScene, const HitRecord& hit, const Vector3& viewDirection, const std::vector<Material*>& materials, const std::vector<Light>& lights) const
+{
+	ColorRGB finalColor{ };
+
+	//With a single material type in the scene this cast resolves Shade statically (all materials are final)
+	MaterialType* pMaterial{ static_cast<MaterialType*>(materials[hit.materialIndex]) };
 
-	if (closestHit.didHit)
+	Ray shadowRay{};
+	shadowRay.origin = hit.origin + hit.normal * 0.01f;
+
+	for (const Light& light : lights)
 	{
+		Vector3 LightRayDirection = LightUtils::GetDirectionToLight(light, hit.origin);
+		shadowRay.max = LightRayDirection.Normalize();
+		shadowRay.direction = LightRayDirection;
 
-		for (int index = 0; index < lights.size(); ++index)
+		if constexpr (shadowsEnabled)
 		{
-			Vector3 LightRayDirection = LightUtils::GetDirectionToLight(lights[index], closestHit.origin);
-		    viewRay.max = LightRayDirection.Normalize();
-			viewRay.origin = closestHit.origin + closestHit.normal * 0.01f;
-			viewRay.direction = LightRayDirection;
-
-			if (m_ShadowEnabled)
+			if (pScene->DoesHit(shadowRay))
 			{
-				if (pScene->DoesHit(viewRay))
-				{
-					continue;
-				}
+				continue;
 			}
+		}
 
-			switch (m_LightMode)
-			{
-			case dae::Renderer::LightMode::observed:
-			{
-				auto dot = std::max(Vector3::Dot(closestHit.normal, LightRayDirection),0.0f);
+		finalColor += ShadeLight<lightMode>(hit, pMaterial, light, LightRayDirection, viewDirection);
+	}
 
-				if (dot < 0)
-				{
-					finalColor = colors::Black;
-				}
+	return finalColor;
+}
 
-				finalColor += ColorRGB{ dot,dot,dot };
+void Renderer::RenderPrimaryHit(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin)
+{
+	const uint32_t px{ pixelIndex % m_Width }, py{ pixelIndex / m_Width };
 
-			}
-				break;
-			case dae::Renderer::LightMode::radiance:
-			{
-				finalColor += LightUtils::GetRadiance(lights[index], closestHit.origin);
+	const Vector3 rayDirection{ CalculateRayDirection(px + 0.5f, py + 0.5f, fov, aspectRatio, cameraToWorld) };
 
-			}
-				break;
-			case dae::Renderer::LightMode::bdrf:
-			{
-				finalColor += materials[closestHit.materialIndex]->Shade(closestHit, LightRayDirection, rayDirection);
+	const Ray viewRay{ cameraOrigin,rayDirection };
+	HitRecord closestHit{};
 
-			}
-				break;
-			case dae::Renderer::LightMode::combined:
-			{
-				auto dot = std::max(Vector3::Dot(closestHit.normal, LightRayDirection), 0.0f);
+	pScene->GetClosestHit(viewRay, closestHit);
 
-				if (dot < 0)
-				{
-					finalColor = colors::Black;
-				}
+	m_GBuffer.hitMask[pixelIndex] = closestHit.didHit;
+	m_GBuffer.positions[pixelIndex] = closestHit.origin;
+	m_GBuffer.normals[pixelIndex] = closestHit.normal;
+	m_GBuffer.viewDirections[pixelIndex] = -rayDirection;
+	m_GBuffer.materialIndices[pixelIndex] = closestHit.materialIndex;
 
-				finalColor += LightUtils::GetRadiance(lights[index], closestHit.origin) * materials[closestHit.materialIndex]->Shade(closestHit, LightRayDirection, rayDirection) * dot;
+	m_ColorBuffer[pixelIndex] = colors::Black;
+}
 
-			}
-				break;
-			}
+template<Renderer::LightMode lightMode, bool shadowsEnabled, typename MaterialType>
+void Renderer::ShadeLightBatch(Scene* pScene, uint32_t firstPixelIndex, const Light& light, const std::vector<Material*>& materials)
+{
+	const uint32_t lastPixelIndex{ std::min(firstPixelIndex + LightBatchSize, m_NrPixels) };
+
+	Ray shadowRay{};
+	HitRecord hit{};
+	hit.didHit = true;
+
+	for (uint32_t pixelIndex{ firstPixelIndex }; pixelIndex < lastPixelIndex; ++pixelIndex)
+	{
+		if (!m_GBuffer.hitMask[pixelIndex])
+			continue;
+
+		hit.origin = m_GBuffer.positions[pixelIndex];
+		hit.normal = m_GBuffer.normals[pixelIndex];
+		hit.materialIndex = m_GBuffer.materialIndices[pixelIndex];
+
+		Vector3 lightDirection = LightUtils::GetDirectionToLight(light, hit.origin);
+		shadowRay.max = lightDirection.Normalize();
 
+		if constexpr (shadowsEnabled)
+		{
+			shadowRay.origin = hit.origin + hit.normal * 0.01f;
+			shadowRay.direction = lightDirection;
+
+			if (pScene->DoesHit(shadowRay))
+				continue;
 		}
 
+		MaterialType* pMaterial{ static_cast<MaterialType*>(materials[hit.materialIndex]) };
+		m_ColorBuffer[pixelIndex] += ShadeLight<lightMode>(hit, pMaterial, light, lightDirection, m_GBuffer.viewDirections[pixelIndex]);
 	}
+}
 
-	//Update Color in Buffer;
-	finalColor.MaxToOne();
+template<typename MaterialType>
+void Renderer::FillKernelTable(PixelKernels* pTable)
+{
+	//Layout: [lightMode][shadowsEnabled]
+	pTable[0] = { &Renderer::TracePixel<LightMode::observed, false, MaterialType>, &Renderer::ShadeLightBatch<LightMode::observed, false, MaterialType>, &Renderer::ShadeHit<LightMode::observed, false, MaterialType> };
+	pTable[1] = { &Renderer::TracePixel<LightMode::observed, true, MaterialType>, &Renderer::ShadeLightBatch<LightMode::observed, true, MaterialType>, &Renderer::ShadeHit<LightMode::observed, true, MaterialType> };
+	pTable[2] = { &Renderer::TracePixel<LightMode::radiance, false, MaterialType>, &Renderer::ShadeLightBatch<LightMode::radiance, false, MaterialType>, &Renderer::ShadeHit<LightMode::radiance, false, MaterialType> };
+	pTable[3] = { &Renderer::TracePixel<LightMode::radiance, true, MaterialType>, &Renderer::ShadeLightBatch<LightMode::radiance, true, MaterialType>, &Renderer::ShadeHit<LightMode::radiance, true, MaterialType> };
+	pTable[4] = { &Renderer::TracePixel<LightMode::bdrf, false, MaterialType>, &Renderer::ShadeLightBatch<LightMode::bdrf, false, MaterialType>, &Renderer::ShadeHit<LightMode::bdrf, false, MaterialType> };
+	pTable[5] = { &Renderer::TracePixel<LightMode::bdrf, true, MaterialType>, &Renderer::ShadeLightBatch<LightMode::bdrf, true, MaterialType>, &Renderer::ShadeHit<LightMode::bdrf, true, MaterialType> };
+	pTable[6] = { &Renderer::TracePixel<LightMode::combined, false, MaterialType>, &Renderer::ShadeLightBatch<LightMode::combined, false, MaterialType>, &Renderer::ShadeHit<LightMode::combined, false, MaterialType> };
+	pTable[7] = { &Renderer::TracePixel<LightMode::combined, true, MaterialType>, &Renderer::ShadeLightBatch<LightMode::combined, true, MaterialType>, &Renderer::ShadeHit<LightMode::combined, true, MaterialType> };
+}
+
+const Renderer::PixelKernels& Renderer::SelectKernels(const Scene* pScene) const
+{
+	constexpr int nrKernelsPerSet{ NrLightModes * 2 };
 
-	m_pBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBuffer->format,
-		static_cast<uint8_t>(finalColor.r * 255),
-		static_cast<uint8_t>(finalColor.g * 255),
-		static_cast<uint8_t>(finalColor.b * 255));
+	//Dispatch table: [materialSet][lightMode][shadowsEnabled]
+	static const std::vector<PixelKernels> kernelTable = []
+	{
+		std::vector<PixelKernels> table(NrMaterialSets * nrKernelsPerSet);
+		FillKernelTable<Material>(&table[static_cast<int>(MaterialSet::mixed) * nrKernelsPerSet]);
+		FillKernelTable<Material_SolidColor>(&table[static_cast<int>(MaterialSet::solidColor) * nrKernelsPerSet]);
+		FillKernelTable<Material_Lambert>(&table[static_cast<int>(MaterialSet::lambert) * nrKernelsPerSet]);
+		FillKernelTable<Material_LambertPhong>(&table[static_cast<int>(MaterialSet::lambertPhong) * nrKernelsPerSet]);
+		FillKernelTable<Material_CookTorrence>(&table[static_cast<int>(MaterialSet::cookTorrence) * nrKernelsPerSet]);
+		return table;
+	}();
+
+	const auto& materials = pScene->GetMaterials();
+	const auto& usedMaterials = pScene->GetUsedMaterials();
+
+	MaterialSet materialSet{ MaterialSet::mixed };
+	if (UsesOnlyMaterialType<Material_SolidColor>(materials, usedMaterials))
+		materialSet = MaterialSet::solidColor;
+	else if (UsesOnlyMaterialType<Material_Lambert>(materials, usedMaterials))
+		materialSet = MaterialSet::lambert;
+	else if (UsesOnlyMaterialType<Material_LambertPhong>(materials, usedMaterials))
+		materialSet = MaterialSet::lambertPhong;
+	else if (UsesOnlyMaterialType<Material_CookTorrence>(materials, usedMaterials))
+		materialSet = MaterialSet::cookTorrence;
+
+	const int index{ static_cast<int>(materialSet) * nrKernelsPerSet + static_cast<int>(m_LightMode) * 2 + (m_ShadowEnabled ? 1 : 0) };
+	return kernelTable[index];
 }
 
-bool Renderer::SaveBufferToImage() const
+float Renderer::SaveBufferToImage(const std::string& path)
 {
-	return SDL_SaveBMP(m_pBuffer, "RayTracing_Buffer.bmp");
+	if (!ImageEncoders::IsFloatFormat(ImageEncoders::GetImageFormat(path)))
+		return m_ImageWriter.Write(m_pBuffer, path);
+
+	if (m_RenderMode == RenderMode::accumulate && m_NrAccumulatedFrames > 0)
+		return m_ImageWriter.Write(m_AccumulationBuffer.data(), m_Width, m_Height, 1.f / m_NrAccumulatedFrames, path);
+
+	return m_ImageWriter.Write(m_FrameBuffer.data(), m_Width, m_Height, 1.f, path);
 }
 
 void dae::Renderer::ToggleShadows()
@@ -245,6 +1166,167 @@ void dae::Renderer::ToggleShadows()
 
 void dae::Renderer::ToggleLightMode()
 {
-	m_LightMode = static_cast<LightMode>((static_cast<int>(m_LightMode) + 1) % 4);
+	m_LightMode = static_cast<LightMode>((static_cast<int>(m_LightMode) + 1) % NrLightModes);
 
-}
\ No newline at end of file
+}
+
+void dae::Renderer::ToggleRenderMode()
+{
+	m_RenderMode = static_cast<RenderMode>((static_cast<int>(m_RenderMode) + 1) % NrRenderModes);
+	m_ProgressiveLevel = 0;
+	m_HasHistory = false;
+	m_HasShadingCache = false;
+}
+
+void dae::Renderer::CycleAntiAliasing()
+{
+	m_AntiAliasingLevel = (m_AntiAliasingLevel + 1) % NrAntiAliasingLevels;
+	m_HasCachedFrame = false;
+
+	if (m_AntiAliasingLevel == 0)
+		std::cout << "Anti-aliasing: off" << std::endl;
+	else
+		std::cout << "Anti-aliasing: " << AntiAliasingGrids[m_AntiAliasingLevel] * AntiAliasingGrids[m_AntiAliasingLevel] << " samples per edge pixel" << std::endl;
+}
+
+void dae::Renderer::CycleToneMapping()
+{
+	using ToneMapping = PixelPacker::ToneMapping;
+
+	const ToneMapping toneMapping{ static_cast<ToneMapping>((static_cast<int>(m_PixelPacker.GetToneMapping()) + 1) % PixelPacker::NrToneMappings) };
+	m_PixelPacker.SetToneMapping(toneMapping);
+	m_PresentPending = true;
+
+	const char* names[PixelPacker::NrToneMappings]{ "max to one", "Reinhard", "ACES" };
+	std::cout << "Tone mapping: " << names[static_cast<int>(toneMapping)] << ", exposure " << m_PixelPacker.GetExposure() << std::endl;
+}
+
+void dae::Renderer::ScaleExposure(float factor)
+{
+	m_PixelPacker.SetExposure(m_PixelPacker.GetExposure() * factor);
+	m_PresentPending = true;
+
+	std::cout << "Exposure: " << m_PixelPacker.GetExposure() << std::endl;
+}
+
+void dae::Renderer::SetWorkers(uint32_t nrWorkers, bool pinWorkers)
+{
+	m_pThreadPool = std::make_unique<ThreadPool>(nrWorkers, pinWorkers);
+
+	std::cout << "Workers: " << m_pThreadPool->GetNrWorkers()
+		<< (m_pThreadPool->IsPinned() ? " pinned" : " unpinned")
+		<< ", NUMA nodes: " << m_pThreadPool->GetNrNodes() << std::endl;
+
+	TouchBuffers();
+}
+
+void dae::Renderer::TouchBuffers()
+{
+	//Same slices as the tile loops, with pinned workers every tile band is last written from the node that renders it
+	const uint32_t nrTiles{ m_NrTilesX * m_NrTilesY };
+	m_pThreadPool->ParallelFor(nrTiles, [this](uint32_t tileIndex) {
+		const uint32_t firstX{ (tileIndex % m_NrTilesX) * TileSize }, firstY{ (tileIndex / m_NrTilesX) * TileSize };
+		const uint32_t lastX{ std::min(firstX + TileSize, uint32_t(m_Width)) }, lastY{ std::min(firstY + TileSize, uint32_t(m_Height)) };
+		const uint32_t count{ lastX - firstX };
+
+		for (uint32_t py{ firstY }; py < lastY; ++py)
+		{
+			const uint32_t first{ py * m_Width + firstX };
+
+			ResetRow(m_GBuffer.positions, first, count);
+			ResetRow(m_GBuffer.normals, first, count);
+			ResetRow(m_GBuffer.viewDirections, first, count);
+			ResetRow(m_GBuffer.materialIndices, first, count);
+			ResetRow(m_GBuffer.primitiveIds, first, count);
+			ResetRow(m_GBuffer.hitMask, first, count);
+			ResetRow(m_ColorBuffer, first, count);
+			ResetRow(m_FrameBuffer, first, count);
+			ResetRow(m_AccumulationBuffer, first, count);
+			ResetRow(m_DepthBuffer, first, count);
+			ResetRow(m_HistoryColorBuffer, first, count);
+			ResetRow(m_HistoryDepthBuffer, first, count);
+
+			for (ShadingCache& cache : m_ShadingCaches)
+			{
+				ResetRow(cache.positions, first, count);
+				ResetRow(cache.normals, first, count);
+				ResetRow(cache.colors, first, count);
+				ResetRow(cache.materialIndices, first, count);
+				ResetRow(cache.ages, first, count, InvalidShadingAge);
+			}
+		}
+		});
+
+	//Everything that was kept in the buffers is gone
+	m_NrAccumulatedFrames = 0;
+	m_HasCachedFrame = false;
+	m_HasHistory = false;
+	m_HasShadingCache = false;
+}
+
+void dae::Renderer::PrintScalingReport(Scene* pScene)
+{
+	constexpr int nrFrames{ 5 };
+
+	Camera& camera = pScene->GetCamera();
+	const Matrix cameraToWorld = camera.CalculateCameraToWorld();
+	const float aspectRatio = m_Width / static_cast<float>(m_Height);
+	const float fov = tan(camera.fovAngle * TO_RADIANS / 2.f);
+	const PixelKernels& kernels = SelectKernels(pScene);
+
+	const uint32_t nrWorkers{ m_pThreadPool->GetNrWorkers() };
+	const bool pinWorkers{ m_pThreadPool->IsPinned() };
+	const uint32_t maxWorkers{ ThreadPool::GetNrHardwareThreads() };
+
+	std::cout << "Scaling report, forward path, " << nrFrames << " frames per worker count" << std::endl;
+
+	float singleWorkerTime{};
+	for (uint32_t workers{ 1 }; ; workers = std::min(workers * 2, maxWorkers))
+	{
+		m_pThreadPool = std::make_unique<ThreadPool>(workers, pinWorkers);
+
+		//Warm up, the first frame pays for waking the workers
+		RenderForward(pScene, kernels, fov, aspectRatio, cameraToWorld);
+
+		const uint64_t start{ SDL_GetPerformanceCounter() };
+		for (int frame{}; frame < nrFrames; ++frame)
+			RenderForward(pScene, kernels, fov, aspectRatio, cameraToWorld);
+		const float frameTime{ 1000.f * (SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency() / nrFrames };
+
+		if (workers == 1)
+			singleWorkerTime = frameTime;
+
+		const float speedup{ singleWorkerTime / frameTime };
+		std::cout << "  " << workers << " workers: " << frameTime << " ms, speedup " << speedup << "x, efficiency " << 100.f * speedup / workers << "%" << std::endl;
+
+		if (workers == maxWorkers)
+			break;
+	}
+
+	m_pThreadPool = std::make_unique<ThreadPool>(nrWorkers, pinWorkers);
+	TouchBuffers();
+}
+
+void dae::Renderer::ToggleDynamicResolution()
+{
+	m_DynamicResolutionEnabled = !m_DynamicResolutionEnabled;
+	m_FrameBudget.Reset();
+}
+
+void dae::Renderer::UpdateFrameBudget(float frameTime)
+{
+	if (!m_DynamicResolutionEnabled || !m_FrameBudget.Update(frameTime))
+		return;
+
+	const float scale{ m_FrameBudget.GetScale() };
+	std::cout << "Render scale: " << scale
+		<< " (" << static_cast<int>(m_Width * scale + 0.5f) << "x" << static_cast<int>(m_Height * scale + 0.5f) << ")"
+		<< ", frame " << frameTime * 1000.f << " ms"
+		<< ", target " << m_FrameBudget.GetTargetFrameTime() * 1000.f << " ms" << std::endl;
+}
+
+void dae::Renderer::ToggleFrameCache()
+{
+	m_FrameCacheEnabled = !m_FrameCacheEnabled;
+	m_HasCachedFrame = false;
+}
@@ -1,8 +1,20 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
 #include <vector>
-struct SDL_Window;
+
+#include "ColorRGB.h"
+#include "FrameBudgetController.h"
+#include "ImageWriter.h"
+#include "Matrix.h"
+#include "PixelPacker.h"
+#include "ThreadPool.h"
+#include "Vector3.h"
 struct SDL_Surface;
 
 
@@ -10,15 +22,15 @@ namespace dae
 {
 	class Scene;
 	class Material;
-	
-	struct Matrix;
-	struct Vector3;
+	class RenderTarget;
+
 	struct Light;
+	struct HitRecord;
 
 	class Renderer final
 	{
 	public:
-		Renderer(SDL_Window* pWindow);
+		Renderer(RenderTarget* pTarget);
 		~Renderer() = default;
 
 
@@ -27,18 +39,51 @@ namespace dae
 		Renderer& operator=(const Renderer&) = delete;
 		Renderer& operator=(Renderer&&) noexcept = delete;
 
-		void Render(Scene* pScene) const;
+		//Returns false when the frame was skipped because nothing changed (frame cache)
+		bool Render(Scene* pScene);
 
-		void RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, const Matrix cameraToWorld, const Vector3 cameraOrigin, const std::vector<dae::Material*>& materials, const std::vector<dae::Light>& lights)const;
-
-		bool SaveBufferToImage() const;
+		/**
+		 * \brief Queues the current frame on the image writer, encoded on its thread in the format of the path's extension.
+		 * PFM and EXR receive the linear colors of the frame buffer, the other formats the tone mapped surface.
+		 * \return seconds spent waiting for the writer to free a buffer
+		 */
+		float SaveBufferToImage(const std::string& path = "RayTracing_Buffer.png");
+		ImageWriter& GetImageWriter() { return m_ImageWriter; }
 
 		void ToggleShadows();
 		void ToggleLightMode();
+		void ToggleRenderMode();
+		void ToggleFrameCache();
+		void ToggleDynamicResolution();
+		//Steps through the anti-aliasing quality levels, from off to the densest sample grid
+		void CycleAntiAliasing();
+
+		//Primary samples the anti-aliased forward path traced in the last frame, 0 when it was not used
+		uint32_t GetNrAntiAliasingSamples() const { return m_NrAntiAliasingSamples; }
+
+		//Tone mapping of the presented frame, takes effect without re-rendering
+		void CycleToneMapping();
+		void ScaleExposure(float factor);
+
+		//Worker threads of the tile loops, nrWorkers 0 uses every hardware thread
+		void SetWorkers(uint32_t nrWorkers, bool pinWorkers);
+		//Renders the current view with 1, 2, 4 ... all hardware threads and prints the frame times
+		void PrintScalingReport(Scene* pScene);
+
+		//Abandons the forward frame in flight, tiles that are already done stay on screen. Safe to call from any thread.
+		void CancelFrame() { ++m_FrameEpoch; }
+		//Polled by the render thread while the workers trace, returning true cancels the frame
+		void SetCancelCheck(std::function<bool()> cancelCheck) { m_CancelCheck = std::move(cancelCheck); }
+		//Forward frames stop starting new tiles after this many seconds, 0 disables the deadline
+		void SetFrameDeadline(float frameDeadline) { m_FrameDeadline = frameDeadline; }
+
+		//Dynamic resolution: feed the duration of every frame, the forward path then renders at a scale that fits the target
+		void UpdateFrameBudget(float frameTime);
+		void SetTargetFrameTime(float targetFrameTime) { m_FrameBudget.SetTargetFrameTime(targetFrameTime); }
 
 
 	private:
-		SDL_Window* m_pWindow{};
+		RenderTarget* m_pTarget{};
 
 		enum class LightMode
 		{
@@ -49,17 +94,234 @@ namespace dae
 
 		};
 
+		enum class RenderMode
+		{
+			forward,
+			deferred,
+			progressive,
+			checkerboard,
+			shadingCache,
+			accumulate
+		};
+
+		//Material types the pixel kernel can be specialized for, 'mixed' falls back to the virtual Shade call
+		enum class MaterialSet
+		{
+			mixed,
+			solidColor,
+			lambert,
+			lambertPhong,
+			cookTorrence
+		};
+
+		static constexpr int NrLightModes{ 4 };
+		static constexpr int NrMaterialSets{ 5 };
+		static constexpr int NrRenderModes{ 6 };
+
+		//Progressive mode traces 1/16, then 1/4, then all pixels, stride of the sample grid per level
+		static constexpr int NrProgressiveLevels{ 3 };
+		static constexpr uint32_t ProgressiveStrides[NrProgressiveLevels]{ 4, 2, 1 };
+
+		//Number of consecutive G-buffer entries a deferred lighting task processes
+		static constexpr uint32_t LightBatchSize{ 64 };
+
+		//Width and height of the tiles the frame cache re-renders
+		static constexpr uint32_t TileSize{ 16 };
+
+		//Anti-aliasing: samples per axis that edge pixels receive at each quality level, level 0 disables it
+		static constexpr int NrAntiAliasingLevels{ 4 };
+		static constexpr uint32_t AntiAliasingGrids[NrAntiAliasingLevels]{ 1, 2, 3, 4 };
+
+		//Accumulate mode stops adding samples after this many frames of a static view
+		static constexpr uint32_t MaxAccumulatedFrames{ 1024 };
+
+		//Shading cache: frames a cached color may be reused before the pixel is shaded again
+		static constexpr uint8_t MaxShadingAge{ 8 };
+		static constexpr uint8_t InvalidShadingAge{ 255 };
+
+		using TracePixelFunction = ColorRGB (Renderer::*)(Scene*, float, float, float, float, const Matrix&, const Vector3&, const std::vector<Material*>&, const std::vector<Light>&, HitRecord&) const;
+		using ShadeHitFunction = ColorRGB (Renderer::*)(Scene*, const HitRecord&, const Vector3&, const std::vector<Material*>&, const std::vector<Light>&) const;
+		using ShadeLightBatchFunction = void (Renderer::*)(Scene*, uint32_t, const Light&, const std::vector<Material*>&);
+
+		struct Vector2
+		{
+			float x{};
+			float y{};
+		};
+
+		struct PixelKernels
+		{
+			TracePixelFunction tracePixel{};
+			ShadeLightBatchFunction shadeLightBatch{};
+			ShadeHitFunction shadeHit{};
+		};
+
+		//Primary hits of the deferred and anti-aliased paths, one array per attribute so the passes stream through them
+		struct GBuffer
+		{
+			std::vector<Vector3> positions{};
+			std::vector<Vector3> normals{};
+			std::vector<Vector3> viewDirections{};
+			std::vector<unsigned char> materialIndices{};
+			std::vector<uint32_t> primitiveIds{};
+			std::vector<uint8_t> hitMask{};
+		};
+
+		//Shaded primary hits of one frame, a pixel reuses the color when its hit reprojects onto a matching entry
+		struct ShadingCache
+		{
+			std::vector<Vector3> positions{};
+			std::vector<Vector3> normals{};
+			std::vector<ColorRGB> colors{};
+			std::vector<unsigned char> materialIndices{};
+			std::vector<uint8_t> ages{};
+		};
+
 		LightMode m_LightMode{ LightMode::combined };
+		RenderMode m_RenderMode{ RenderMode::forward };
+
+		std::unique_ptr<ThreadPool> m_pThreadPool{ std::make_unique<ThreadPool>() };
 
 		SDL_Surface* m_pBuffer{};
 		uint32_t* m_pBufferPixels{};
+		PixelPacker m_PixelPacker;
+
+		//Linear output of the render paths, packed into the surface in one pass per frame
+		std::vector<ColorRGB> m_FrameBuffer{};
+		//Set when only the tone mapping changed, a skipped frame is still presented again
+		bool m_PresentPending{ false };
+
+		//Screenshots, encoded and saved off the render thread
+		ImageWriter m_ImageWriter{ 4 };
+
+		//HDR sum of every sample since the view last changed (accumulate mode), divided by the frame count when presented
+		std::vector<ColorRGB> m_AccumulationBuffer{};
+		uint32_t m_NrAccumulatedFrames{};
 
 		bool m_ShadowEnabled{ true };
 
 		int m_Width{};
 		int m_Height{};
 
-		std::vector<uint32_t> m_PixelIndeces{};
 		uint32_t m_NrPixels{};
+
+		GBuffer m_GBuffer{};
+		std::vector<ColorRGB> m_ColorBuffer{};
+
+		//View of the previous frame, any difference invalidates cached results
+		Matrix m_PreviousCameraToWorld{};
+		float m_PreviousFov{};
+		const PixelKernels* m_pPreviousKernels{};
+
+		//Frame cache, only the tiles covered by moving meshes (and their shadows) are re-rendered
+		bool m_FrameCacheEnabled{ false };
+		bool m_HasCachedFrame{ false };
+
+		uint32_t m_NrTilesX{};
+		uint32_t m_NrTilesY{};
+		std::vector<uint8_t> m_DirtyTiles{};
+		std::vector<uint32_t> m_DirtyTileIndeces{};
+		std::vector<std::pair<Vector3, Vector3>> m_DirtyBounds{};
+
+		//Cancellation of the forward path, workers compare the epoch and the deadline between tiles
+		std::atomic<uint32_t> m_FrameEpoch{};
+		std::function<bool()> m_CancelCheck{};
+		float m_FrameDeadline{};
+		//Frame number at which each tile was last completed, tiles left over by a cancelled frame go first next time
+		uint32_t m_FrameNumber{};
+		std::vector<uint32_t> m_TileFrames{};
+		std::vector<uint32_t> m_TileOrder{};
+		bool m_TilesOutdated{ false };
+
+		//Dynamic resolution of the forward path
+		bool m_DynamicResolutionEnabled{ false };
+		FrameBudgetController m_FrameBudget{};
+
+		//Edge-adaptive anti-aliasing of the forward path
+		int m_AntiAliasingLevel{};
+		uint32_t m_NrAntiAliasingSamples{};
+
+		//Checkerboard mode, half of the pixels per frame, the rest is reprojected from the history
+		int m_CheckerboardParity{};
+		bool m_HasHistory{ false };
+		Matrix m_HistoryCameraToWorld{};
+		std::vector<float> m_DepthBuffer{};
+		std::vector<ColorRGB> m_HistoryColorBuffer{};
+		std::vector<float> m_HistoryDepthBuffer{};
+
+		//Shading cache mode, double buffered: the previous frame's cache is read while the current one is written
+		ShadingCache m_ShadingCaches[2]{};
+		int m_ShadingCacheIndex{};
+		bool m_HasShadingCache{ false };
+		Matrix m_ShadingCacheCameraToWorld{};
+
+		//Progressive mode, level of the sample grid the next frame adds
+		int m_ProgressiveLevel{};
+
+		//Calls pixelTask(pixelIndex) for every pixel, tile by tile on the thread pool with the same slices as the tile loops
+		template<typename PixelTask>
+		void ForEachPixel(const PixelTask& pixelTask);
+
+		void RenderForward(Scene* pScene, const PixelKernels& kernels, float fov, float aspectRatio, const Matrix& cameraToWorld);
+		//Forward path that stops between tiles when the frame is cancelled or runs past its deadline, returns true when every tile was rendered
+		bool RenderForwardCancellable(Scene* pScene, const PixelKernels& kernels, float fov, float aspectRatio, const Matrix& cameraToWorld);
+		//One sample per pixel, then a stratified grid of extra samples for pixels on geometry or shading edges
+		void RenderAntiAliased(Scene* pScene, const PixelKernels& kernels, float fov, float aspectRatio, const Matrix& cameraToWorld);
+		bool IsEdgePixel(uint32_t pixelIndex) const;
+		void RenderDeferred(Scene* pScene, const PixelKernels& kernels, float fov, float aspectRatio, const Matrix& cameraToWorld);
+		//Traces at the frame budget's scale and upscales bilinearly into the surface
+		void RenderScaled(Scene* pScene, const PixelKernels& kernels, float fov, float aspectRatio, const Matrix& cameraToWorld);
+		void RenderCheckerboard(Scene* pScene, const PixelKernels& kernels, float fov, float aspectRatio, const Matrix& cameraToWorld, bool historyValid);
+		//Color of an untraced pixel from the history, or from its traced neighbors on disocclusion, depth receives the estimated hit distance
+		ColorRGB ReconstructPixel(uint32_t pixelIndex, float fov, float aspectRatio, const Matrix& cameraToWorld, float& depth) const;
+		//Traces every primary ray but only runs the light loop for pixels without a valid cache entry
+		void RenderShadingCache(Scene* pScene, const PixelKernels& kernels, float fov, float aspectRatio, const Matrix& cameraToWorld, bool cacheValid);
+		//Adds one jittered sample per pixel to the accumulation buffer, returns false once it has converged
+		bool RenderAccumulated(Scene* pScene, const PixelKernels& kernels, float fov, float aspectRatio, const Matrix& cameraToWorld, bool imageChanged);
+		//Returns true once the frame is at full resolution
+		bool RenderProgressive(Scene* pScene, const PixelKernels& kernels, float fov, float aspectRatio, const Matrix& cameraToWorld, bool imageChanged);
+
+		//Rewrites every per-pixel buffer tile by tile on the current workers, each tile from the worker that renders it
+		void TouchBuffers();
+
+		void RenderDirtyTiles(Scene* pScene, const PixelKernels& kernels, float fov, float aspectRatio, const Matrix& cameraToWorld);
+		void RenderTile(uint32_t tileIndex, Scene* pScene, const PixelKernels& kernels, float fov, float aspectRatio, const Matrix& cameraToWorld);
+
+		//Marks the tiles covered by m_DirtyBounds and the shadows they cast
+		void CollectDirtyTiles(const Scene* pScene, const Matrix& cameraToWorld, float fov, float aspectRatio);
+		void MarkDirtyRect(float minX, float minY, float maxX, float maxY);
+
+		static Vector3 ToCameraSpace(const Vector3& position, const Matrix& cameraToWorld);
+		Vector2 CameraToScreen(const Vector3& cameraPoint, float fov, float aspectRatio) const;
+
+		Vector3 CalculateRayDirection(float rx, float ry, float fov, float aspectRatio, const Matrix& cameraToWorld) const;
+		void WritePixel(uint32_t pixelIndex, const ColorRGB& color) { m_FrameBuffer[pixelIndex] = color; }
+		//Tone maps colors (scaled by scale) into the surface's pixel format
+		void PresentFrameBuffer(const std::vector<ColorRGB>& colors, float scale);
+
+		//Pixel kernel without any mode branches, one instantiation per LightMode x shadow x material set.
+		//Traces the ray through raster position (rx, ry) and returns its linear color, closestHit receives the primary hit.
+		template<LightMode lightMode, bool shadowsEnabled, typename MaterialType>
+		ColorRGB TracePixel(Scene* pScene, float rx, float ry, float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin, const std::vector<Material*>& materials, const std::vector<Light>& lights, HitRecord& closestHit) const;
+
+		//Light loop (and shadow rays) of one primary hit, viewDirection points from the hit towards the camera
+		template<LightMode lightMode, bool shadowsEnabled, typename MaterialType>
+		ColorRGB ShadeHit(Scene* pScene, const HitRecord& hit, const Vector3& viewDirection, const std::vector<Material*>& materials, const std::vector<Light>& lights) const;
+
+		//Deferred path: fills the G-buffer for one pixel
+		void RenderPrimaryHit(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin);
+
+		//Deferred path: accumulates a single light into LightBatchSize G-buffer entries starting at firstPixelIndex
+		template<LightMode lightMode, bool shadowsEnabled, typename MaterialType>
+		void ShadeLightBatch(Scene* pScene, uint32_t firstPixelIndex, const Light& light, const std::vector<Material*>& materials);
+
+		//Contribution of one unshadowed light, shared by the forward and deferred kernels
+		template<LightMode lightMode, typename MaterialType>
+		static ColorRGB ShadeLight(const HitRecord& hit, MaterialType* pMaterial, const Light& light, const Vector3& l, const Vector3& v);
+
+		template<typename MaterialType>
+		static void FillKernelTable(PixelKernels* pTable);
+
+		const PixelKernels& SelectKernels(const Scene* pScene) const;
 	};
 }
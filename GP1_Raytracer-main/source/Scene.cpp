@@ -1,6 +1,20 @@
 #include "Scene.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <unordered_set>
+#include <utility>
+
 #include "Utils.h"
+#include "CompactMesh.h"
 #include "Material.h"
+#include "MeshCache.h"
+#include "MeshClusters.h"
+#include "SceneFile.h"
 
 namespace dae {
 
@@ -28,23 +42,34 @@ namespace dae {
 
 	void dae::Scene::GetClosestHit(const Ray& ray, HitRecord& closestHit) const
 	{
-		
+		uint32_t primitiveId{};
+
 		for (const auto& plane : m_PlaneGeometries)
 		{
-			GeometryUtils::HitTest_Plane(plane, ray, closestHit);
+			if (GeometryUtils::HitTest_Plane(plane, ray, closestHit))
+				closestHit.primitiveId = primitiveId;
+			++primitiveId;
 		}
 		for (const auto& sphere : m_SphereGeometries)
 		{
-			GeometryUtils::HitTest_Sphere(sphere, ray, closestHit);
-		
+			if (GeometryUtils::HitTest_Sphere(sphere, ray, closestHit))
+				closestHit.primitiveId = primitiveId;
+			++primitiveId;
 		}
 		for (const auto& triangles : m_Triangles)
 		{
-			GeometryUtils::HitTest_Triangle(triangles, ray, closestHit);
+			if (GeometryUtils::HitTest_Triangle(triangles, ray, closestHit))
+				closestHit.primitiveId = primitiveId;
+			++primitiveId;
 		}
 		for (const auto& triangleMeshes : m_TriangleMeshGeometries)
 		{
+			//The mesh test returns true for any earlier hit as well, compare distances instead
+			const float previousT{ closestHit.t };
 			GeometryUtils::HitTest_TriangleMesh(triangleMeshes, ray, closestHit);
+			if (closestHit.t < previousT)
+				closestHit.primitiveId = primitiveId;
+			++primitiveId;
 		}
 	}
 
@@ -78,6 +103,69 @@ namespace dae {
 		return false;
 	}
 
+	bool Scene::ConsumeChanges(std::vector<std::pair<Vector3, Vector3>>& dirtyBounds)
+	{
+		for (auto& mesh : m_TriangleMeshGeometries)
+		{
+			if (!mesh.isDirty)
+				continue;
+
+			dirtyBounds.emplace_back(mesh.previousTransformedMinAABB, mesh.previousTransformedMaxAABB);
+			dirtyBounds.emplace_back(mesh.transformedMinAABB, mesh.transformedMaxAABB);
+			mesh.isDirty = false;
+		}
+
+		const bool isDirty{ m_IsDirty };
+		m_IsDirty = false;
+		return isDirty;
+	}
+
+	void Scene::PrintMeshMemoryUsage() const
+	{
+		const auto getBytes = [](const auto& vector) { return vector.capacity() * sizeof(vector[0]); };
+
+		std::unordered_set<const void*> sharedData{};
+		size_t nrTriangles{};
+		size_t nrCompact{};
+		size_t nrStreamed{};
+		size_t nrMapped{};
+		size_t bytes{};
+		for (const TriangleMesh& mesh : m_TriangleMeshGeometries)
+		{
+			bytes += sizeof(TriangleMesh) + getBytes(mesh.positions) + getBytes(mesh.normals) + getBytes(mesh.vertexNormals) + getBytes(mesh.indices)
+				+ getBytes(mesh.transformedPositions) + getBytes(mesh.transformedNormals) + getBytes(mesh.transformedVertexNormals);
+			nrTriangles += mesh.indices.size() / 3;
+
+			if (mesh.pCompact)
+			{
+				++nrCompact;
+				nrTriangles += mesh.pCompact->GetNrTriangles();
+				if (sharedData.insert(mesh.pCompact.get()).second)
+					bytes += mesh.pCompact->GetMemoryUsage();
+			}
+			else if (mesh.pClusters)
+			{
+				++nrStreamed;
+				nrTriangles += mesh.pClusters->GetNrTriangles();
+				if (sharedData.insert(mesh.pClusters.get()).second)
+					bytes += mesh.pClusters->GetMemoryUsage();
+			}
+			else if (mesh.pMapped)
+			{
+				//The triangles are file pages the OS can drop and read again, they aren't counted
+				++nrMapped;
+				nrTriangles += mesh.pMapped->normals.size();
+			}
+		}
+
+		if (nrTriangles == 0)
+			return;
+
+		std::cout << "Meshes: " << m_TriangleMeshGeometries.size() << " (" << nrCompact << " compact, " << nrStreamed << " streamed, " << nrMapped << " mapped), "
+			<< nrTriangles << " triangles, " << bytes / (1024.0 * 1024.0) << " MB, " << static_cast<double>(bytes) / nrTriangles
+			<< " bytes per triangle" << std::endl;
+	}
+
 #pragma region Scene Helpers
 	Sphere* Scene::AddSphere(const Vector3& origin, float radius, unsigned char materialIndex)
 	{
@@ -86,6 +174,8 @@ namespace dae {
 		s.radius = radius;
 		s.materialIndex = materialIndex;
 
+		m_IsDirty = true;
+		m_UsedMaterials.set(materialIndex);
 		m_SphereGeometries.emplace_back(s);
 		return &m_SphereGeometries.back();
 	}
@@ -97,6 +187,8 @@ namespace dae {
 		p.normal = normal;
 		p.materialIndex = materialIndex;
 
+		m_IsDirty = true;
+		m_UsedMaterials.set(materialIndex);
 		m_PlaneGeometries.emplace_back(p);
 		return &m_PlaneGeometries.back();
 	}
@@ -107,10 +199,108 @@ namespace dae {
 		m.cullMode = cullMode;
 		m.materialIndex = materialIndex;
 
+		m_IsDirty = true;
+		m_UsedMaterials.set(materialIndex);
 		m_TriangleMeshGeometries.emplace_back(m);
 		return &m_TriangleMeshGeometries.back();
 	}
 
+	std::vector<TriangleMesh*> Scene::AddTriangleMeshes(const std::string& objPath, TriangleCullMode cullMode, unsigned char materialIndex,
+		const std::unordered_map<std::string, unsigned char>& materialsByName)
+	{
+		const auto loadStart{ std::chrono::steady_clock::now() };
+
+		//The OBJ file is only parsed when its cache is missing or stale
+		const std::string cachePath{ MeshCache::UpdateCache(objPath) };
+		if (cachePath.empty())
+			return {};
+
+		//Stays mapped as long as one of its meshes is alive, they read their triangles from it in place
+		const std::shared_ptr<const MeshCache> pCache{ std::make_shared<const MeshCache>(cachePath) };
+		if (!pCache->IsOpen())
+		{
+			std::cout << "Could not read " << cachePath << std::endl;
+			return {};
+		}
+
+		const size_t firstMesh{ m_TriangleMeshGeometries.size() };
+		size_t nrTriangles{};
+		for (const MeshCache::MeshView& view : pCache->GetMeshes())
+		{
+			const auto materialIt{ materialsByName.find(std::string{ view.materialName }) };
+
+			TriangleMesh& mesh{ m_TriangleMeshGeometries.emplace_back() };
+			mesh.cullMode = cullMode;
+			mesh.materialIndex = materialIt != materialsByName.end() ? materialIt->second : materialIndex;
+			mesh.pMapped = std::shared_ptr<const MeshCache::MeshView>{ pCache, &view };
+			mesh.minAABB = view.minAABB;
+			mesh.maxAABB = view.maxAABB;
+			mesh.UpdateTransforms();
+
+			m_UsedMaterials.set(mesh.materialIndex);
+			nrTriangles += view.normals.size();
+		}
+
+		//Only now, adding meshes may have moved the earlier ones
+		std::vector<TriangleMesh*> meshes{};
+		for (size_t index{ firstMesh }; index < m_TriangleMeshGeometries.size(); ++index)
+			meshes.emplace_back(&m_TriangleMeshGeometries[index]);
+
+		std::cout << "Added " << objPath << ": " << meshes.size() << " meshes, " << nrTriangles << " triangles in "
+			<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count() << " ms" << std::endl;
+
+		m_IsDirty = true;
+		return meshes;
+	}
+
+	std::vector<TriangleMesh*> Scene::AddStreamedTriangleMeshes(const std::string& objPath, TriangleCullMode cullMode, unsigned char materialIndex,
+		const std::unordered_map<std::string, unsigned char>& materialsByName)
+	{
+		const auto loadStart{ std::chrono::steady_clock::now() };
+
+		const std::string clusterPath{ MeshClusters::UpdateClusters(objPath) };
+		if (clusterPath.empty())
+			return {};
+
+		const std::vector<std::shared_ptr<const MeshClusters>> clusters{ MeshClusters::Open(clusterPath) };
+		if (clusters.empty())
+		{
+			std::cout << "Could not read " << clusterPath << std::endl;
+			return {};
+		}
+
+		const size_t firstMesh{ m_TriangleMeshGeometries.size() };
+		size_t nrTriangles{};
+		size_t nrClusters{};
+		for (const std::shared_ptr<const MeshClusters>& pClusters : clusters)
+		{
+			const auto materialIt{ materialsByName.find(pClusters->GetMaterialName()) };
+
+			TriangleMesh& mesh{ m_TriangleMeshGeometries.emplace_back() };
+			mesh.cullMode = cullMode;
+			mesh.materialIndex = materialIt != materialsByName.end() ? materialIt->second : materialIndex;
+			mesh.minAABB = pClusters->GetMinAABB();
+			mesh.maxAABB = pClusters->GetMaxAABB();
+			mesh.pClusters = pClusters;
+			mesh.UpdateTransforms();
+
+			m_UsedMaterials.set(mesh.materialIndex);
+			nrTriangles += pClusters->GetNrTriangles();
+			nrClusters += pClusters->GetNrClusters();
+		}
+
+		std::vector<TriangleMesh*> meshes{};
+		for (size_t index{ firstMesh }; index < m_TriangleMeshGeometries.size(); ++index)
+			meshes.emplace_back(&m_TriangleMeshGeometries[index]);
+
+		std::cout << "Added " << objPath << ": " << meshes.size() << " meshes, " << nrTriangles << " triangles streamed in " << nrClusters
+			<< " clusters of " << MeshClusters::PageSize / 1024 << " KB in "
+			<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count() << " ms" << std::endl;
+
+		m_IsDirty = true;
+		return meshes;
+	}
+
 	Light* Scene::AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color)
 	{
 		Light l;
@@ -119,6 +309,7 @@ namespace dae {
 		l.color = color;
 		l.type = LightType::Point;
 
+		m_IsDirty = true;
 		m_Lights.emplace_back(l);
 		return &m_Lights.back();
 	}
@@ -131,12 +322,14 @@ namespace dae {
 		l.color = color;
 		l.type = LightType::Directional;
 
+		m_IsDirty = true;
 		m_Lights.emplace_back(l);
 		return &m_Lights.back();
 	}
 
 	unsigned char Scene::AddMaterial(Material* pMaterial)
 	{
+		m_IsDirty = true;
 		m_Materials.push_back(pMaterial);
 		return static_cast<unsigned char>(m_Materials.size() - 1);
 	}
@@ -251,15 +444,10 @@ namespace dae {
 		AddPlane(Vector3{ 5.f, 0.f, 0.f }, Vector3{ -1.f, 0.f, 0.f }, matLambert_GrayBlue); //RIGHT
 		AddPlane(Vector3{ -5.f, 0.f, 0.f }, Vector3{ 1.f, 0.f, 0.f }, matLambert_GrayBlue); //LEFT
 
-		pMesh = AddTriangleMesh(TriangleCullMode::FrontFaceCulling, matLambert_White);
-		//Utils::ParseOBJ("Resources/simple_cube.obj",
-		Utils::ParseOBJ("Resources/lowpoly_bunny2.obj",
-			pMesh->positions, 
-			pMesh->normals, 
-			pMesh->indices);
+		const std::vector<TriangleMesh*> meshes{ AddTriangleMeshes("Resources/lowpoly_bunny2.obj", TriangleCullMode::FrontFaceCulling, matLambert_White) };
+		pMesh = meshes.empty() ? AddTriangleMesh(TriangleCullMode::FrontFaceCulling, matLambert_White) : meshes.front();
 
 		pMesh->Scale({2.f,2.f,2.f});
-		pMesh->UpdateAABB();
 		pMesh->UpdateTransforms();
 
 
@@ -391,4 +579,674 @@ namespace dae {
 		AddPointLight(Vector3{ 2.5f, 2.5f, -5.f }, 50.f, ColorRGB{ .34f, .47f, .68f });
 	}
 
+#pragma region SCENE FILE
+	namespace
+	{
+		Material* CreateMaterial(const SceneDescription::MaterialEntry& material)
+		{
+			const float* pParameters{ material.parameters };
+			switch (material.type)
+			{
+			case SceneDescription::MaterialType::lambert:
+				return new Material_Lambert(material.color, pParameters[0]);
+			case SceneDescription::MaterialType::lambertPhong:
+				return new Material_LambertPhong(material.color, pParameters[0], pParameters[1], pParameters[2]);
+			case SceneDescription::MaterialType::cookTorrence:
+				return new Material_CookTorrence(material.color, pParameters[0], pParameters[1]);
+			default:
+				return new Material_SolidColor(material.color);
+			}
+		}
+	}
+
+	Scene_File::Scene_File(const std::string& path) :
+		m_Path{ path }
+	{
+	}
+
+	void Scene_File::Initialize()
+	{
+		if (!SceneFile::Load(m_Path, m_Description))
+		{
+			m_Description = SceneDescription{};
+			return;
+		}
+
+		sceneName = m_Description.name;
+		ApplyCamera();
+		AddMaterials();
+		AddPrimitives();
+
+		for (const SceneDescription::MeshEntry& entry : m_Description.meshes)
+			AddMeshes(entry);
+
+		AddLights();
+		PrintMeshMemoryUsage();
+	}
+
+	void Scene_File::Update(Timer* pTimer)
+	{
+		Scene::Update(pTimer);
+
+		//One reload at a time, files written meanwhile are reported by the next poll
+		if (m_PendingReload.valid())
+		{
+			if (m_PendingReload.wait_for(std::chrono::seconds{ 0 }) == std::future_status::ready)
+			{
+				Reload reload{ m_PendingReload.get() };
+				ApplyReload(reload);
+			}
+		}
+		else if (m_IsHotReloadEnabled)
+		{
+			const std::vector<std::string> changedPaths{ m_Watcher.Poll() };
+			if (!changedPaths.empty())
+				m_PendingReload = std::async(std::launch::async, &Scene_File::LoadReload, m_Path, changedPaths, m_Description);
+		}
+
+		const auto yawAngle = (cosf(pTimer->GetTotal()) + 1.f) / 2.f * PI_2;
+		for (const size_t index : m_SpinningMeshes)
+		{
+			m_TriangleMeshGeometries[index].RotateY(yawAngle);
+			m_TriangleMeshGeometries[index].UpdateTransforms();
+		}
+	}
+
+	void Scene_File::EnableHotReload()
+	{
+		m_IsHotReloadEnabled = true;
+		WatchFiles();
+		std::cout << "Watching " << m_Path << " and its meshes for changes" << std::endl;
+	}
+
+	void Scene_File::AddMaterials()
+	{
+		//The default material is index 0, the ones of the file follow in order as the description expects
+		m_MaterialsByName.clear();
+		for (const SceneDescription::MaterialEntry& material : m_Description.materials)
+			m_MaterialsByName.emplace(material.name, AddMaterial(CreateMaterial(material)));
+	}
+
+	void Scene_File::AddPrimitives()
+	{
+		m_PlaneGeometries.reserve(m_Description.planes.size());
+		for (const SceneDescription::PlaneEntry& plane : m_Description.planes)
+			AddPlane(plane.origin, plane.normal, static_cast<unsigned char>(plane.materialIndex));
+
+		m_SphereGeometries.reserve(m_Description.spheres.size());
+		for (const SceneDescription::SphereEntry& sphere : m_Description.spheres)
+			AddSphere(sphere.origin, sphere.radius, static_cast<unsigned char>(sphere.materialIndex));
+	}
+
+	void Scene_File::AddLights()
+	{
+		m_Lights.reserve(m_Description.lights.size());
+		for (const SceneDescription::LightEntry& light : m_Description.lights)
+		{
+			if (light.type == LightType::Directional)
+				AddDirectionalLight(light.direction, light.intensity, light.color);
+			else
+				AddPointLight(light.origin, light.intensity, light.color);
+		}
+	}
+
+	void Scene_File::AddMeshes(const SceneDescription::MeshEntry& entry)
+	{
+		const unsigned char materialIndex{ static_cast<unsigned char>(entry.materialIndex) };
+		const size_t firstMesh{ m_TriangleMeshGeometries.size() };
+
+		if (entry.path.empty())
+		{
+			TriangleMesh* pMesh{ AddTriangleMesh(entry.cullMode, materialIndex) };
+			pMesh->positions = entry.positions;
+			pMesh->indices = entry.indices;
+			pMesh->CalculateNormals();
+			pMesh->UpdateAABB();
+		}
+		else if (entry.stream)
+		{
+			AddStreamedTriangleMeshes(GetMeshPath(m_Path, entry), entry.cullMode, materialIndex, m_MaterialsByName);
+		}
+		else
+		{
+			AddTriangleMeshes(GetMeshPath(m_Path, entry), entry.cullMode, materialIndex, m_MaterialsByName);
+		}
+
+		for (size_t index{ firstMesh }; index < m_TriangleMeshGeometries.size(); ++index)
+		{
+			TriangleMesh& mesh{ m_TriangleMeshGeometries[index] };
+			if (entry.compact)
+				CompactMesh::Compact(mesh);
+
+			mesh.Translate(entry.translation);
+			mesh.RotateY(entry.yaw * TO_RADIANS);
+			mesh.Scale(entry.scale);
+			mesh.UpdateTransforms();
+
+			if (entry.spin)
+				m_SpinningMeshes.emplace_back(index);
+		}
+
+		m_MeshRanges.emplace_back(MeshRange{ firstMesh, m_TriangleMeshGeometries.size() - firstMesh });
+	}
+
+	void Scene_File::ApplyCamera()
+	{
+		m_Camera.origin = m_Description.cameraOrigin;
+		m_Camera.SetFOV(m_Description.fovAngle);
+		m_Camera.totalYaw = m_Description.cameraYaw * TO_RADIANS;
+		m_Camera.totalPitch = m_Description.cameraPitch * TO_RADIANS;
+	}
+
+	std::string Scene_File::GetMeshPath(const std::string& scenePath, const SceneDescription::MeshEntry& entry)
+	{
+		//Mesh paths are relative to the scene file
+		if (entry.path.empty())
+			return {};
+
+		return (std::filesystem::path{ scenePath }.parent_path() / entry.path).lexically_normal().string();
+	}
+
+	void Scene_File::WatchFiles()
+	{
+		m_Watcher.Clear();
+		m_Watcher.Watch(m_Path);
+
+		for (const SceneDescription::MeshEntry& entry : m_Description.meshes)
+		{
+			if (!entry.path.empty())
+				m_Watcher.Watch(GetMeshPath(m_Path, entry));
+		}
+	}
+
+	Scene_File::Reload Scene_File::LoadReload(const std::string& path, const std::vector<std::string>& changedPaths, const SceneDescription& current)
+	{
+		Reload reload{};
+		reload.detectTime = std::chrono::steady_clock::now();
+
+		const auto isChanged = [&changedPaths](const std::string& changedPath)
+		{
+			return std::find(changedPaths.begin(), changedPaths.end(), changedPath) != changedPaths.end();
+		};
+
+		for (const std::string& changedPath : changedPaths)
+		{
+			std::error_code error{};
+			const std::filesystem::file_time_type writeTime{ std::filesystem::last_write_time(changedPath, error) };
+			if (!error)
+				reload.writeTime = std::max(reload.writeTime, writeTime);
+		}
+
+		if (isChanged(path))
+		{
+			reload.isValid = SceneFile::Load(path, reload.description);
+		}
+		else
+		{
+			reload.description = current;
+			reload.isValid = true;
+		}
+
+		if (!reload.isValid)
+			return reload;
+
+		//Brings the caches of the OBJ files that get rebuilt up to date, the render thread only copies from them
+		for (size_t index{}; index < reload.description.meshes.size(); ++index)
+		{
+			const SceneDescription::MeshEntry& entry{ reload.description.meshes[index] };
+			const std::string meshPath{ GetMeshPath(path, entry) };
+			if (meshPath.empty())
+				continue;
+
+			const bool isWritten{ isChanged(meshPath) };
+			if (isWritten && std::find(reload.changedMeshPaths.begin(), reload.changedMeshPaths.end(), meshPath) == reload.changedMeshPaths.end())
+				reload.changedMeshPaths.emplace_back(meshPath);
+
+			if (isWritten || index >= current.meshes.size() || !(entry == current.meshes[index]))
+			{
+				if (entry.stream)
+					MeshClusters::UpdateClusters(meshPath);
+				else
+					MeshCache::UpdateCache(meshPath);
+			}
+		}
+
+		return reload;
+	}
+
+	void Scene_File::ApplyReload(Reload& reload)
+	{
+		using Milliseconds = std::chrono::duration<double, std::milli>;
+		const auto applyStart{ std::chrono::steady_clock::now() };
+
+		if (!reload.isValid)
+		{
+			std::cout << "Kept the previous version of " << m_Path << std::endl;
+			return;
+		}
+
+		const SceneDescription previous{ std::exchange(m_Description, std::move(reload.description)) };
+		const bool wasDirty{ m_IsDirty };
+		bool isFrameInvalid{ false };
+		std::string changes{};
+		const auto addChange = [&changes](const std::string& change)
+		{
+			changes += changes.empty() ? change : ", " + change;
+		};
+
+		sceneName = m_Description.name;
+
+		if (std::memcmp(&m_Description.cameraOrigin, &previous.cameraOrigin, sizeof(Vector3)) != 0 || m_Description.fovAngle != previous.fovAngle
+			|| m_Description.cameraYaw != previous.cameraYaw || m_Description.cameraPitch != previous.cameraPitch)
+		{
+			ApplyCamera();
+			isFrameInvalid = true;
+			addChange("camera");
+		}
+
+		//Materials are replaced as a whole, the default material stays
+		const std::unordered_map<std::string, unsigned char> previousMaterialsByName{ m_MaterialsByName };
+		if (m_Description.materials != previous.materials)
+		{
+			for (size_t index{ 1 }; index < m_Materials.size(); ++index)
+				delete m_Materials[index];
+			m_Materials.resize(1);
+
+			AddMaterials();
+			isFrameInvalid = true;
+			addChange("materials");
+		}
+
+		if (m_Description.planes != previous.planes || m_Description.spheres != previous.spheres)
+		{
+			m_PlaneGeometries.clear();
+			m_SphereGeometries.clear();
+			AddPrimitives();
+			isFrameInvalid = true;
+			addChange("spheres and planes");
+		}
+
+		if (m_Description.lights != previous.lights)
+		{
+			m_Lights.clear();
+			AddLights();
+			isFrameInvalid = true;
+			addChange("lights");
+		}
+
+		//Entries that are unchanged keep their meshes, unless their OBJ file was written or the usemtl names it uses
+		//could now point elsewhere
+		const bool isMaterialMapChanged{ m_MaterialsByName != previousMaterialsByName };
+		std::vector<TriangleMesh> previousMeshes{ std::move(m_TriangleMeshGeometries) };
+		const std::vector<MeshRange> previousRanges{ std::move(m_MeshRanges) };
+		m_TriangleMeshGeometries.clear();
+		m_TriangleMeshGeometries.reserve(previousMeshes.size());
+		m_MeshRanges.clear();
+		m_SpinningMeshes.clear();
+
+		size_t nrRebuilt{};
+		bool isInPlace{ m_Description.meshes.size() == previous.meshes.size() };
+		for (size_t index{}; index < m_Description.meshes.size(); ++index)
+		{
+			const SceneDescription::MeshEntry& entry{ m_Description.meshes[index] };
+			const std::string meshPath{ GetMeshPath(m_Path, entry) };
+			const bool isWritten{ !meshPath.empty() && (isMaterialMapChanged
+				|| std::find(reload.changedMeshPaths.begin(), reload.changedMeshPaths.end(), meshPath) != reload.changedMeshPaths.end()) };
+
+			if (index < previous.meshes.size() && entry == previous.meshes[index] && !isWritten)
+			{
+				const MeshRange& range{ previousRanges[index] };
+				const size_t firstMesh{ m_TriangleMeshGeometries.size() };
+				for (size_t offset{}; offset < range.count; ++offset)
+				{
+					m_TriangleMeshGeometries.emplace_back(std::move(previousMeshes[range.first + offset]));
+					if (entry.spin)
+						m_SpinningMeshes.emplace_back(firstMesh + offset);
+				}
+
+				m_MeshRanges.emplace_back(MeshRange{ firstMesh, range.count });
+				continue;
+			}
+
+			AddMeshes(entry);
+			++nrRebuilt;
+
+			//Replaced by as many meshes, only the tiles under their old and new bounds have to be rendered again
+			const MeshRange& range{ m_MeshRanges.back() };
+			if (index < previousRanges.size() && previousRanges[index].count == range.count)
+			{
+				for (size_t offset{}; offset < range.count; ++offset)
+				{
+					TriangleMesh& mesh{ m_TriangleMeshGeometries[range.first + offset] };
+					const TriangleMesh& previousMesh{ previousMeshes[previousRanges[index].first + offset] };
+					mesh.previousTransformedMinAABB = previousMesh.transformedMinAABB;
+					mesh.previousTransformedMaxAABB = previousMesh.transformedMaxAABB;
+					mesh.isDirty = true;
+				}
+			}
+			else
+			{
+				isInPlace = false;
+			}
+		}
+
+		if (nrRebuilt > 0)
+			addChange(std::to_string(nrRebuilt) + " of " + std::to_string(m_Description.meshes.size()) + " meshes");
+
+		//Adding meshes invalidates the whole frame, which isn't needed when they only replaced meshes of the same entry
+		m_IsDirty = isFrameInvalid || !isInPlace || wasDirty;
+
+		m_UsedMaterials.reset();
+		for (const Plane& plane : m_PlaneGeometries)
+			m_UsedMaterials.set(plane.materialIndex);
+		for (const Sphere& sphere : m_SphereGeometries)
+			m_UsedMaterials.set(sphere.materialIndex);
+		for (const TriangleMesh& mesh : m_TriangleMeshGeometries)
+			m_UsedMaterials.set(mesh.materialIndex);
+
+		if (m_IsHotReloadEnabled)
+			WatchFiles();
+
+		const auto applyEnd{ std::chrono::steady_clock::now() };
+		std::cout << "Reloaded " << m_Path << " (" << (changes.empty() ? "nothing changed" : changes) << ") in "
+			<< Milliseconds(applyEnd - applyStart).count() << " ms, " << Milliseconds(applyEnd - reload.detectTime).count() << " ms after the change was seen";
+		if (reload.writeTime != std::filesystem::file_time_type::min())
+			std::cout << ", " << Milliseconds(std::filesystem::file_time_type::clock::now() - reload.writeTime).count() << " ms after it was written";
+		std::cout << std::endl;
+	}
+#pragma endregion
+
+#pragma region STRESS SCENES
+	Scene_Stress::Scene_Stress(const StressSettings& settings) :
+		m_Settings{ settings },
+		m_Random{ settings.seed }
+	{
+	}
+
+	float Scene_Stress::GetRandom(float min, float max)
+	{
+		//24 bits, as many as a float holds
+		return min + (max - min) * static_cast<float>(m_Random() >> 8) / static_cast<float>(1 << 24);
+	}
+
+	ColorRGB Scene_Stress::GetRandomColor(float min, float max)
+	{
+		const float r{ GetRandom(min, max) };
+		const float g{ GetRandom(min, max) };
+		const float b{ GetRandom(min, max) };
+		return ColorRGB{ r, g, b };
+	}
+
+	std::vector<unsigned char> Scene_Stress::AddRandomMaterials(size_t count)
+	{
+		std::vector<unsigned char> materials{};
+		for (size_t index{}; index < count; ++index)
+		{
+			const ColorRGB color{ GetRandomColor(.2f, 1.f) };
+			switch (index % 3)
+			{
+			case 0:
+				materials.emplace_back(AddMaterial(new Material_Lambert(color, 1.f)));
+				break;
+			case 1:
+				materials.emplace_back(AddMaterial(new Material_LambertPhong(color, .5f, .5f, GetRandom(5.f, 60.f))));
+				break;
+			default:
+			{
+				const float metalness{ GetRandom(0.f, 1.f) < .5f ? 0.f : 1.f };
+				materials.emplace_back(AddMaterial(new Material_CookTorrence(color, metalness, GetRandom(.1f, 1.f))));
+				break;
+			}
+			}
+		}
+
+		return materials;
+	}
+
+	void Scene_Stress::AddRoom(float halfWidth, float height, float depth, unsigned char materialIndex)
+	{
+		AddPlane(Vector3{ 0.f, 0.f, depth }, Vector3{ 0.f, 0.f, -1.f }, materialIndex); //BACK
+		AddPlane(Vector3{ 0.f, 0.f, 0.f }, Vector3{ 0.f, 1.f, 0.f }, materialIndex); //BOTTOM
+		AddPlane(Vector3{ 0.f, height, 0.f }, Vector3{ 0.f, -1.f, 0.f }, materialIndex); //TOP
+		AddPlane(Vector3{ halfWidth, 0.f, 0.f }, Vector3{ -1.f, 0.f, 0.f }, materialIndex); //RIGHT
+		AddPlane(Vector3{ -halfWidth, 0.f, 0.f }, Vector3{ 1.f, 0.f, 0.f }, materialIndex); //LEFT
+	}
+
+	void Scene_Stress_Spheres::Initialize()
+	{
+		const size_t nrSpheres{ GetCount(1000) };
+		sceneName = "Stress Spheres (" + std::to_string(nrSpheres) + ")";
+
+		//A sphere per unit cube on average, the camera backs off as the volume grows
+		const float size{ std::cbrt(static_cast<float>(nrSpheres)) };
+		m_Camera.origin = { 0.f, size * .5f, -size * 1.2f };
+		m_Camera.SetFOV(60.f);
+
+		const std::vector<unsigned char> materials{ AddRandomMaterials(12) };
+		AddPlane(Vector3{ 0.f, 0.f, 0.f }, Vector3{ 0.f, 1.f, 0.f }, materials.front());
+
+		m_SphereGeometries.reserve(nrSpheres + 1);
+		for (size_t index{}; index < nrSpheres; ++index)
+		{
+			const Vector3 origin{ GetRandom(-.5f, .5f) * size, GetRandom(0.f, 1.f) * size, GetRandom(-.5f, .5f) * size };
+			const float radius{ GetRandom(.15f, .45f) };
+			AddSphere(origin, radius, materials[GetRandomIndex(materials.size())]);
+		}
+
+		const float intensity{ 50.f * std::max(1.f, size * size / 25.f) };
+		AddPointLight(Vector3{ 0.f, size * 1.5f, size * .5f }, intensity, ColorRGB{ 1.f, .61f, .45f });
+		AddPointLight(Vector3{ -size * .5f, size * 1.5f, -size }, intensity, ColorRGB{ 1.f, .8f, .45f });
+		AddPointLight(Vector3{ size * .5f, size * .75f, -size }, intensity, ColorRGB{ .34f, .47f, .68f });
+	}
+
+	void Scene_Stress_Bunnies::Initialize()
+	{
+		const size_t nrBunnies{ GetCount(16) };
+		sceneName = "Stress Bunnies (" + std::to_string(nrBunnies) + ")";
+
+		//Two units apart on a square grid on the floor, seen from the front and above
+		constexpr float spacing{ 2.f };
+		const size_t nrColumns{ static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(nrBunnies)))) };
+		const float size{ nrColumns * spacing };
+		m_Camera.origin = { 0.f, size * .5f, -size * .4f };
+		m_Camera.totalPitch = 30.f * TO_RADIANS;
+		m_Camera.SetFOV(60.f);
+
+		const std::vector<unsigned char> materials{ AddRandomMaterials(12) };
+		AddPlane(Vector3{ 0.f, 0.f, 0.f }, Vector3{ 0.f, 1.f, 0.f }, materials.front());
+
+		const std::vector<TriangleMesh*> meshes{ AddTriangleMeshes("Resources/lowpoly_bunny2.obj", TriangleCullMode::FrontFaceCulling) };
+		if (meshes.empty())
+			return;
+
+		//Every instance shares the compacted bunny, only its transform and material are its own
+		CompactMesh::Compact(*meshes.front());
+		const TriangleMesh bunny{ *meshes.front() };
+		m_TriangleMeshGeometries.clear();
+		m_TriangleMeshGeometries.reserve(nrBunnies);
+
+		for (size_t index{}; index < nrBunnies; ++index)
+		{
+			const float x{ (static_cast<float>(index % nrColumns) + .5f) * spacing - size * .5f };
+			const float z{ static_cast<float>(index / nrColumns) * spacing };
+
+			TriangleMesh& mesh{ m_TriangleMeshGeometries.emplace_back(bunny) };
+			mesh.materialIndex = materials[GetRandomIndex(materials.size())];
+			mesh.Translate({ x, 0.f, z });
+			mesh.RotateY(GetRandom(0.f, PI_2));
+			mesh.UpdateTransforms();
+			m_UsedMaterials.set(mesh.materialIndex);
+		}
+
+		const float intensity{ 50.f * std::max(1.f, size * size / 25.f) };
+		AddPointLight(Vector3{ 0.f, size * .5f, size }, intensity, ColorRGB{ 1.f, .61f, .45f });
+		AddPointLight(Vector3{ -size * .5f, size * .5f, -size * .5f }, intensity, ColorRGB{ 1.f, .8f, .45f });
+		AddPointLight(Vector3{ size * .5f, size * .25f, -size * .5f }, intensity, ColorRGB{ .34f, .47f, .68f });
+
+		PrintMeshMemoryUsage();
+	}
+
+	void Scene_Stress_Tessellation::Initialize()
+	{
+		//Rings of segments from pole to pole, the rings next to the poles are fans: 2 * segments * (rings - 1) triangles
+		//with twice as many segments as rings
+		const size_t nrTargetTriangles{ GetCount(100000) };
+		const size_t nrRings{ std::max(size_t{ 2 }, static_cast<size_t>(std::lround((1.0 + std::sqrt(1.0 + nrTargetTriangles)) * .5))) };
+		const size_t nrSegments{ nrRings * 2 };
+
+		m_Camera.origin = { 0.f, 3.f, -9.f };
+		m_Camera.SetFOV(45.f);
+
+		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f, 0.57f, 0.57f }, 1.f));
+		const auto matCT_GrayMediumPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, .6f));
+		AddRoom(5.f, 10.f, 10.f, matLambert_GrayBlue);
+
+		//A few random waves over the sphere, low enough in frequency to keep the surface smooth
+		constexpr float radius{ 2.f };
+		float waves[3][3]{};
+		for (float(&wave)[3] : waves)
+		{
+			wave[0] = std::floor(GetRandom(2.f, 9.f));
+			wave[1] = std::floor(GetRandom(2.f, 9.f));
+			wave[2] = GetRandom(0.f, PI_2);
+		}
+
+		const auto getPosition = [&waves](float theta, float phi)
+		{
+			float offset{};
+			for (const float(&wave)[3] : waves)
+				offset += sinf(wave[0] * theta + wave[2]) * sinf(wave[1] * phi);
+
+			const float distance{ radius * (1.f + .03f * offset) };
+			return Vector3{ distance * sinf(theta) * cosf(phi), 2.5f + distance * cosf(theta), distance * sinf(theta) * sinf(phi) };
+		};
+
+		TriangleMesh* pMesh{ AddTriangleMesh(TriangleCullMode::BackFaceCulling, matCT_GrayMediumPlastic) };
+		pMesh->positions.reserve(2 + nrSegments * (nrRings - 1));
+		pMesh->indices.reserve(6 * nrSegments * (nrRings - 1));
+
+		pMesh->positions.emplace_back(getPosition(0.f, 0.f));
+		for (size_t ring{ 1 }; ring < nrRings; ++ring)
+		{
+			const float theta{ PI * ring / nrRings };
+			for (size_t segment{}; segment < nrSegments; ++segment)
+				pMesh->positions.emplace_back(getPosition(theta, PI_2 * segment / nrSegments));
+		}
+		pMesh->positions.emplace_back(getPosition(PI, 0.f));
+
+		const auto getVertex = [nrSegments](size_t ring, size_t segment) { return static_cast<int>(1 + (ring - 1) * nrSegments + segment % nrSegments); };
+		const int lastVertex{ static_cast<int>(pMesh->positions.size() - 1) };
+		for (size_t segment{}; segment < nrSegments; ++segment)
+		{
+			pMesh->indices.insert(pMesh->indices.end(), { 0, getVertex(1, segment + 1), getVertex(1, segment) });
+			for (size_t ring{ 1 }; ring + 1 < nrRings; ++ring)
+			{
+				pMesh->indices.insert(pMesh->indices.end(), { getVertex(ring, segment), getVertex(ring + 1, segment + 1), getVertex(ring + 1, segment) });
+				pMesh->indices.insert(pMesh->indices.end(), { getVertex(ring, segment), getVertex(ring, segment + 1), getVertex(ring + 1, segment + 1) });
+			}
+			pMesh->indices.insert(pMesh->indices.end(), { getVertex(nrRings - 1, segment), getVertex(nrRings - 1, segment + 1), lastVertex });
+		}
+
+		pMesh->CalculateNormals();
+
+		//Smooth shading, the face normals around a vertex weighted by their area
+		pMesh->vertexNormals.assign(pMesh->positions.size(), Vector3{});
+		for (size_t index{}; index < pMesh->indices.size(); index += 3)
+		{
+			const Vector3& v0{ pMesh->positions[pMesh->indices[index]] };
+			const Vector3 areaNormal{ Vector3::Cross(pMesh->positions[pMesh->indices[index + 1]] - v0, pMesh->positions[pMesh->indices[index + 2]] - v0) };
+			for (size_t corner{}; corner < 3; ++corner)
+				pMesh->vertexNormals[pMesh->indices[index + corner]] += areaNormal;
+		}
+		for (Vector3& vertexNormal : pMesh->vertexNormals)
+			vertexNormal.Normalize();
+
+		pMesh->UpdateAABB();
+		pMesh->UpdateTransforms();
+
+		sceneName = "Stress Tessellation (" + std::to_string(pMesh->normals.size()) + " triangles)";
+		PrintMeshMemoryUsage();
+
+		AddPointLight(Vector3{ 0.f, 5.f, 5.f }, 50.f, ColorRGB{ 1.f, .61f, .45f }); //Backlight
+		AddPointLight(Vector3{ -2.5f, 5.f, -5.f }, 70.f, ColorRGB{ 1.f, .8f, .45f }); //Front Light Left
+		AddPointLight(Vector3{ 2.5f, 2.5f, -5.f }, 50.f, ColorRGB{ .34f, .47f, .68f });
+	}
+
+	void Scene_Stress_Lights::Initialize()
+	{
+		const size_t nrLights{ GetCount(64) };
+		sceneName = "Stress Lights (" + std::to_string(nrLights) + ")";
+		m_Camera.origin = { 0.f, 3.f, -9.f };
+		m_Camera.SetFOV(45.f);
+
+		const std::vector<unsigned char> materials{ AddRandomMaterials(6) };
+		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f, 0.57f, 0.57f }, 1.f));
+		AddRoom(5.f, 10.f, 10.f, matLambert_GrayBlue);
+
+		for (size_t index{}; index < materials.size(); ++index)
+			AddSphere(Vector3{ -1.75f + 1.75f * (index % 3), 1.f + 2.f * (index / 3), 0.f }, .75f, materials[index]);
+
+		//As bright as the three lights of the reference scene together, kept off the walls
+		const float intensity{ 170.f / nrLights };
+		m_Lights.reserve(nrLights);
+		for (size_t index{}; index < nrLights; ++index)
+		{
+			const Vector3 origin{ GetRandom(-4.5f, 4.5f), GetRandom(.5f, 9.5f), GetRandom(-8.f, 9.5f) };
+			AddPointLight(origin, intensity, GetRandomColor(.3f, 1.f));
+		}
+	}
+
+	void Scene_Stress_Corridor::Initialize()
+	{
+		const size_t nrWalls{ GetCount(32) };
+		sceneName = "Stress Corridor (" + std::to_string(nrWalls) + " walls)";
+
+		constexpr float halfWidth{ 2.f };
+		constexpr float height{ 3.f };
+		constexpr float wallSpacing{ 2.f };
+		constexpr float doorWidth{ 1.f };
+		constexpr float doorHeight{ 2.f };
+		const float depth{ (nrWalls + 1) * wallSpacing };
+
+		m_Camera.origin = { 0.f, 1.5f, -1.f };
+		m_Camera.SetFOV(60.f);
+
+		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f, 0.57f, 0.57f }, 1.f));
+		const std::vector<unsigned char> materials{ AddRandomMaterials(6) };
+		AddRoom(halfWidth, height, depth, matLambert_GrayBlue);
+		AddPlane(Vector3{ 0.f, 0.f, -2.f }, Vector3{ 0.f, 0.f, 1.f }, matLambert_GrayBlue); //FRONT
+
+		//Around the door: left of it, right of it and above it
+		m_TriangleMeshGeometries.reserve(nrWalls);
+		for (size_t index{}; index < nrWalls; ++index)
+		{
+			const float z{ (index + 1) * wallSpacing };
+			const float doorLeft{ GetRandom(-halfWidth, halfWidth - doorWidth) };
+			const float doorRight{ doorLeft + doorWidth };
+
+			TriangleMesh* pWall{ AddTriangleMesh(TriangleCullMode::NoCulling, materials[GetRandomIndex(materials.size())]) };
+			const auto addQuad = [pWall, z](float left, float right, float bottom, float top)
+			{
+				const int first{ static_cast<int>(pWall->positions.size()) };
+				pWall->positions.insert(pWall->positions.end(), { { left, bottom, z }, { left, top, z }, { right, top, z }, { right, bottom, z } });
+				pWall->indices.insert(pWall->indices.end(), { first, first + 1, first + 2, first, first + 2, first + 3 });
+			};
+
+			addQuad(-halfWidth, doorLeft, 0.f, height);
+			addQuad(doorRight, halfWidth, 0.f, height);
+			addQuad(doorLeft, doorRight, doorHeight, height);
+
+			pWall->CalculateNormals();
+			pWall->UpdateAABB();
+			pWall->UpdateTransforms();
+		}
+
+		//Under the ceiling of some rooms, at most 16 however deep the corridor is
+		const size_t lightStep{ (nrWalls + 16) / 16 };
+		for (size_t room{}; room <= nrWalls; room += lightStep)
+			AddPointLight(Vector3{ 0.f, height * .9f, (room + .5f) * wallSpacing }, 3.f, ColorRGB{ 1.f, .8f, .45f });
+
+		PrintMeshMemoryUsage();
+	}
+#pragma endregion
 }
@@ -1,10 +1,19 @@
 #pragma once
+#include <bitset>
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <random>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "Math.h"
 #include "DataTypes.h"
 #include "Camera.h"
+#include "FileWatcher.h"
+#include "SceneFile.h"
 
 namespace dae
 {
@@ -39,8 +48,24 @@ namespace dae
 
 		const std::vector<Plane>& GetPlaneGeometries() const { return m_PlaneGeometries; }
 		const std::vector<Sphere>& GetSphereGeometries() const { return m_SphereGeometries; }
+		const std::vector<TriangleMesh>& GetTriangleMeshGeometries() const { return m_TriangleMeshGeometries; }
 		const std::vector<Light>& GetLights() const { return m_Lights; }
-		const std::vector<Material*> GetMaterials() const { return m_Materials; }
+		const std::vector<Material*>& GetMaterials() const { return m_Materials; }
+		//Materials referenced by at least one geometry (materialIndex is an unsigned char)
+		const std::bitset<256>& GetUsedMaterials() const { return m_UsedMaterials; }
+
+		//Bytes of geometry the triangle meshes keep in memory, per triangle, data shared by instances counted once
+		void PrintMeshMemoryUsage() const;
+
+		//Invalidates the whole frame, call after editing materials, lights, spheres or planes
+		void MarkDirty() { m_IsDirty = true; }
+
+		/**
+		 * \brief Collects the changes since the previous call and resets all dirty flags
+		 * \param dirtyBounds receives the old and new world bounds (pairs of AABB corners) of every mesh that moved
+		 * \return true when the whole frame is invalid
+		 */
+		bool ConsumeChanges(std::vector<std::pair<Vector3, Vector3>>& dirtyBounds);
 
 	protected:
 		std::string	sceneName;
@@ -51,11 +76,20 @@ namespace dae
 		std::vector<Light> m_Lights{};
 		std::vector<Material*> m_Materials{};
 		std::vector<Triangle> m_Triangles;
+		std::bitset<256> m_UsedMaterials{};
+		bool m_IsDirty{ true };
 		Camera m_Camera{};
 
 		Sphere* AddSphere(const Vector3& origin, float radius, unsigned char materialIndex = 0);
 		Plane* AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex = 0);
 		TriangleMesh* AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex = 0);
+		//One mesh per group/material of the OBJ file, faces with a usemtl found in materialsByName get that material
+		//instead of materialIndex. The pointers are valid until the next mesh is added.
+		std::vector<TriangleMesh*> AddTriangleMeshes(const std::string& objPath, TriangleCullMode cullMode, unsigned char materialIndex = 0,
+			const std::unordered_map<std::string, unsigned char>& materialsByName = {});
+		//Same meshes, but their triangles stay on disk and are paged in through the GeometryCache while rendering
+		std::vector<TriangleMesh*> AddStreamedTriangleMeshes(const std::string& objPath, TriangleCullMode cullMode, unsigned char materialIndex = 0,
+			const std::unordered_map<std::string, unsigned char>& materialsByName = {});
 
 		Light* AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color);
 		Light* AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color);
@@ -169,4 +203,182 @@ namespace dae
 	private:
 		TriangleMesh* m_Meshes[3];
 	};
+
+	//Built from a scene file, text or binary (see SceneFile.h). The SceneFactory creates one for any name that is
+	//a path to a .scene or .sceneb file.
+	class Scene_File final : public Scene
+	{
+	public:
+		Scene_File(const std::string& path);
+		~Scene_File() override = default;
+
+		Scene_File(const Scene_File&) = delete;
+		Scene_File(Scene_File&&) noexcept = delete;
+		Scene_File& operator=(const Scene_File&) = delete;
+		Scene_File& operator=(Scene_File&&) noexcept = delete;
+
+		void Update(Timer* pTimer) override;
+		//Leaves the scene empty when the file can't be loaded
+		void Initialize() override;
+
+		//Watches the scene file and its OBJ files. Changed files are loaded in the background while the scene keeps
+		//rendering, then only the entries that differ are rebuilt in Update.
+		void EnableHotReload();
+
+	private:
+		//The meshes an entry of the description was turned into
+		struct MeshRange
+		{
+			size_t first{};
+			size_t count{};
+		};
+
+		struct Reload
+		{
+			bool isValid{ false };
+			SceneDescription description{};
+			//Resolved paths of the OBJ files that were written, their caches are up to date
+			std::vector<std::string> changedMeshPaths{};
+			std::chrono::steady_clock::time_point detectTime{};
+			//Of the newest changed file, to report the latency from saving to rendering
+			std::filesystem::file_time_type writeTime{ std::filesystem::file_time_type::min() };
+		};
+
+		std::string m_Path;
+		SceneDescription m_Description{};
+		std::unordered_map<std::string, unsigned char> m_MaterialsByName{};
+		std::vector<MeshRange> m_MeshRanges{};
+		//Indices into the mesh geometries, pointers could move while the meshes are added
+		std::vector<size_t> m_SpinningMeshes{};
+
+		bool m_IsHotReloadEnabled{ false };
+		FileWatcher m_Watcher{};
+		std::future<Reload> m_PendingReload{};
+
+		void AddMaterials();
+		void AddPrimitives();
+		void AddLights();
+		void AddMeshes(const SceneDescription::MeshEntry& entry);
+		void ApplyCamera();
+		static std::string GetMeshPath(const std::string& scenePath, const SceneDescription::MeshEntry& entry);
+
+		void WatchFiles();
+		void ApplyReload(Reload& reload);
+		//Runs on another thread, only touches its arguments
+		static Reload LoadReload(const std::string& path, const std::vector<std::string>& changedPaths, const SceneDescription& current);
+	};
+
+	//+++++++++++++++++++++++++++++++++++++++++
+	//Procedural Stress Scenes, for scaling benchmarks. The SceneFactory creates them as "<name>[:<count>[:<seed>]]",
+	//the same name, count and seed give the same scene on every platform.
+	struct StressSettings
+	{
+		//What is counted is up to the scene, 0 picks its default
+		size_t count{};
+		uint32_t seed{ 1 };
+	};
+
+	class Scene_Stress : public Scene
+	{
+	public:
+		explicit Scene_Stress(const StressSettings& settings);
+		~Scene_Stress() override = default;
+
+		Scene_Stress(const Scene_Stress&) = delete;
+		Scene_Stress(Scene_Stress&&) noexcept = delete;
+		Scene_Stress& operator=(const Scene_Stress&) = delete;
+		Scene_Stress& operator=(Scene_Stress&&) noexcept = delete;
+
+	protected:
+		StressSettings m_Settings;
+
+		size_t GetCount(size_t defaultCount) const { return m_Settings.count > 0 ? m_Settings.count : defaultCount; }
+		//From the raw engine output, the std distributions differ between standard libraries
+		float GetRandom(float min, float max);
+		size_t GetRandomIndex(size_t count) { return m_Random() % count; }
+		ColorRGB GetRandomColor(float min, float max);
+		//Lambert, Phong and Cook-Torrance materials with random colors and parameters
+		std::vector<unsigned char> AddRandomMaterials(size_t count);
+		//Five planes around x in [-halfWidth, halfWidth], y in [0, height] and up to z = depth
+		void AddRoom(float halfWidth, float height, float depth, unsigned char materialIndex);
+
+	private:
+		std::mt19937 m_Random;
+	};
+
+	//count random spheres, spread over a volume that grows with them
+	class Scene_Stress_Spheres final : public Scene_Stress
+	{
+	public:
+		explicit Scene_Stress_Spheres(const StressSettings& settings) : Scene_Stress(settings) {}
+		~Scene_Stress_Spheres() override = default;
+
+		Scene_Stress_Spheres(const Scene_Stress_Spheres&) = delete;
+		Scene_Stress_Spheres(Scene_Stress_Spheres&&) noexcept = delete;
+		Scene_Stress_Spheres& operator=(const Scene_Stress_Spheres&) = delete;
+		Scene_Stress_Spheres& operator=(Scene_Stress_Spheres&&) noexcept = delete;
+
+		void Initialize() override;
+	};
+
+	//A grid of count bunnies that share one CompactMesh, with random rotations and materials
+	class Scene_Stress_Bunnies final : public Scene_Stress
+	{
+	public:
+		explicit Scene_Stress_Bunnies(const StressSettings& settings) : Scene_Stress(settings) {}
+		~Scene_Stress_Bunnies() override = default;
+
+		Scene_Stress_Bunnies(const Scene_Stress_Bunnies&) = delete;
+		Scene_Stress_Bunnies(Scene_Stress_Bunnies&&) noexcept = delete;
+		Scene_Stress_Bunnies& operator=(const Scene_Stress_Bunnies&) = delete;
+		Scene_Stress_Bunnies& operator=(Scene_Stress_Bunnies&&) noexcept = delete;
+
+		void Initialize() override;
+	};
+
+	//One sphere tessellated into about count triangles, with random bumps
+	class Scene_Stress_Tessellation final : public Scene_Stress
+	{
+	public:
+		explicit Scene_Stress_Tessellation(const StressSettings& settings) : Scene_Stress(settings) {}
+		~Scene_Stress_Tessellation() override = default;
+
+		Scene_Stress_Tessellation(const Scene_Stress_Tessellation&) = delete;
+		Scene_Stress_Tessellation(Scene_Stress_Tessellation&&) noexcept = delete;
+		Scene_Stress_Tessellation& operator=(const Scene_Stress_Tessellation&) = delete;
+		Scene_Stress_Tessellation& operator=(Scene_Stress_Tessellation&&) noexcept = delete;
+
+		void Initialize() override;
+	};
+
+	//The reference room lit by count random point lights, their total intensity stays the same
+	class Scene_Stress_Lights final : public Scene_Stress
+	{
+	public:
+		explicit Scene_Stress_Lights(const StressSettings& settings) : Scene_Stress(settings) {}
+		~Scene_Stress_Lights() override = default;
+
+		Scene_Stress_Lights(const Scene_Stress_Lights&) = delete;
+		Scene_Stress_Lights(Scene_Stress_Lights&&) noexcept = delete;
+		Scene_Stress_Lights& operator=(const Scene_Stress_Lights&) = delete;
+		Scene_Stress_Lights& operator=(Scene_Stress_Lights&&) noexcept = delete;
+
+		void Initialize() override;
+	};
+
+	//A corridor closed off by count walls, each with a door at a random place. Most of every ray's path and most
+	//lights are hidden behind walls.
+	class Scene_Stress_Corridor final : public Scene_Stress
+	{
+	public:
+		explicit Scene_Stress_Corridor(const StressSettings& settings) : Scene_Stress(settings) {}
+		~Scene_Stress_Corridor() override = default;
+
+		Scene_Stress_Corridor(const Scene_Stress_Corridor&) = delete;
+		Scene_Stress_Corridor(Scene_Stress_Corridor&&) noexcept = delete;
+		Scene_Stress_Corridor& operator=(const Scene_Stress_Corridor&) = delete;
+		Scene_Stress_Corridor& operator=(Scene_Stress_Corridor&&) noexcept = delete;
+
+		void Initialize() override;
+	};
 }
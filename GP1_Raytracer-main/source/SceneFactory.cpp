@@ -0,0 +1,92 @@
+#include "SceneFactory.h"
+
+#include <algorithm>
+#include <charconv>
+
+#include "Scene.h"
+#include "SceneFile.h"
+
+using namespace dae;
+
+SceneFactory& SceneFactory::GetInstance()
+{
+	static SceneFactory instance{};
+	return instance;
+}
+
+SceneFactory::SceneFactory()
+{
+	Register("Scene_W1", [] { return new Scene_W1(); });
+	Register("Scene_W2", [] { return new Scene_W2(); });
+	Register("Scene_W3", [] { return new Scene_W3(); });
+	Register("Scene_W4_Triangle", [] { return new Scene_W4_Triangle(); });
+	Register("Scene_W4_Bunny", [] { return new Scene_W4_Bunny(); });
+	Register("Scene_W4_Reference", [] { return new Scene_W4_Reference(); });
+
+	RegisterGenerator("Scene_Stress_Spheres", [](const StressSettings& settings) { return new Scene_Stress_Spheres(settings); });
+	RegisterGenerator("Scene_Stress_Bunnies", [](const StressSettings& settings) { return new Scene_Stress_Bunnies(settings); });
+	RegisterGenerator("Scene_Stress_Tessellation", [](const StressSettings& settings) { return new Scene_Stress_Tessellation(settings); });
+	RegisterGenerator("Scene_Stress_Lights", [](const StressSettings& settings) { return new Scene_Stress_Lights(settings); });
+	RegisterGenerator("Scene_Stress_Corridor", [](const StressSettings& settings) { return new Scene_Stress_Corridor(settings); });
+}
+
+void SceneFactory::Register(const std::string& name, SceneCreator creator)
+{
+	m_Creators[name] = std::move(creator);
+}
+
+void SceneFactory::RegisterGenerator(const std::string& name, GeneratorCreator creator)
+{
+	m_GeneratorCreators[name] = std::move(creator);
+}
+
+Scene* SceneFactory::Create(const std::string& name) const
+{
+	const auto it{ m_Creators.find(name) };
+	if (it == m_Creators.end())
+	{
+		if (SceneFile::IsScenePath(name))
+			return new Scene_File(name);
+
+		return CreateGenerated(name);
+	}
+
+	return it->second();
+}
+
+std::vector<std::string> SceneFactory::GetNames() const
+{
+	std::vector<std::string> names{};
+	names.reserve(m_Creators.size() + m_GeneratorCreators.size());
+
+	for (const auto& creator : m_Creators)
+		names.emplace_back(creator.first);
+	for (const auto& creator : m_GeneratorCreators)
+		names.emplace_back(creator.first);
+
+	std::sort(names.begin(), names.end());
+	return names;
+}
+
+Scene* SceneFactory::CreateGenerated(const std::string& name) const
+{
+	const size_t countStart{ name.find(':') };
+	const auto it{ m_GeneratorCreators.find(name.substr(0, countStart)) };
+	if (it == m_GeneratorCreators.end())
+		return nullptr;
+
+	StressSettings settings{};
+	if (countStart == std::string::npos)
+		return it->second(settings);
+
+	//Both are optional, anything else after the name makes it unknown
+	const char* pEnd{ name.data() + name.size() };
+	std::from_chars_result result{ std::from_chars(name.data() + countStart + 1, pEnd, settings.count) };
+	if (result.ec == std::errc{} && result.ptr != pEnd && *result.ptr == ':')
+		result = std::from_chars(result.ptr + 1, pEnd, settings.seed);
+
+	if (result.ec != std::errc{} || result.ptr != pEnd)
+		return nullptr;
+
+	return it->second(settings);
+}
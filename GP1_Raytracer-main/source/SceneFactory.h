@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace dae
+{
+	class Scene;
+	struct StressSettings;
+
+	//Creates scenes by class name, e.g. "Scene_W4_Reference". The built-in scenes are registered up front,
+	//other scenes can be added with Register. A name ending in .scene or .sceneb is loaded from that file.
+	//Generated scenes take a count and a seed after the name, "Scene_Stress_Spheres:100000:7" for one.
+	class SceneFactory final
+	{
+	public:
+		using SceneCreator = std::function<Scene*()>;
+		using GeneratorCreator = std::function<Scene*(const StressSettings&)>;
+
+		static SceneFactory& GetInstance();
+
+		SceneFactory(const SceneFactory&) = delete;
+		SceneFactory(SceneFactory&&) noexcept = delete;
+		SceneFactory& operator=(const SceneFactory&) = delete;
+		SceneFactory& operator=(SceneFactory&&) noexcept = delete;
+
+		void Register(const std::string& name, SceneCreator creator);
+		//Created as "<name>[:<count>[:<seed>]]", see StressSettings
+		void RegisterGenerator(const std::string& name, GeneratorCreator creator);
+
+		/**
+		 * \brief Creates a scene, Initialize is not called yet
+		 * \return the new scene (owned by the caller) or nullptr for an unknown name, a scene file is only read by Initialize
+		 */
+		Scene* Create(const std::string& name) const;
+
+		//Registered names, sorted
+		std::vector<std::string> GetNames() const;
+
+	private:
+		SceneFactory();
+		~SceneFactory() = default;
+
+		std::unordered_map<std::string, SceneCreator> m_Creators{};
+		std::unordered_map<std::string, GeneratorCreator> m_GeneratorCreators{};
+
+		Scene* CreateGenerated(const std::string& name) const;
+	};
+}
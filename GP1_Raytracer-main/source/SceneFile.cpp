@@ -0,0 +1,622 @@
+#include "SceneFile.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+
+#include "MappedFile.h"
+
+using namespace dae;
+
+namespace
+{
+	constexpr char Magic[8]{ 'D', 'A', 'E', 'S', 'C', 'E', 'N', 'E' };
+	constexpr uint32_t Version{ 1 };
+	//Material indices are unsigned chars, 0 is the default material
+	constexpr size_t MaxMaterials{ 255 };
+
+	struct BinaryHeader
+	{
+		char magic[8]{};
+		uint32_t version{};
+		uint32_t nrMaterials{};
+		uint32_t nrSpheres{};
+		uint32_t nrPlanes{};
+		uint32_t nrMeshes{};
+		uint32_t nrLights{};
+		Vector3 cameraOrigin{};
+		float fovAngle{};
+		float cameraYaw{};
+		float cameraPitch{};
+		uint32_t nameLength{};
+	};
+
+	//Followed by the name
+	struct BinaryMaterial
+	{
+		SceneDescription::MaterialType type{};
+		ColorRGB color{};
+		float parameters[3]{};
+		uint32_t nameLength{};
+	};
+
+	enum MeshFlags : uint32_t
+	{
+		MeshFlag_Spin = 1 << 0,
+		MeshFlag_Stream = 1 << 1,
+		MeshFlag_Compact = 1 << 2
+	};
+
+	//Followed by the path, the positions and the indices
+	struct BinaryMesh
+	{
+		uint32_t materialIndex{};
+		TriangleCullMode cullMode{};
+		//MeshFlags
+		uint32_t flags{};
+		uint32_t pathLength{};
+		uint32_t nrPositions{};
+		uint32_t nrIndices{};
+		Vector3 translation{};
+		Vector3 scale{};
+		float yaw{};
+	};
+
+	static_assert(std::is_trivially_copyable_v<SceneDescription::SphereEntry> && sizeof(SceneDescription::SphereEntry) == 20, "Spheres are copied as they are");
+	static_assert(std::is_trivially_copyable_v<SceneDescription::PlaneEntry> && sizeof(SceneDescription::PlaneEntry) == 28, "Planes are copied as they are");
+	static_assert(std::is_trivially_copyable_v<SceneDescription::LightEntry> && sizeof(SceneDescription::LightEntry) == 44, "Lights are copied as they are");
+	static_assert(sizeof(BinaryHeader) == 60 && sizeof(BinaryMaterial) == 32 && sizeof(BinaryMesh) == 52, "The layout is part of the file format");
+
+#pragma region Text
+	//The blank separated words of one line, without its comment
+	class Tokens final
+	{
+	public:
+		//Reuses the storage of the previous line
+		void Split(std::string_view line)
+		{
+			m_Values.clear();
+			m_Next = 0;
+			line = line.substr(0, line.find('#'));
+
+			size_t begin{ line.find_first_not_of(" \t\r") };
+			while (begin != std::string_view::npos)
+			{
+				const size_t end{ std::min(line.find_first_of(" \t\r", begin), line.size()) };
+				m_Values.emplace_back(line.substr(begin, end - begin));
+				begin = line.find_first_not_of(" \t\r", end);
+			}
+		}
+
+		bool IsEmpty() const { return m_Values.empty(); }
+		bool HasNext() const { return m_Next < m_Values.size(); }
+		std::string_view Peek() const { return m_Values[m_Next]; }
+		std::string_view Next() { return m_Values[m_Next++]; }
+
+		//Everything from the next word to the end of the line
+		std::string_view Rest(std::string_view line) const
+		{
+			if (!HasNext())
+				return {};
+			std::string_view rest{ line.substr(m_Values[m_Next].data() - line.data()) };
+			rest = rest.substr(0, rest.find('#'));
+			return rest.substr(0, rest.find_last_not_of(" \t\r") + 1);
+		}
+
+		bool NextFloat(float& value)
+		{
+			if (!HasNext())
+				return false;
+			const std::string_view word{ Next() };
+			const std::from_chars_result result{ std::from_chars(word.data(), word.data() + word.size(), value) };
+			return result.ec == std::errc{} && result.ptr == word.data() + word.size();
+		}
+
+		bool NextVector(Vector3& vector)
+		{
+			return NextFloat(vector.x) && NextFloat(vector.y) && NextFloat(vector.z);
+		}
+
+		bool NextColor(ColorRGB& color)
+		{
+			return NextFloat(color.r) && NextFloat(color.g) && NextFloat(color.b);
+		}
+
+	private:
+		std::vector<std::string_view> m_Values{};
+		size_t m_Next{};
+	};
+
+	class TextParser final
+	{
+	public:
+		TextParser(const std::string& path, SceneDescription& scene) :
+			m_Path{ path },
+			m_Scene{ scene }
+		{
+		}
+
+		bool Parse(std::string_view text)
+		{
+			while (!text.empty())
+			{
+				++m_LineNumber;
+				const size_t lineEnd{ std::min(text.find('\n'), text.size()) };
+				const std::string_view line{ text.substr(0, lineEnd) };
+				text.remove_prefix(std::min(lineEnd + 1, text.size()));
+
+				m_Tokens.Split(line);
+				if (!m_Tokens.IsEmpty() && !ParseStatement(line, m_Tokens))
+					return false;
+			}
+
+			return true;
+		}
+
+	private:
+		const std::string& m_Path;
+		SceneDescription& m_Scene;
+		size_t m_LineNumber{};
+		Tokens m_Tokens{};
+		std::unordered_map<std::string_view, uint32_t> m_MaterialIndices{};
+
+		bool Error(const std::string& message) const
+		{
+			std::cout << m_Path << ":" << m_LineNumber << ": " << message << std::endl;
+			return false;
+		}
+
+		bool ParseStatement(std::string_view line, Tokens& tokens)
+		{
+			const std::string_view command{ tokens.Next() };
+
+			if (command == "name")
+			{
+				m_Scene.name = tokens.Rest(line);
+				return true;
+			}
+			if (command == "camera")
+				return ParseCamera(tokens);
+			if (command == "material")
+				return ParseMaterial(tokens);
+			if (command == "sphere")
+			{
+				SceneDescription::SphereEntry& sphere{ m_Scene.spheres.emplace_back() };
+				if (!tokens.NextVector(sphere.origin) || !tokens.NextFloat(sphere.radius))
+					return Error("expected sphere <x> <y> <z> <radius> [material]");
+				return ParseMaterialName(tokens, sphere.materialIndex) && ExpectEnd(tokens);
+			}
+			if (command == "plane")
+			{
+				SceneDescription::PlaneEntry& plane{ m_Scene.planes.emplace_back() };
+				if (!tokens.NextVector(plane.origin) || !tokens.NextVector(plane.normal))
+					return Error("expected plane <x> <y> <z> <nx> <ny> <nz> [material]");
+				return ParseMaterialName(tokens, plane.materialIndex) && ExpectEnd(tokens);
+			}
+			if (command == "mesh")
+			{
+				SceneDescription::MeshEntry& mesh{ m_Scene.meshes.emplace_back() };
+				if (!tokens.HasNext())
+					return Error("expected mesh <file.obj> [material] [options]");
+				mesh.path = tokens.Next();
+				return ParseMaterialName(tokens, mesh.materialIndex) && ParseMeshOptions(tokens, mesh);
+			}
+			if (command == "triangle")
+			{
+				SceneDescription::MeshEntry& mesh{ m_Scene.meshes.emplace_back() };
+				mesh.positions.resize(3);
+				mesh.indices = { 0, 1, 2 };
+				if (!tokens.NextVector(mesh.positions[0]) || !tokens.NextVector(mesh.positions[1]) || !tokens.NextVector(mesh.positions[2]))
+					return Error("expected triangle followed by three points");
+				return ParseMaterialName(tokens, mesh.materialIndex) && ParseMeshOptions(tokens, mesh);
+			}
+			if (command == "light")
+				return ParseLight(tokens);
+
+			return Error("unknown statement '" + std::string{ command } + "'");
+		}
+
+		bool ParseCamera(Tokens& tokens)
+		{
+			if (!tokens.NextVector(m_Scene.cameraOrigin))
+				return Error("expected camera <x> <y> <z> [fov <degrees>] [yaw <degrees>] [pitch <degrees>]");
+
+			while (tokens.HasNext())
+			{
+				const std::string_view option{ tokens.Next() };
+				float* pValue{ option == "fov" ? &m_Scene.fovAngle : option == "yaw" ? &m_Scene.cameraYaw : option == "pitch" ? &m_Scene.cameraPitch : nullptr };
+				if (!pValue || !tokens.NextFloat(*pValue))
+					return Error("unknown or incomplete camera option '" + std::string{ option } + "'");
+			}
+
+			return true;
+		}
+
+		bool ParseMaterial(Tokens& tokens)
+		{
+			if (!tokens.HasNext())
+				return Error("expected material <name> <type> ...");
+
+			const std::string_view name{ tokens.Next() };
+			if (name == "default" || m_MaterialIndices.contains(name))
+				return Error("material '" + std::string{ name } + "' is already defined");
+			if (m_Scene.materials.size() == MaxMaterials)
+				return Error("a scene holds at most 255 materials");
+
+			SceneDescription::MaterialEntry material{};
+			material.name = name;
+
+			const std::string_view type{ tokens.HasNext() ? tokens.Next() : std::string_view{} };
+			size_t nrParameters{};
+			if (type == "solid")
+			{
+				material.type = SceneDescription::MaterialType::solidColor;
+			}
+			else if (type == "lambert")
+			{
+				material.type = SceneDescription::MaterialType::lambert;
+				nrParameters = 1;
+			}
+			else if (type == "phong")
+			{
+				material.type = SceneDescription::MaterialType::lambertPhong;
+				nrParameters = 3;
+			}
+			else if (type == "cooktorrence")
+			{
+				material.type = SceneDescription::MaterialType::cookTorrence;
+				nrParameters = 2;
+			}
+			else
+			{
+				return Error("unknown material type '" + std::string{ type } + "', expected solid, lambert, phong or cooktorrence");
+			}
+
+			bool isValid{ tokens.NextColor(material.color) };
+			for (size_t index{}; index < nrParameters; ++index)
+				isValid = isValid && tokens.NextFloat(material.parameters[index]);
+			if (!isValid)
+				return Error("expected " + std::to_string(3 + nrParameters) + " numbers after the " + std::string{ type } + " material type");
+
+			m_Scene.materials.emplace_back(std::move(material));
+			//The key points into the entry, reserve keeps the names from moving
+			m_MaterialIndices.emplace(m_Scene.materials.back().name, static_cast<uint32_t>(m_Scene.materials.size()));
+			return ExpectEnd(tokens);
+		}
+
+		bool ParseLight(Tokens& tokens)
+		{
+			SceneDescription::LightEntry light{};
+			const std::string_view type{ tokens.HasNext() ? tokens.Next() : std::string_view{} };
+			if (type == "point")
+				light.type = LightType::Point;
+			else if (type == "directional")
+				light.type = LightType::Directional;
+			else
+				return Error("expected light point or light directional");
+
+			Vector3& vector{ light.type == LightType::Point ? light.origin : light.direction };
+			if (!tokens.NextVector(vector) || !tokens.NextFloat(light.intensity) || !tokens.NextColor(light.color))
+				return Error("expected light " + std::string{ type } + " <x> <y> <z> <intensity> <r> <g> <b>");
+
+			m_Scene.lights.emplace_back(light);
+			return ExpectEnd(tokens);
+		}
+
+		//Optional, the next word is a material unless it is a mesh option
+		bool ParseMaterialName(Tokens& tokens, uint32_t& materialIndex)
+		{
+			if (!tokens.HasNext() || IsMeshOption(tokens.Peek()))
+				return true;
+
+			const std::string_view name{ tokens.Next() };
+			if (name == "default")
+			{
+				materialIndex = 0;
+				return true;
+			}
+
+			const auto materialIt{ m_MaterialIndices.find(name) };
+			if (materialIt == m_MaterialIndices.end())
+				return Error("unknown material '" + std::string{ name } + "'");
+
+			materialIndex = materialIt->second;
+			return true;
+		}
+
+		static bool IsMeshOption(std::string_view word)
+		{
+			return word == "cull" || word == "translate" || word == "rotate" || word == "scale" || word == "spin" || word == "stream" || word == "compact";
+		}
+
+		bool ParseMeshOptions(Tokens& tokens, SceneDescription::MeshEntry& mesh)
+		{
+			while (tokens.HasNext())
+			{
+				const std::string_view option{ tokens.Next() };
+				bool isValid{ true };
+
+				if (option == "cull")
+				{
+					const std::string_view mode{ tokens.HasNext() ? tokens.Next() : std::string_view{} };
+					isValid = mode == "back" || mode == "front" || mode == "none";
+					mesh.cullMode = mode == "front" ? TriangleCullMode::FrontFaceCulling : mode == "none" ? TriangleCullMode::NoCulling : TriangleCullMode::BackFaceCulling;
+				}
+				else if (option == "translate")
+					isValid = tokens.NextVector(mesh.translation);
+				else if (option == "rotate")
+					isValid = tokens.NextFloat(mesh.yaw);
+				else if (option == "scale")
+					isValid = tokens.NextVector(mesh.scale);
+				else if (option == "spin")
+					mesh.spin = true;
+				else if (option == "stream")
+					mesh.stream = true;
+				else if (option == "compact")
+					mesh.compact = true;
+				else
+					return Error("unknown mesh option '" + std::string{ option } + "'");
+
+				if (!isValid)
+					return Error("incomplete mesh option '" + std::string{ option } + "'");
+			}
+
+			return true;
+		}
+
+		bool ExpectEnd(const Tokens& tokens) const
+		{
+			return !tokens.HasNext() || Error("unexpected '" + std::string{ tokens.Peek() } + "'");
+		}
+	};
+#pragma endregion
+
+#pragma region Binary
+	class BinaryReader final
+	{
+	public:
+		BinaryReader(const char* pData, size_t size) :
+			m_pCurrent{ pData },
+			m_pEnd{ pData + size }
+		{
+		}
+
+		template<typename T>
+		bool Read(T& value)
+		{
+			return Read(&value, sizeof(T));
+		}
+
+		bool Read(void* pValue, size_t size)
+		{
+			if (static_cast<size_t>(m_pEnd - m_pCurrent) < size)
+				return false;
+			std::memcpy(pValue, m_pCurrent, size);
+			m_pCurrent += size;
+			return true;
+		}
+
+		//Checks the size before allocating, a damaged count fails instead of reserving gigabytes
+		template<typename T>
+		bool ReadArray(std::vector<T>& values, size_t count)
+		{
+			if (static_cast<size_t>(m_pEnd - m_pCurrent) / sizeof(T) < count)
+				return false;
+			values.resize(count);
+			return Read(values.data(), count * sizeof(T));
+		}
+
+		bool ReadString(std::string& value, size_t length)
+		{
+			if (static_cast<size_t>(m_pEnd - m_pCurrent) < length)
+				return false;
+			value.assign(m_pCurrent, length);
+			m_pCurrent += length;
+			return true;
+		}
+
+	private:
+		const char* m_pCurrent;
+		const char* m_pEnd;
+	};
+
+	bool ReadBinary(const char* pData, size_t size, SceneDescription& scene)
+	{
+		BinaryReader reader{ pData, size };
+
+		BinaryHeader header{};
+		if (!reader.Read(header) || header.version != Version || header.nrMaterials > MaxMaterials || !reader.ReadString(scene.name, header.nameLength))
+			return false;
+
+		scene.cameraOrigin = header.cameraOrigin;
+		scene.fovAngle = header.fovAngle;
+		scene.cameraYaw = header.cameraYaw;
+		scene.cameraPitch = header.cameraPitch;
+
+		scene.materials.resize(header.nrMaterials);
+		for (SceneDescription::MaterialEntry& material : scene.materials)
+		{
+			BinaryMaterial record{};
+			if (!reader.Read(record) || record.type > SceneDescription::MaterialType::cookTorrence || !reader.ReadString(material.name, record.nameLength))
+				return false;
+
+			material.type = record.type;
+			material.color = record.color;
+			std::memcpy(material.parameters, record.parameters, sizeof(material.parameters));
+		}
+
+		if (!reader.ReadArray(scene.spheres, header.nrSpheres) || !reader.ReadArray(scene.planes, header.nrPlanes) || !reader.ReadArray(scene.lights, header.nrLights))
+			return false;
+
+		scene.meshes.resize(header.nrMeshes);
+		for (SceneDescription::MeshEntry& mesh : scene.meshes)
+		{
+			BinaryMesh record{};
+			if (!reader.Read(record) || static_cast<uint32_t>(record.cullMode) > static_cast<uint32_t>(TriangleCullMode::NoCulling) || !reader.ReadString(mesh.path, record.pathLength)
+				|| !reader.ReadArray(mesh.positions, record.nrPositions) || !reader.ReadArray(mesh.indices, record.nrIndices))
+				return false;
+
+			const int nrPositions{ static_cast<int>(record.nrPositions) };
+			const bool indicesValid{ mesh.indices.size() % 3 == 0
+				&& std::all_of(mesh.indices.begin(), mesh.indices.end(), [nrPositions](int index) { return index >= 0 && index < nrPositions; }) };
+			if (!indicesValid || record.materialIndex > header.nrMaterials)
+				return false;
+
+			mesh.materialIndex = record.materialIndex;
+			mesh.cullMode = record.cullMode;
+			mesh.spin = (record.flags & MeshFlag_Spin) != 0;
+			mesh.stream = (record.flags & MeshFlag_Stream) != 0;
+			mesh.compact = (record.flags & MeshFlag_Compact) != 0;
+			mesh.translation = record.translation;
+			mesh.scale = record.scale;
+			mesh.yaw = record.yaw;
+		}
+
+		//Everything a material index or type could break the renderer with
+		const auto materialValid = [&header](const auto& entry) { return entry.materialIndex <= header.nrMaterials; };
+		const auto lightValid = [](const SceneDescription::LightEntry& light) { return light.type == LightType::Point || light.type == LightType::Directional; };
+		return std::all_of(scene.spheres.begin(), scene.spheres.end(), materialValid)
+			&& std::all_of(scene.planes.begin(), scene.planes.end(), materialValid)
+			&& std::all_of(scene.lights.begin(), scene.lights.end(), lightValid);
+	}
+#pragma endregion
+}
+
+bool SceneFile::Load(const std::string& path, SceneDescription& scene)
+{
+	const MappedFile file{ path };
+	if (!file.IsOpen())
+	{
+		std::cout << "Could not open " << path << std::endl;
+		return false;
+	}
+
+	scene = SceneDescription{};
+
+	if (file.GetSize() >= sizeof(Magic) && std::memcmp(file.GetData(), Magic, sizeof(Magic)) == 0)
+	{
+		if (ReadBinary(file.GetData(), file.GetSize(), scene))
+			return true;
+
+		std::cout << path << " is damaged or from another version" << std::endl;
+		return false;
+	}
+
+	//Material names are looked up while parsing, their entries must stay in place
+	scene.materials.reserve(MaxMaterials);
+	const bool isValid{ TextParser{ path, scene }.Parse(std::string_view{ file.GetData(), file.GetSize() }) };
+	scene.materials.shrink_to_fit();
+	return isValid;
+}
+
+bool SceneFile::Write(const std::string& path, const SceneDescription& scene)
+{
+	std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+	if (!file)
+		return false;
+
+	const auto write = [&file](const void* pData, size_t size)
+	{
+		file.write(static_cast<const char*>(pData), static_cast<std::streamsize>(size));
+	};
+
+	BinaryHeader header{};
+	std::memcpy(header.magic, Magic, sizeof(Magic));
+	header.version = Version;
+	header.nrMaterials = static_cast<uint32_t>(scene.materials.size());
+	header.nrSpheres = static_cast<uint32_t>(scene.spheres.size());
+	header.nrPlanes = static_cast<uint32_t>(scene.planes.size());
+	header.nrMeshes = static_cast<uint32_t>(scene.meshes.size());
+	header.nrLights = static_cast<uint32_t>(scene.lights.size());
+	header.cameraOrigin = scene.cameraOrigin;
+	header.fovAngle = scene.fovAngle;
+	header.cameraYaw = scene.cameraYaw;
+	header.cameraPitch = scene.cameraPitch;
+	header.nameLength = static_cast<uint32_t>(scene.name.size());
+	write(&header, sizeof(header));
+	write(scene.name.data(), scene.name.size());
+
+	for (const SceneDescription::MaterialEntry& material : scene.materials)
+	{
+		BinaryMaterial record{};
+		record.type = material.type;
+		record.color = material.color;
+		std::memcpy(record.parameters, material.parameters, sizeof(record.parameters));
+		record.nameLength = static_cast<uint32_t>(material.name.size());
+		write(&record, sizeof(record));
+		write(material.name.data(), material.name.size());
+	}
+
+	write(scene.spheres.data(), scene.spheres.size() * sizeof(SceneDescription::SphereEntry));
+	write(scene.planes.data(), scene.planes.size() * sizeof(SceneDescription::PlaneEntry));
+	write(scene.lights.data(), scene.lights.size() * sizeof(SceneDescription::LightEntry));
+
+	for (const SceneDescription::MeshEntry& mesh : scene.meshes)
+	{
+		BinaryMesh record{};
+		record.materialIndex = mesh.materialIndex;
+		record.cullMode = mesh.cullMode;
+		record.flags = (mesh.spin ? MeshFlag_Spin : 0u) | (mesh.stream ? MeshFlag_Stream : 0u)
+			| (mesh.compact ? MeshFlag_Compact : 0u);
+		record.pathLength = static_cast<uint32_t>(mesh.path.size());
+		record.nrPositions = static_cast<uint32_t>(mesh.positions.size());
+		record.nrIndices = static_cast<uint32_t>(mesh.indices.size());
+		record.translation = mesh.translation;
+		record.scale = mesh.scale;
+		record.yaw = mesh.yaw;
+		write(&record, sizeof(record));
+		write(mesh.path.data(), mesh.path.size());
+		write(mesh.positions.data(), mesh.positions.size() * sizeof(Vector3));
+		write(mesh.indices.data(), mesh.indices.size() * sizeof(int));
+	}
+
+	return static_cast<bool>(file.flush());
+}
+
+bool SceneFile::IsScenePath(const std::string& name)
+{
+	const std::filesystem::path extension{ std::filesystem::path{ name }.extension() };
+	return extension == ".scene" || extension == ".sceneb";
+}
+
+std::string SceneFile::GetBinaryPath(const std::string& path)
+{
+	return std::filesystem::path{ path }.replace_extension(".sceneb").string();
+}
+
+bool SceneDescription::MaterialEntry::operator==(const MaterialEntry& other) const
+{
+	return name == other.name && type == other.type && std::memcmp(&color, &other.color, sizeof(color)) == 0
+		&& std::memcmp(parameters, other.parameters, sizeof(parameters)) == 0;
+}
+
+bool SceneDescription::SphereEntry::operator==(const SphereEntry& other) const
+{
+	return std::memcmp(this, &other, sizeof(SphereEntry)) == 0;
+}
+
+bool SceneDescription::PlaneEntry::operator==(const PlaneEntry& other) const
+{
+	return std::memcmp(this, &other, sizeof(PlaneEntry)) == 0;
+}
+
+bool SceneDescription::LightEntry::operator==(const LightEntry& other) const
+{
+	return std::memcmp(this, &other, sizeof(LightEntry)) == 0;
+}
+
+bool SceneDescription::MeshEntry::operator==(const MeshEntry& other) const
+{
+	return path == other.path && materialIndex == other.materialIndex && cullMode == other.cullMode && spin == other.spin && stream == other.stream && compact == other.compact
+		&& positions.size() == other.positions.size()
+		&& (positions.empty() || std::memcmp(positions.data(), other.positions.data(), positions.size() * sizeof(Vector3)) == 0)
+		&& indices == other.indices
+		&& std::memcmp(&translation, &other.translation, sizeof(Vector3)) == 0 && std::memcmp(&scale, &other.scale, sizeof(Vector3)) == 0
+		&& std::memcmp(&yaw, &other.yaw, sizeof(float)) == 0;
+}
@@ -0,0 +1,134 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ColorRGB.h"
+#include "DataTypes.h"
+#include "Vector3.h"
+
+namespace dae
+{
+	//Everything a scene file describes, Scene_File turns it into materials, geometry and lights.
+	//Material indices follow the Scene: 0 is the default material, i + 1 the i-th entry of materials.
+	struct SceneDescription
+	{
+		enum class MaterialType : uint32_t
+		{
+			solidColor,
+			lambert, //parameters: kd
+			lambertPhong, //parameters: kd, ks, phong exponent
+			cookTorrence //parameters: metalness, roughness
+		};
+
+		struct MaterialEntry
+		{
+			std::string name{};
+			MaterialType type{};
+			ColorRGB color{};
+			float parameters[3]{};
+
+			bool operator==(const MaterialEntry& other) const;
+		};
+
+		//Spheres, planes and lights are stored as they are in the binary file.
+		//Entries compare bit for bit, that is what a hot reload uses to find what changed.
+		struct SphereEntry
+		{
+			Vector3 origin{};
+			float radius{};
+			uint32_t materialIndex{};
+
+			bool operator==(const SphereEntry& other) const;
+		};
+
+		struct PlaneEntry
+		{
+			Vector3 origin{};
+			Vector3 normal{};
+			uint32_t materialIndex{};
+
+			bool operator==(const PlaneEntry& other) const;
+		};
+
+		struct LightEntry
+		{
+			Vector3 origin{};
+			Vector3 direction{};
+			ColorRGB color{};
+			float intensity{};
+			LightType type{};
+
+			bool operator==(const LightEntry& other) const;
+		};
+
+		//An OBJ file, or positions and indices given in the scene itself when path is empty
+		struct MeshEntry
+		{
+			//Relative to the scene file
+			std::string path{};
+			std::vector<Vector3> positions{};
+			std::vector<int> indices{};
+			uint32_t materialIndex{};
+			TriangleCullMode cullMode{ TriangleCullMode::BackFaceCulling };
+			Vector3 translation{};
+			Vector3 scale{ 1.f, 1.f, 1.f };
+			//Degrees around Y
+			float yaw{};
+			//Swings around Y over time like the W4 scenes, replaces yaw
+			bool spin{ false };
+			//The OBJ file's triangles stay on disk and are paged in while rendering, see MeshClusters
+			bool stream{ false };
+			//Keeps the triangles quantized, see CompactMesh
+			bool compact{ false };
+
+			bool operator==(const MeshEntry& other) const;
+		};
+
+		std::string name{};
+
+		Vector3 cameraOrigin{};
+		float fovAngle{ 90.f };
+		//Degrees
+		float cameraYaw{};
+		float cameraPitch{};
+
+		std::vector<MaterialEntry> materials{};
+		std::vector<SphereEntry> spheres{};
+		std::vector<PlaneEntry> planes{};
+		std::vector<MeshEntry> meshes{};
+		std::vector<LightEntry> lights{};
+	};
+
+	//Reads and writes scene descriptions. The text form has a statement per line, '#' starts a comment:
+	//
+	//  name <rest of the line>
+	//  camera <x> <y> <z> [fov <degrees>] [yaw <degrees>] [pitch <degrees>]
+	//  material <name> solid <r> <g> <b>
+	//  material <name> lambert <r> <g> <b> <kd>
+	//  material <name> phong <r> <g> <b> <kd> <ks> <exponent>
+	//  material <name> cooktorrence <r> <g> <b> <metalness> <roughness>
+	//  sphere <x> <y> <z> <radius> [material]
+	//  plane <x> <y> <z> <nx> <ny> <nz> [material]
+	//  mesh <file.obj> [material] [mesh options]
+	//  triangle <x0> <y0> <z0> <x1> <y1> <z1> <x2> <y2> <z2> [material] [mesh options]
+	//  light point <x> <y> <z> <intensity> <r> <g> <b>
+	//  light directional <x> <y> <z> <intensity> <r> <g> <b>
+	//
+	//Materials are referred to by name once defined, "default" or no name is the scene's default material. Mesh options
+	//are cull <back|front|none>, translate <x> <y> <z>, rotate <yaw degrees>, scale <x> <y> <z>, spin, compact and,
+	//for OBJ files, stream. Faces of an OBJ file with a usemtl that names a scene material get that material.
+	//The binary form holds the same data with the spheres, planes and lights as arrays that are copied in one go,
+	//for scenes too big to parse at startup.
+	namespace SceneFile
+	{
+		//Either form, told apart by the binary header. Errors are printed with their line.
+		bool Load(const std::string& path, SceneDescription& scene);
+		bool Write(const std::string& path, const SceneDescription& scene);
+
+		//Whether a scene name given to the SceneFactory is a path to a scene file, by extension (.scene or .sceneb)
+		bool IsScenePath(const std::string& name);
+		//The binary form next to a text scene, "a.scene" becomes "a.sceneb"
+		std::string GetBinaryPath(const std::string& path);
+	}
+}
@@ -0,0 +1,206 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <filesystem>
+#include <pthread.h>
+#endif
+
+using namespace dae;
+
+namespace
+{
+	struct Processor
+	{
+		uint32_t index{};
+		uint32_t node{};
+	};
+
+	uint32_t GetProcessorNode(uint32_t processor)
+	{
+#ifdef _WIN32
+		PROCESSOR_NUMBER number{};
+		number.Group = static_cast<WORD>(processor / 64);
+		number.Number = static_cast<BYTE>(processor % 64);
+
+		USHORT node{};
+		if (GetNumaProcessorNodeEx(&number, &node) && node != 0xFFFF)
+			return node;
+#else
+		//The sysfs entry of a cpu holds a nodeN link to the node it belongs to
+		std::error_code error{};
+		for (const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/cpu/cpu" + std::to_string(processor), error))
+		{
+			const std::string name{ entry.path().filename().string() };
+			if (name.size() > 4 && name.compare(0, 4, "node") == 0 && std::isdigit(static_cast<unsigned char>(name[4])))
+				return static_cast<uint32_t>(std::stoul(name.substr(4)));
+		}
+#endif
+		return 0;
+	}
+
+	bool PinThread(std::thread& thread, uint32_t processor)
+	{
+#ifdef _WIN32
+		GROUP_AFFINITY affinity{};
+		affinity.Group = static_cast<WORD>(processor / 64);
+		affinity.Mask = KAFFINITY(1) << (processor % 64);
+		return SetThreadGroupAffinity(thread.native_handle(), &affinity, nullptr) != 0;
+#else
+		cpu_set_t set{};
+		CPU_ZERO(&set);
+		CPU_SET(processor, &set);
+		return pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) == 0;
+#endif
+	}
+}
+
+ThreadPool::ThreadPool(uint32_t nrWorkers, bool pinWorkers) :
+	m_IsPinned(pinWorkers)
+{
+	const uint32_t nrHardwareThreads{ GetNrHardwareThreads() };
+	if (nrWorkers == 0)
+		nrWorkers = nrHardwareThreads;
+
+	//Processors grouped per node, consecutive workers then share a node and get neighboring slices
+	std::vector<Processor> processors(nrHardwareThreads);
+	for (uint32_t index{}; index < nrHardwareThreads; ++index)
+		processors[index] = { index, pinWorkers ? GetProcessorNode(index) : 0 };
+
+	std::stable_sort(processors.begin(), processors.end(), [](const Processor& a, const Processor& b) { return a.node < b.node; });
+
+	//Unpinned workers migrate freely, their node means nothing
+	std::vector<uint32_t> workerNodes(nrWorkers);
+	for (uint32_t worker{}; worker < nrWorkers; ++worker)
+	{
+		workerNodes[worker] = processors[worker % nrHardwareThreads].node;
+		m_NrNodes = std::max(m_NrNodes, workerNodes[worker] + 1);
+	}
+
+	m_StealOrders.resize(nrWorkers);
+	for (uint32_t worker{}; worker < nrWorkers; ++worker)
+	{
+		std::vector<uint32_t>& order{ m_StealOrders[worker] };
+		order.reserve(nrWorkers);
+		order.emplace_back(worker);
+
+		for (uint32_t other{}; other < nrWorkers; ++other)
+		{
+			if (other != worker && workerNodes[other] == workerNodes[worker])
+				order.emplace_back(other);
+		}
+		for (uint32_t other{}; other < nrWorkers; ++other)
+		{
+			if (workerNodes[other] != workerNodes[worker])
+				order.emplace_back(other);
+		}
+	}
+
+	m_pSlices = std::make_unique<Slice[]>(nrWorkers);
+
+	m_Workers.reserve(nrWorkers);
+	for (uint32_t worker{}; worker < nrWorkers; ++worker)
+	{
+		m_Workers.emplace_back(&ThreadPool::WorkerLoop, this, worker);
+
+		if (pinWorkers)
+			m_IsPinned = PinThread(m_Workers.back(), processors[worker % nrHardwareThreads].index) && m_IsPinned;
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+		m_Quit = true;
+	}
+	m_WorkAvailable.notify_all();
+
+	for (std::thread& worker : m_Workers)
+		worker.join();
+}
+
+void ThreadPool::ParallelFor(uint32_t nrItems, const std::function<void(uint32_t)>& task, const std::function<void()>& onWait)
+{
+	if (nrItems == 0)
+		return;
+
+	const uint64_t nrWorkers{ m_Workers.size() };
+	for (uint64_t worker{}; worker < nrWorkers; ++worker)
+	{
+		m_pSlices[worker].next = static_cast<uint32_t>(nrItems * worker / nrWorkers);
+		m_pSlices[worker].end = static_cast<uint32_t>(nrItems * (worker + 1) / nrWorkers);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+		m_pTask = &task;
+		m_NrBusyWorkers = static_cast<uint32_t>(nrWorkers);
+		++m_Generation;
+	}
+	m_WorkAvailable.notify_all();
+
+	std::unique_lock<std::mutex> lock{ m_Mutex };
+	if (onWait)
+	{
+		while (!m_WorkDone.wait_for(lock, WaitInterval, [this] { return m_NrBusyWorkers == 0; }))
+		{
+			lock.unlock();
+			onWait();
+			lock.lock();
+		}
+	}
+	else
+	{
+		m_WorkDone.wait(lock, [this] { return m_NrBusyWorkers == 0; });
+	}
+	m_pTask = nullptr;
+}
+
+uint32_t ThreadPool::GetNrHardwareThreads()
+{
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void ThreadPool::WorkerLoop(uint32_t workerIndex)
+{
+	uint64_t generation{};
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock{ m_Mutex };
+			m_WorkAvailable.wait(lock, [&] { return m_Quit || m_Generation != generation; });
+
+			if (m_Quit)
+				return;
+
+			generation = m_Generation;
+		}
+
+		RunSlices(workerIndex);
+
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+		if (--m_NrBusyWorkers == 0)
+			m_WorkDone.notify_one();
+	}
+}
+
+void ThreadPool::RunSlices(uint32_t workerIndex)
+{
+	const std::function<void(uint32_t)>& task{ *m_pTask };
+
+	for (uint32_t sliceIndex : m_StealOrders[workerIndex])
+	{
+		Slice& slice{ m_pSlices[sliceIndex] };
+		for (uint32_t item{ slice.next++ }; item < slice.end; item = slice.next++)
+			task(item);
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	//Fixed set of worker threads for the tile loops. Workers are optionally pinned to one logical processor
+	//each, in NUMA node order, and every worker owns a contiguous slice of the items it is given so the same
+	//worker (and node) keeps touching the same part of the framebuffer from frame to frame.
+	class ThreadPool final
+	{
+	public:
+		/**
+		 * \param nrWorkers number of worker threads, 0 uses every hardware thread
+		 * \param pinWorkers pins each worker to its own logical processor
+		 */
+		ThreadPool(uint32_t nrWorkers = 0, bool pinWorkers = false);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool(ThreadPool&&) noexcept = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool& operator=(ThreadPool&&) noexcept = delete;
+
+		/**
+		 * \brief Calls task(item) for every item in [0, nrItems) and blocks until all are done.
+		 * Workers first drain their own slice, then steal from the slices of the same node, then from the others.
+		 * \param onWait when set, the calling thread runs it every WaitInterval until the items are done
+		 */
+		void ParallelFor(uint32_t nrItems, const std::function<void(uint32_t)>& task, const std::function<void()>& onWait = nullptr);
+
+		uint32_t GetNrWorkers() const { return static_cast<uint32_t>(m_Workers.size()); }
+		uint32_t GetNrNodes() const { return m_NrNodes; }
+		bool IsPinned() const { return m_IsPinned; }
+
+		static uint32_t GetNrHardwareThreads();
+
+	private:
+		static constexpr std::chrono::milliseconds WaitInterval{ 1 };
+
+		//Own cache line per slice, the counters are hammered by different workers
+		struct alignas(64) Slice
+		{
+			std::atomic<uint32_t> next{};
+			uint32_t end{};
+		};
+
+		std::vector<std::thread> m_Workers{};
+		std::unique_ptr<Slice[]> m_pSlices{};
+		//Per worker: the slices it visits, its own first and the other nodes last
+		std::vector<std::vector<uint32_t>> m_StealOrders{};
+		uint32_t m_NrNodes{ 1 };
+		bool m_IsPinned{ false };
+
+		std::mutex m_Mutex{};
+		std::condition_variable m_WorkAvailable{};
+		std::condition_variable m_WorkDone{};
+		const std::function<void(uint32_t)>* m_pTask{};
+		uint64_t m_Generation{};
+		uint32_t m_NrBusyWorkers{};
+		bool m_Quit{ false };
+
+		void WorkerLoop(uint32_t workerIndex);
+		void RunSlices(uint32_t workerIndex);
+	};
+}
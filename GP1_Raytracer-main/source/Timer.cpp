@@ -41,6 +41,13 @@ void Timer::Start()
 	}
 }
 
+void Timer::SetFixedTimeStep(float timeStep)
+{
+	m_FixedTimeStep = timeStep;
+	m_ElapsedTime = 0.0f;
+	m_TotalTime = 0.0f;
+}
+
 void Timer::StartBenchmark(int numFrames)
 {
 	if (m_BenchmarkActive)
@@ -74,6 +81,13 @@ void Timer::Update()
 		return;
 	}
 
+	if (m_FixedTimeStep > 0.0f)
+	{
+		m_ElapsedTime = m_FixedTimeStep;
+		m_TotalTime += m_FixedTimeStep;
+		return;
+	}
+
 	const uint64_t currentTime = SDL_GetPerformanceCounter();
 	m_CurrentTime = currentTime;
 
@@ -19,6 +19,10 @@ namespace dae
 
 		void StartBenchmark(int numFrames = 10);
 
+		//Every Update advances the elapsed and total time by exactly timeStep (0 switches back to real time).
+		//Makes animated scenes reproducible in batch renders, however long a frame takes.
+		void SetFixedTimeStep(float timeStep);
+
 		void Reset();
 		void Start();
 		void Update();
@@ -47,6 +51,8 @@ namespace dae
 		float m_ElapsedUpperBound = 0.03f;
 		float m_FPSTimer = 0.0f;
 
+		float m_FixedTimeStep = 0.0f;
+
 		bool m_IsStopped = true;
 		bool m_ForceElapsedUpperBound = false;
 
@@ -2,7 +2,9 @@
 #include <cassert>
 #include <fstream>
 #include "Math.h"
+#include "CompactMesh.h"
 #include "DataTypes.h"
+#include "MeshClusters.h"
 
 namespace dae
 {
@@ -199,6 +201,24 @@ namespace dae
 		}
 #pragma endregion
 #pragma region TriangeMesh HitTest
+		//Normal at point on the triangle, smoothed from the vertex normals with its barycentric coordinates
+		inline Vector3 InterpolateNormal(const Triangle& triangle, const Vector3& point, const Vector3& normal0, const Vector3& normal1, const Vector3& normal2)
+		{
+			const Vector3 edge1{ triangle.v1 - triangle.v0 };
+			const Vector3 edge2{ triangle.v2 - triangle.v0 };
+			const Vector3 toHit{ point - triangle.v0 };
+			const float dot11{ Vector3::Dot(edge1, edge1) };
+			const float dot12{ Vector3::Dot(edge1, edge2) };
+			const float dot22{ Vector3::Dot(edge2, edge2) };
+			const float dotHit1{ Vector3::Dot(toHit, edge1) };
+			const float dotHit2{ Vector3::Dot(toHit, edge2) };
+			const float inverseDenominator{ 1.f / (dot11 * dot22 - dot12 * dot12) };
+			const float v{ (dot22 * dotHit1 - dot12 * dotHit2) * inverseDenominator };
+			const float w{ (dot11 * dotHit2 - dot12 * dotHit1) * inverseDenominator };
+
+			return (normal0 * (1.f - v - w) + normal1 * v + normal2 * w).Normalized();
+		}
+
 		inline bool SlabTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray)
 		{
 			//optimizations by Robbe
@@ -229,6 +249,53 @@ namespace dae
 
 			return true;
 		}
+		//Triangles read straight from the MeshCache mapping, the ray is moved into object space and the closest hit is moved back
+		inline bool HitTest_MappedMesh(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord)
+		{
+			const MeshCache::MeshView& view{ *mesh.pMapped };
+
+			//The direction isn't normalized, t stays the distance along the world ray
+			const Ray localRay{ mesh.inverseTransform.TransformPoint(ray.origin), mesh.inverseTransform.TransformVector(ray.direction), ray.min, ray.max };
+
+			Triangle triangle{};
+			triangle.cullMode = mesh.cullMode;
+			triangle.materialIndex = mesh.materialIndex;
+			bool isHit{ false };
+
+			for (size_t i = 0; i < view.indices.size(); i += 3)
+			{
+				triangle.v0 = view.positions[view.indices[i]];
+				triangle.v1 = view.positions[view.indices[i + 1]];
+				triangle.v2 = view.positions[view.indices[i + 2]];
+				triangle.normal = view.normals[i / 3];
+
+				if (!HitTest_Triangle(triangle, localRay, hitRecord, ignoreHitRecord))
+				{
+					continue;
+				}
+
+				if (ignoreHitRecord)
+				{
+					return true;
+				}
+
+				isHit = true;
+				if (!view.vertexNormals.empty())
+				{
+					hitRecord.normal = InterpolateNormal(triangle, hitRecord.origin, view.vertexNormals[view.indices[i]],
+						view.vertexNormals[view.indices[i + 1]], view.vertexNormals[view.indices[i + 2]]);
+				}
+			}
+
+			if (isHit)
+			{
+				hitRecord.origin = ray.origin + ray.direction * hitRecord.t;
+				hitRecord.normal = mesh.finalTransform.TransformVector(hitRecord.normal).Normalized();
+			}
+
+			return hitRecord.didHit;
+		}
+
 		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
 		{
 			if (!SlabTest_TriangleMesh(mesh, ray))
@@ -236,7 +303,21 @@ namespace dae
 				return false;
 			}
 
-			
+			if (mesh.pClusters)
+			{
+				return mesh.pClusters->HitTest(mesh, ray, hitRecord, ignoreHitRecord);
+			}
+
+			if (mesh.pCompact)
+			{
+				return mesh.pCompact->HitTest(mesh, ray, hitRecord, ignoreHitRecord);
+			}
+
+			if (mesh.pMapped)
+			{
+				return HitTest_MappedMesh(mesh, ray, hitRecord, ignoreHitRecord);
+			}
+
 			Triangle triangle{};
 			for (size_t i = 0; i < mesh.indices.size(); i += 3)
 			{
@@ -256,13 +337,22 @@ namespace dae
 				triangle.cullMode = mesh.cullMode;
 				triangle.materialIndex = mesh.materialIndex;
 
-				if (ignoreHitRecord && hitRecord.didHit)
+				if (!HitTest_Triangle(triangle, ray, hitRecord, ignoreHitRecord))
+				{
+					continue;
+				}
+
+				//Any hit is enough for a shadow ray, hitRecord isn't filled in then
+				if (ignoreHitRecord)
 				{
 					return true;
 				}
 
-				
-				HitTest_Triangle(triangle, ray, hitRecord,ignoreHitRecord);
+				if (!mesh.transformedVertexNormals.empty())
+				{
+					hitRecord.normal = InterpolateNormal(triangle, hitRecord.origin, mesh.transformedVertexNormals[mesh.indices[i]],
+						mesh.transformedVertexNormals[mesh.indices[i + 1]], mesh.transformedVertexNormals[mesh.indices[i + 2]]);
+				}
 
 			}
 			return hitRecord.didHit;
@@ -291,81 +381,4 @@ namespace dae
 			return light.color * (light.intensity / (light.origin - target).SqrMagnitude());
 		}
 	}
-
-	namespace Utils
-	{
-		//Just parses vertices and indices
-#pragma warning(push)
-#pragma warning(disable : 4505) //Warning unreferenced local function
-		static bool ParseOBJ(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices)
-		{
-
-			std::ifstream file(filename);
-			if (!file)
-				return false;
-
-			std::string sCommand;
-			// start a while iteration ending when the end of file is reached (ios::eof)
-			while (!file.eof())
-			{
-				//read the first word of the string, use the >> operator (istream::operator>>) 
-				file >> sCommand;
-				//use conditional statements to process the different commands	
-				if (sCommand == "#")
-				{
-					// Ignore Comment
-				}
-				else if (sCommand == "v")
-				{
-					//Vertex
-					float x, y, z;
-					file >> x >> y >> z;
-					positions.push_back({ x, y, z });
-				}
-				else if (sCommand == "f")
-				{
-					float i0, i1, i2;
-					file >> i0 >> i1 >> i2;
-
-					indices.push_back((int)i0 - 1);
-					indices.push_back((int)i1 - 1);
-					indices.push_back((int)i2 - 1);
-				}
-				//read till end of line and ignore all remaining chars
-				file.ignore(1000, '\n');
-
-				if (file.eof()) 
-					break;
-			}
-
-			//Precompute normals
-			for (uint64_t index = 0; index < indices.size(); index += 3)
-			{
-				uint32_t i0 = indices[index];
-				uint32_t i1 = indices[index + 1];
-				uint32_t i2 = indices[index + 2];
-
-				Vector3 edgeV0V1 = positions[i1] - positions[i0];
-				Vector3 edgeV0V2 = positions[i2] - positions[i0];
-				Vector3 normal = Vector3::Cross(edgeV0V1, edgeV0V2);
-
-				if(isnan(normal.x))
-				{
-					int k = 0;
-				}
-
-				normal.Normalize();
-				if (isnan(normal.x))
-				{
-					int k = 0;
-				}
-
-				normals.push_back(normal);
-			}
-
-
-			return true;
-		}
-#pragma warning(pop)
-	}
 }
\ No newline at end of file
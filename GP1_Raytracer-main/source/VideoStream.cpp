@@ -0,0 +1,396 @@
+#include "VideoStream.h"
+
+#include <cstring>
+
+#include "SDL.h"
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <csignal>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define VIDEOSTREAM_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace dae;
+
+namespace
+{
+	struct Rgb
+	{
+		int r{}, g{}, b{};
+	};
+
+	//BT.601 limited range in 8-bit fixed point, the same constants as the vectorized path
+	uint8_t Luma(const Rgb& color)
+	{
+		return static_cast<uint8_t>(((66 * color.r + 129 * color.g + 25 * color.b + 128) >> 8) + 16);
+	}
+
+	uint8_t ChromaBlue(const Rgb& color)
+	{
+		return static_cast<uint8_t>(((-38 * color.r - 74 * color.g + 112 * color.b + 128) >> 8) + 128);
+	}
+
+	uint8_t ChromaRed(const Rgb& color)
+	{
+		return static_cast<uint8_t>(((112 * color.r - 94 * color.g - 18 * color.b + 128) >> 8) + 128);
+	}
+
+	//Luma of columns [firstX, width) of one row and chroma of the 2x2 blocks starting at even firstX of a row pair.
+	//pixelAt(x, y) returns the color of a pixel, rows and columns past the edge repeat the last one.
+	template<typename PixelAt>
+	void ConvertRowPair(const PixelAt& pixelAt, int firstX, int width, int height, int y, uint8_t* pY, uint8_t* pU, uint8_t* pV)
+	{
+		const int nextY{ y + 1 < height ? y + 1 : y };
+		for (int x{ firstX }; x < width; ++x)
+		{
+			pY[y * width + x] = Luma(pixelAt(x, y));
+			if (nextY != y)
+				pY[nextY * width + x] = Luma(pixelAt(x, nextY));
+		}
+
+		const int chromaWidth{ (width + 1) / 2 };
+		for (int x{ firstX }; x < width; x += 2)
+		{
+			const int nextX{ x + 1 < width ? x + 1 : x };
+			const Rgb a{ pixelAt(x, y) }, b{ pixelAt(nextX, y) }, c{ pixelAt(x, nextY) }, d{ pixelAt(nextX, nextY) };
+			const Rgb average{ (a.r + b.r + c.r + d.r + 2) >> 2, (a.g + b.g + c.g + d.g + 2) >> 2, (a.b + b.b + c.b + d.b + 2) >> 2 };
+
+			const int chromaIndex{ y / 2 * chromaWidth + x / 2 };
+			pU[chromaIndex] = ChromaBlue(average);
+			pV[chromaIndex] = ChromaRed(average);
+		}
+	}
+
+#ifdef VIDEOSTREAM_SSE2
+	struct Channels
+	{
+		__m128i r, g, b;
+	};
+
+	//8 pixels to 16-bit lanes per channel
+	Channels LoadChannels(const uint32_t* pPixels, __m128i redShift, __m128i greenShift, __m128i blueShift)
+	{
+		const __m128i low{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(pPixels)) };
+		const __m128i high{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(pPixels + 4)) };
+		const __m128i mask{ _mm_set1_epi32(0xFF) };
+
+		const auto extract = [&](__m128i shift)
+		{
+			return _mm_packs_epi32(_mm_and_si128(_mm_srl_epi32(low, shift), mask), _mm_and_si128(_mm_srl_epi32(high, shift), mask));
+		};
+		return { extract(redShift), extract(greenShift), extract(blueShift) };
+	}
+
+	//The weighted sum stays below 2^16, so it fits unsigned 16-bit lanes
+	__m128i LumaVector(const Channels& channels)
+	{
+		__m128i sum{ _mm_mullo_epi16(channels.r, _mm_set1_epi16(66)) };
+		sum = _mm_add_epi16(sum, _mm_mullo_epi16(channels.g, _mm_set1_epi16(129)));
+		sum = _mm_add_epi16(sum, _mm_mullo_epi16(channels.b, _mm_set1_epi16(25)));
+		sum = _mm_add_epi16(sum, _mm_set1_epi16(128));
+		return _mm_add_epi16(_mm_srli_epi16(sum, 8), _mm_set1_epi16(16));
+	}
+
+	//Chroma sums stay within +-28688, signed 16-bit lanes with an arithmetic shift match the scalar code
+	__m128i ChromaVector(__m128i r, __m128i g, __m128i b, short redWeight, short greenWeight, short blueWeight)
+	{
+		__m128i sum{ _mm_mullo_epi16(r, _mm_set1_epi16(redWeight)) };
+		sum = _mm_add_epi16(sum, _mm_mullo_epi16(g, _mm_set1_epi16(greenWeight)));
+		sum = _mm_add_epi16(sum, _mm_mullo_epi16(b, _mm_set1_epi16(blueWeight)));
+		sum = _mm_add_epi16(sum, _mm_set1_epi16(128));
+		return _mm_add_epi16(_mm_srai_epi16(sum, 8), _mm_set1_epi16(128));
+	}
+
+	//Averages 2x2 blocks: row sums, then the neighboring lanes pairwise, for 8 pixels of both rows -> 4 blocks
+	__m128i AverageBlocks(__m128i top, __m128i bottom)
+	{
+		const __m128i sums{ _mm_madd_epi16(_mm_add_epi16(top, bottom), _mm_set1_epi16(1)) };
+		return _mm_srli_epi32(_mm_add_epi32(sums, _mm_set1_epi32(2)), 2);
+	}
+#endif
+}
+
+VideoStream::VideoStream(const std::string& path, Format format, int width, int height, int frameRate, uint32_t nrBuffers) :
+	m_Format(format),
+	m_Width(width),
+	m_Height(height)
+{
+	if (path == "-")
+	{
+		m_pFile = stdout;
+#ifdef _WIN32
+		//Text mode would expand every 0x0A byte of the frames
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+	}
+	else
+	{
+		m_pFile = std::fopen(path.c_str(), "wb");
+		m_CloseFile = true;
+	}
+
+	if (!m_pFile)
+		return;
+
+#ifndef _WIN32
+	//A consumer that quits must fail the write instead of killing the process
+	std::signal(SIGPIPE, SIG_IGN);
+#endif
+
+	std::string header{};
+	if (format == Format::y4m)
+	{
+		const std::string streamHeader{ "YUV4MPEG2 W" + std::to_string(width) + " H" + std::to_string(height) + " F" + std::to_string(frameRate)
+			+ ":1 Ip A1:1 C420jpeg XYSCSS=420JPEG XCOLORRANGE=LIMITED\n" };
+		std::fwrite(streamHeader.data(), 1, streamHeader.size(), m_pFile);
+
+		header = "FRAME\n";
+		const size_t chromaSize{ static_cast<size_t>((width + 1) / 2) * ((height + 1) / 2) };
+		m_FrameSize = static_cast<size_t>(width) * height + 2 * chromaSize;
+	}
+	else
+	{
+		m_FrameSize = static_cast<size_t>(width) * height * 3;
+	}
+	m_HeaderSize = header.size();
+
+	m_Buffers.resize(nrBuffers > 0 ? nrBuffers : 1);
+	for (std::vector<uint8_t>& buffer : m_Buffers)
+	{
+		buffer.resize(m_HeaderSize + m_FrameSize);
+		std::memcpy(buffer.data(), header.data(), m_HeaderSize);
+		m_FreeBuffers.emplace_back(&buffer);
+	}
+
+	m_Thread = std::thread{ &VideoStream::WriterLoop, this };
+}
+
+VideoStream::~VideoStream()
+{
+	if (m_Thread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock{ m_Mutex };
+			m_Quit = true;
+		}
+		m_BufferQueued.notify_one();
+		m_Thread.join();
+	}
+
+	if (m_pFile)
+	{
+		std::fflush(m_pFile);
+		if (m_CloseFile)
+			std::fclose(m_pFile);
+	}
+}
+
+bool VideoStream::HasFailed() const
+{
+	std::lock_guard<std::mutex> lock{ m_Mutex };
+	return m_HasFailed;
+}
+
+uint32_t VideoStream::GetNrFramesWritten() const
+{
+	std::lock_guard<std::mutex> lock{ m_Mutex };
+	return m_NrFramesWritten;
+}
+
+float VideoStream::Write(const SDL_Surface* pSurface)
+{
+	if (!m_pFile || pSurface->w != m_Width || pSurface->h != m_Height)
+		return 0.f;
+
+	const uint64_t waitStart{ SDL_GetPerformanceCounter() };
+
+	std::vector<uint8_t>* pBuffer{};
+	{
+		std::unique_lock<std::mutex> lock{ m_Mutex };
+		m_BufferFree.wait(lock, [this] { return !m_FreeBuffers.empty() || m_HasFailed; });
+		if (m_HasFailed)
+			return 0.f;
+
+		pBuffer = m_FreeBuffers.back();
+		m_FreeBuffers.pop_back();
+	}
+
+	const float waitTime{ static_cast<float>(SDL_GetPerformanceCounter() - waitStart) / SDL_GetPerformanceFrequency() };
+
+	Convert(pSurface, pBuffer->data() + m_HeaderSize);
+
+	{
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+		m_QueuedBuffers.push(pBuffer);
+	}
+	m_BufferQueued.notify_one();
+
+	return waitTime;
+}
+
+void VideoStream::Flush()
+{
+	std::unique_lock<std::mutex> lock{ m_Mutex };
+	m_BufferFree.wait(lock, [this] { return m_QueuedBuffers.empty() && !m_IsWriting; });
+}
+
+void VideoStream::WriterLoop()
+{
+	while (true)
+	{
+		std::vector<uint8_t>* pBuffer{};
+		{
+			std::unique_lock<std::mutex> lock{ m_Mutex };
+			m_BufferQueued.wait(lock, [this] { return m_Quit || !m_QueuedBuffers.empty(); });
+
+			if (m_QueuedBuffers.empty())
+				return;
+
+			pBuffer = m_QueuedBuffers.front();
+			m_QueuedBuffers.pop();
+			m_IsWriting = true;
+		}
+
+		const bool written{ std::fwrite(pBuffer->data(), 1, pBuffer->size(), m_pFile) == pBuffer->size() };
+
+		{
+			std::lock_guard<std::mutex> lock{ m_Mutex };
+			if (written)
+				++m_NrFramesWritten;
+			else
+				m_HasFailed = true;
+			m_FreeBuffers.emplace_back(pBuffer);
+			m_IsWriting = false;
+		}
+		m_BufferFree.notify_all();
+	}
+}
+
+void VideoStream::Convert(const SDL_Surface* pSurface, uint8_t* pFrame) const
+{
+	const SDL_PixelFormat* pFormat{ pSurface->format };
+	const bool hasByteChannels{ pFormat->BytesPerPixel == 4 && pFormat->Rloss == 0 && pFormat->Gloss == 0 && pFormat->Bloss == 0 };
+	const uint8_t* pPixels{ static_cast<const uint8_t*>(pSurface->pixels) };
+
+	if (m_Format == Format::y4m && hasByteChannels)
+	{
+		const size_t chromaSize{ static_cast<size_t>((m_Width + 1) / 2) * ((m_Height + 1) / 2) };
+		uint8_t* pY{ pFrame };
+		uint8_t* pU{ pY + static_cast<size_t>(m_Width) * m_Height };
+		ConvertToYuv420(reinterpret_cast<const uint32_t*>(pPixels), pSurface->pitch, m_Width, m_Height,
+			pFormat->Rshift, pFormat->Gshift, pFormat->Bshift, pY, pU, pU + chromaSize);
+		return;
+	}
+
+	//Any other layout, one pixel at a time
+	const auto pixelAt = [&](int x, int y)
+	{
+		uint32_t pixel{};
+		std::memcpy(&pixel, pPixels + y * pSurface->pitch + x * pFormat->BytesPerPixel, pFormat->BytesPerPixel);
+
+		uint8_t r{}, g{}, b{};
+		SDL_GetRGB(pixel, pFormat, &r, &g, &b);
+		return Rgb{ r, g, b };
+	};
+
+	if (m_Format == Format::rgb24)
+	{
+		if (hasByteChannels)
+		{
+			for (int y{}; y < m_Height; ++y)
+			{
+				const uint32_t* pRow{ reinterpret_cast<const uint32_t*>(pPixels + y * pSurface->pitch) };
+				uint8_t* pDestination{ pFrame + static_cast<size_t>(y) * m_Width * 3 };
+				for (int x{}; x < m_Width; ++x)
+				{
+					pDestination[x * 3] = static_cast<uint8_t>(pRow[x] >> pFormat->Rshift);
+					pDestination[x * 3 + 1] = static_cast<uint8_t>(pRow[x] >> pFormat->Gshift);
+					pDestination[x * 3 + 2] = static_cast<uint8_t>(pRow[x] >> pFormat->Bshift);
+				}
+			}
+			return;
+		}
+
+		for (int y{}; y < m_Height; ++y)
+		{
+			for (int x{}; x < m_Width; ++x)
+			{
+				const Rgb color{ pixelAt(x, y) };
+				uint8_t* pDestination{ pFrame + (static_cast<size_t>(y) * m_Width + x) * 3 };
+				pDestination[0] = static_cast<uint8_t>(color.r);
+				pDestination[1] = static_cast<uint8_t>(color.g);
+				pDestination[2] = static_cast<uint8_t>(color.b);
+			}
+		}
+		return;
+	}
+
+	const size_t chromaSize{ static_cast<size_t>((m_Width + 1) / 2) * ((m_Height + 1) / 2) };
+	uint8_t* pU{ pFrame + static_cast<size_t>(m_Width) * m_Height };
+	for (int y{}; y < m_Height; y += 2)
+		ConvertRowPair(pixelAt, 0, m_Width, m_Height, y, pFrame, pU, pU + chromaSize);
+}
+
+void VideoStream::ConvertToYuv420(const uint32_t* pPixels, int pitch, int width, int height, uint32_t redShift, uint32_t greenShift, uint32_t blueShift, uint8_t* pY, uint8_t* pU, uint8_t* pV)
+{
+	const uint8_t* pBytes{ reinterpret_cast<const uint8_t*>(pPixels) };
+	const auto pixelAt = [&](int x, int y)
+	{
+		const uint32_t pixel{ reinterpret_cast<const uint32_t*>(pBytes + y * pitch)[x] };
+		return Rgb{ static_cast<int>((pixel >> redShift) & 0xFF), static_cast<int>((pixel >> greenShift) & 0xFF), static_cast<int>((pixel >> blueShift) & 0xFF) };
+	};
+
+	const int chromaWidth{ (width + 1) / 2 };
+
+	for (int y{}; y < height; y += 2)
+	{
+		int x{};
+
+#ifdef VIDEOSTREAM_SSE2
+		//Full row pairs only, an odd last row is left to the scalar code
+		if (y + 1 < height)
+		{
+			const __m128i red{ _mm_cvtsi32_si128(static_cast<int>(redShift)) };
+			const __m128i green{ _mm_cvtsi32_si128(static_cast<int>(greenShift)) };
+			const __m128i blue{ _mm_cvtsi32_si128(static_cast<int>(blueShift)) };
+			const uint32_t* pTop{ reinterpret_cast<const uint32_t*>(pBytes + y * pitch) };
+			const uint32_t* pBottom{ reinterpret_cast<const uint32_t*>(pBytes + (y + 1) * pitch) };
+
+			for (; x + 8 <= width; x += 8)
+			{
+				const Channels top{ LoadChannels(pTop + x, red, green, blue) };
+				const Channels bottom{ LoadChannels(pBottom + x, red, green, blue) };
+
+				//Luma bytes of both rows, 8 each
+				const __m128i luma{ _mm_packus_epi16(LumaVector(top), LumaVector(bottom)) };
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(pY + y * width + x), luma);
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(pY + (y + 1) * width + x), _mm_srli_si128(luma, 8));
+
+				//4 block averages per channel, duplicated to fill the 16-bit lanes
+				const __m128i averageRed{ AverageBlocks(top.r, bottom.r) };
+				const __m128i averageGreen{ AverageBlocks(top.g, bottom.g) };
+				const __m128i averageBlue{ AverageBlocks(top.b, bottom.b) };
+				const __m128i r{ _mm_packs_epi32(averageRed, averageRed) };
+				const __m128i g{ _mm_packs_epi32(averageGreen, averageGreen) };
+				const __m128i b{ _mm_packs_epi32(averageBlue, averageBlue) };
+
+				const __m128i chromaBlue{ _mm_packus_epi16(ChromaVector(r, g, b, -38, -74, 112), _mm_setzero_si128()) };
+				const __m128i chromaRed{ _mm_packus_epi16(ChromaVector(r, g, b, 112, -94, -18), _mm_setzero_si128()) };
+				const int chromaIndex{ y / 2 * chromaWidth + x / 2 };
+				const int blueBytes{ _mm_cvtsi128_si32(chromaBlue) };
+				const int redBytes{ _mm_cvtsi128_si32(chromaRed) };
+				std::memcpy(pU + chromaIndex, &blueBytes, 4);
+				std::memcpy(pV + chromaIndex, &redBytes, 4);
+			}
+		}
+#endif
+
+		ConvertRowPair(pixelAt, x, width, height, y, pY, pU, pV);
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct SDL_PixelFormat;
+struct SDL_Surface;
+
+namespace dae
+{
+	//Streams frames as uncompressed video to stdout or a named pipe, for an external encoder to consume.
+	//Write converts the surface straight into one of a ring of buffers that are allocated up front, a background
+	//thread pushes the buffers into the pipe, the render loop only waits when the consumer falls behind the ring.
+	class VideoStream final
+	{
+	public:
+		enum class Format
+		{
+			y4m, //YUV4MPEG2, 4:2:0 BT.601 limited range, chroma averaged over 2x2 blocks
+			rgb24 //Raw RGB bytes without any header, the consumer has to be told the size and rate
+		};
+
+		/**
+		 * \param path "-" writes to stdout, anything else is opened as a file, e.g. a FIFO created by the encoder
+		 * \param frameRate frames per second announced in the Y4M header
+		 * \param nrBuffers frames that can be in flight between the render loop and the pipe
+		 */
+		VideoStream(const std::string& path, Format format, int width, int height, int frameRate, uint32_t nrBuffers = 4);
+		//Writes every queued frame and closes the pipe
+		~VideoStream();
+
+		VideoStream(const VideoStream&) = delete;
+		VideoStream(VideoStream&&) noexcept = delete;
+		VideoStream& operator=(const VideoStream&) = delete;
+		VideoStream& operator=(VideoStream&&) noexcept = delete;
+
+		bool IsOpen() const { return m_pFile != nullptr; }
+		//Set once a write failed, e.g. the consumer closed the pipe, later frames are dropped
+		bool HasFailed() const;
+		uint32_t GetNrFramesWritten() const;
+
+		/**
+		 * \brief Converts the surface into the next free buffer and queues it. The surface must be width x height.
+		 * \return seconds spent waiting for a free buffer
+		 */
+		float Write(const SDL_Surface* pSurface);
+		//Blocks until every queued frame is in the pipe
+		void Flush();
+
+		//Converts 32-bit pixels with 8-bit channels at the given shifts, pY receives width x height bytes,
+		//pU and pV (width + 1) / 2 x (height + 1) / 2 bytes each. Vectorized with SSE2 where available.
+		static void ConvertToYuv420(const uint32_t* pPixels, int pitch, int width, int height, uint32_t redShift, uint32_t greenShift, uint32_t blueShift, uint8_t* pY, uint8_t* pU, uint8_t* pV);
+
+	private:
+		Format m_Format;
+		int m_Width;
+		int m_Height;
+		FILE* m_pFile{};
+		bool m_CloseFile{ false };
+
+		//One frame ready to be written, header included
+		std::vector<std::vector<uint8_t>> m_Buffers{};
+		size_t m_HeaderSize{};
+		size_t m_FrameSize{};
+
+		std::vector<std::vector<uint8_t>*> m_FreeBuffers{};
+		std::queue<std::vector<uint8_t>*> m_QueuedBuffers{};
+		bool m_IsWriting{ false };
+		uint32_t m_NrFramesWritten{};
+		bool m_HasFailed{ false };
+		bool m_Quit{ false };
+
+		mutable std::mutex m_Mutex{};
+		std::condition_variable m_BufferQueued{};
+		std::condition_variable m_BufferFree{};
+		std::thread m_Thread{};
+
+		void WriterLoop();
+		//Fills the frame part of a buffer, pixels the fast paths can't read go through SDL_GetRGB
+		void Convert(const SDL_Surface* pSurface, uint8_t* pFrame) const;
+	};
+}
@@ -5,59 +5,320 @@
 #undef main
 
 //Standard includes
+#include <algorithm>
+#include <charconv>
 #include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
 
 //Project includes
+#include "BatchRenderer.h"
+#include "GeometryCache.h"
+#include "ImageEncoders.h"
+#include "MeshCache.h"
 #include "Timer.h"
 #include "Renderer.h"
+#include "RenderTarget.h"
 #include "Scene.h"
+#include "SceneFactory.h"
+#include "SceneFile.h"
+#include "VideoStream.h"
 
 using namespace dae;
 
 void ShutDown(SDL_Window* pWindow)
 {
-	SDL_DestroyWindow(pWindow);
+	if (pWindow)
+		SDL_DestroyWindow(pWindow);
 	SDL_Quit();
 }
 
+//The whole text as a number, false when it is not one or out of range
+template<typename T>
+bool ParseNumber(std::string_view text, T& value)
+{
+	const char* pEnd{ text.data() + text.size() };
+	const std::from_chars_result result{ std::from_chars(text.data(), pEnd, value) };
+	return !text.empty() && result.ec == std::errc{} && result.ptr == pEnd;
+}
+
 int main(int argc, char* args[])
 {
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
+	//Command line: -threads <count> sets the number of render workers, -pin pins them to their own processor,
+	//-deadline <ms> stops a frame from starting new tiles after that time,
+	//-headless renders -frames <count> frames into memory without opening a window,
+	//-scene <name> picks a registered scene or a .scene/.sceneb file, for the window, headless and batch runs,
+	//generated scenes take a count and seed as <name>:<count>:<seed>, e.g. Scene_Stress_Spheres:100000:7,
+	//-batch renders an image sequence, see BatchSettings: -size <w>x<h> -frames <count>
+	//-timestep <seconds> -keyframes <file> -output <prefix> -format <bmp|ppm|pfm|qoi|png|exr>,
+	//-screenshot <file> sets the file X saves to, its extension picks the format,
+	//-stream <file|-> streams every rendered frame as video to a file, pipe or stdout (-), with -streamformat <y4m|rgb24> -fps <rate>,
+	//-convert <file.obj|file.scene> writes the binary mesh cache or binary scene next to the file and exits, may be repeated,
+	//-watch reloads what changed in a scene file and its OBJ files while the window is open,
+	//-pagecache <MB> sets how much geometry of streamed meshes stays in memory
+	uint32_t nrWorkers{};
+	bool pinWorkers{ false };
+	float frameDeadline{};
+	bool headless{ false };
+	uint32_t nrHeadlessFrames{ 100 };
+	bool batch{ false };
+	BatchSettings batchSettings{};
+	std::string screenshotPath{ "RayTracing_Buffer.png" };
+	int streamFrameRate{ 30 };
+	std::vector<std::string> convertPaths{};
+	bool watchScene{ false };
+	for (int index = 1; index < argc; ++index)
+	{
+		const std::string argument{ args[index] };
+		const bool hasValue{ index + 1 < argc };
+		//Set when the value of argument can't be used, describes what was expected
+		const char* pExpected{};
+		if (argument == "-threads" && hasValue)
+		{
+			if (!ParseNumber(args[++index], nrWorkers))
+				pExpected = "a worker count";
+		}
+		else if (argument == "-pin")
+			pinWorkers = true;
+		else if (argument == "-deadline" && hasValue)
+		{
+			if (ParseNumber(args[++index], frameDeadline) && frameDeadline >= 0.f)
+				frameDeadline /= 1000.f;
+			else
+				pExpected = "milliseconds, 0 or more";
+		}
+		else if (argument == "-headless")
+			headless = true;
+		else if (argument == "-frames" && hasValue)
+		{
+			if (ParseNumber(args[++index], nrHeadlessFrames) && nrHeadlessFrames > 0)
+				batchSettings.nrFrames = nrHeadlessFrames;
+			else
+				pExpected = "a frame count greater than 0";
+		}
+		else if (argument == "-batch")
+			batch = true;
+		else if (argument == "-scene" && hasValue)
+			batchSettings.sceneName = args[++index];
+		else if (argument == "-size" && hasValue)
+		{
+			const std::string_view size{ args[++index] };
+			const size_t separator{ size.find('x') };
+			if (separator == std::string_view::npos || !ParseNumber(size.substr(0, separator), batchSettings.width)
+				|| !ParseNumber(size.substr(separator + 1), batchSettings.height) || batchSettings.width <= 0 || batchSettings.height <= 0)
+				pExpected = "<width>x<height>, both greater than 0";
+		}
+		else if (argument == "-timestep" && hasValue)
+		{
+			if (!ParseNumber(args[++index], batchSettings.timeStep) || batchSettings.timeStep <= 0.f)
+				pExpected = "seconds, greater than 0";
+		}
+		else if (argument == "-keyframes" && hasValue)
+			batchSettings.keyframePath = args[++index];
+		else if (argument == "-output" && hasValue)
+			batchSettings.outputPrefix = args[++index];
+		else if (argument == "-format" && hasValue)
+		{
+			batchSettings.imageExtension = args[++index];
+			if (!ImageEncoders::IsImageExtension(batchSettings.imageExtension))
+				pExpected = "bmp, ppm, pfm, qoi, png or exr";
+		}
+		else if (argument == "-screenshot" && hasValue)
+		{
+			screenshotPath = args[++index];
+			if (!ImageEncoders::IsImageExtension(screenshotPath.substr(screenshotPath.find_last_of('.') + 1)))
+				pExpected = "a file ending in .bmp, .ppm, .pfm, .qoi, .png or .exr";
+		}
+		else if (argument == "-stream" && hasValue)
+			batchSettings.streamPath = args[++index];
+		else if (argument == "-streamformat" && hasValue)
+		{
+			const std::string_view format{ args[++index] };
+			if (format == "y4m")
+				batchSettings.streamFormat = VideoStream::Format::y4m;
+			else if (format == "rgb24")
+				batchSettings.streamFormat = VideoStream::Format::rgb24;
+			else
+				pExpected = "y4m or rgb24";
+		}
+		else if (argument == "-fps" && hasValue)
+		{
+			if (!ParseNumber(args[++index], streamFrameRate) || streamFrameRate <= 0)
+				pExpected = "a frame rate greater than 0";
+		}
+		else if (argument == "-convert" && hasValue)
+			convertPaths.emplace_back(args[++index]);
+		else if (argument == "-watch")
+			watchScene = true;
+		else if (argument == "-pagecache" && hasValue)
+		{
+			size_t pageCacheSize{};
+			if (ParseNumber(args[++index], pageCacheSize))
+				GeometryCache::GetInstance().SetCapacity(pageCacheSize << 20);
+			else
+				pExpected = "a size in MB";
+		}
+		else
+		{
+			//Options that take a value end up here as well when they are the last argument
+			constexpr std::string_view valueOptions[]{ "-threads", "-deadline", "-frames", "-scene", "-size", "-timestep", "-keyframes",
+				"-output", "-format", "-screenshot", "-stream", "-streamformat", "-fps", "-convert", "-pagecache" };
+			if (std::find(std::begin(valueOptions), std::end(valueOptions), argument) != std::end(valueOptions))
+				std::cout << "Missing value for " << argument << std::endl;
+			else
+				std::cout << "Unknown argument " << argument << std::endl;
+			return 1;
+		}
+
+		if (pExpected)
+		{
+			std::cout << "Invalid value '" << args[index] << "' for " << argument << ", expected " << pExpected << std::endl;
+			return 1;
+		}
+	}
+
+	if (!convertPaths.empty())
+	{
+		int exitCode{};
+		for (const std::string& path : convertPaths)
+		{
+			if (SceneFile::IsScenePath(path))
+			{
+				SceneDescription scene{};
+				if (!SceneFile::Load(path, scene) || !SceneFile::Write(SceneFile::GetBinaryPath(path), scene))
+					exitCode = 1;
+			}
+			else if (!MeshCache::Convert(path, MeshCache::GetCachePath(path)))
+			{
+				exitCode = 1;
+			}
+		}
+		return exitCode;
+	}
+
+	//The frames own stdout, the console output moves to stderr
+	if (batchSettings.streamPath == "-")
+		std::cout.rdbuf(std::cerr.rdbuf());
+
+	if (batch)
+	{
+		SDL_Init(0);
+		batchSettings.nrWorkers = nrWorkers;
+		batchSettings.pinWorkers = pinWorkers;
+		const int exitCode{ BatchRenderer{ batchSettings }.Run() };
+		GeometryCache::GetInstance().PrintStatistics();
+		SDL_Quit();
+		return exitCode;
+	}
+
+	Scene* pScene{ SceneFactory::GetInstance().Create(batchSettings.sceneName) };
+	if (!pScene)
+	{
+		std::cout << "Unknown scene '" << batchSettings.sceneName << "'" << std::endl;
+		return 1;
+	}
 
-	//Create window + surfaces
-	SDL_Init(SDL_INIT_VIDEO);
+	//Create window + surfaces, headless runs need neither a display nor the video subsystem
+	SDL_Init(headless ? 0 : SDL_INIT_VIDEO);
 
 	const uint32_t width = 640;
 	const uint32_t height = 480;
 
-	SDL_Window* pWindow = SDL_CreateWindow(
-		"RayTracer - **Insert Name**",
-		SDL_WINDOWPOS_UNDEFINED,
-		SDL_WINDOWPOS_UNDEFINED,
-		width, height, 0);
+	SDL_Window* pWindow{};
+	RenderTarget* pTarget{};
 
-	if (!pWindow)
-		return 1;
+	if (headless)
+	{
+		pTarget = new MemoryRenderTarget(width, height);
+	}
+	else
+	{
+		pWindow = SDL_CreateWindow(
+			"RayTracer - **Insert Name**",
+			SDL_WINDOWPOS_UNDEFINED,
+			SDL_WINDOWPOS_UNDEFINED,
+			width, height, 0);
+
+		if (!pWindow)
+		{
+			delete pScene;
+			return 1;
+		}
+
+		pTarget = new WindowRenderTarget(pWindow);
+	}
 
 	//Initialize "framework"
 	const auto pTimer = new Timer();
-	const auto pRenderer = new Renderer(pWindow);
+	const auto pRenderer = new Renderer(pTarget);
+	pRenderer->SetWorkers(nrWorkers, pinWorkers);
+	pRenderer->GetImageWriter().SetLogWrites(true);
+	pRenderer->SetFrameDeadline(frameDeadline);
+
+	//Camera input makes the frame in flight stale, show the finished tiles and start over with the new camera.
+	//Only what Camera::Update reacts to counts: a held WASD key or mouse motion while the left button is down.
+	if (!headless)
+	{
+		pRenderer->SetCancelCheck([]
+			{
+				SDL_PumpEvents();
+
+				const uint8_t* pKeyboardState{ SDL_GetKeyboardState(nullptr) };
+				if (pKeyboardState[SDL_SCANCODE_W] || pKeyboardState[SDL_SCANCODE_A] || pKeyboardState[SDL_SCANCODE_S] || pKeyboardState[SDL_SCANCODE_D])
+					return true;
 
-	const auto pScene = new Scene_W4_Reference();
-	//const auto pScene = new Scene_W4_Bunny();
+				//Peeked, the main loop still handles the events
+				constexpr int maxEvents{ 64 };
+				SDL_Event events[maxEvents];
+				const int nrEvents{ std::max(SDL_PeepEvents(events, maxEvents, SDL_PEEKEVENT, SDL_MOUSEMOTION, SDL_MOUSEMOTION), 0) };
+				return std::any_of(events, events + nrEvents, [](const SDL_Event& event) { return (event.motion.state & SDL_BUTTON_LMASK) != 0; });
+			});
+	}
+
+	VideoStream* pStream{};
+	if (!batchSettings.streamPath.empty())
+	{
+		pStream = new VideoStream(batchSettings.streamPath, batchSettings.streamFormat, width, height, streamFrameRate);
+		if (!pStream->IsOpen())
+			std::cout << "Could not open video stream " << batchSettings.streamPath << std::endl;
+	}
 
 	pScene->Initialize();
 
+	if (watchScene && !headless)
+	{
+		if (Scene_File* pFileScene{ dynamic_cast<Scene_File*>(pScene) })
+			pFileScene->EnableHotReload();
+		else
+			std::cout << "Only scenes loaded from a file can be watched" << std::endl;
+	}
+
 	//Start loop
 	pTimer->Start();
 
 	// Start Benchmark
 
 	float printTimer = 0.f;
-	bool isLooping = true;
+	bool isLooping = !headless;
 	bool takeScreenshot = false;
+
+	if (headless)
+	{
+		//No input to wait for, render the frames back to back and report the throughput
+		for (uint32_t frame{}; frame < nrHeadlessFrames; ++frame)
+		{
+			pScene->Update(pTimer);
+			pRenderer->Render(pScene);
+			if (pStream)
+				pStream->Write(pTarget->GetSurface());
+			pTimer->Update();
+		}
+
+		std::cout << "Headless: " << nrHeadlessFrames << " frames in " << pTimer->GetTotal() << " s, "
+			<< nrHeadlessFrames / pTimer->GetTotal() << " fps" << std::endl;
+		GeometryCache::GetInstance().PrintStatistics();
+	}
 	while (isLooping)
 	{
 		//--------- Get input events ---------
@@ -76,8 +337,26 @@ int main(int argc, char* args[])
 					pRenderer->ToggleShadows();
 				if (e.key.keysym.scancode == SDL_SCANCODE_F3)
 					pRenderer->ToggleLightMode();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F4)
+					pRenderer->ToggleRenderMode();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F5)
+					pRenderer->ToggleFrameCache();
 				if (e.key.keysym.scancode == SDL_SCANCODE_F6)
 					pTimer->StartBenchmark();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F7)
+					pRenderer->ToggleDynamicResolution();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F8)
+					pRenderer->CycleAntiAliasing();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F9)
+					pRenderer->PrintScalingReport(pScene);
+				if (e.key.keysym.scancode == SDL_SCANCODE_F10)
+					pRenderer->CycleToneMapping();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F11)
+					pScene->PrintMeshMemoryUsage();
+				if (e.key.keysym.scancode == SDL_SCANCODE_PAGEUP)
+					pRenderer->ScaleExposure(1.41421356f); //Half a stop
+				if (e.key.keysym.scancode == SDL_SCANCODE_PAGEDOWN)
+					pRenderer->ScaleExposure(1.f / 1.41421356f);
 
 				break;
 			}
@@ -87,24 +366,35 @@ int main(int argc, char* args[])
 		pScene->Update(pTimer);
 
 		//--------- Render ---------
-		pRenderer->Render(pScene);
+		const bool isRendered{ pRenderer->Render(pScene) };
+		if (!isRendered)
+			SDL_Delay(15); //Frame skipped, don't spin while the scene is idle
+		else if (pStream)
+			pStream->Write(pTarget->GetSurface());
 
 		//--------- Timer ---------
 		pTimer->Update();
+		//The sleep of a skipped frame isn't render time, it would lower the resolution of an idle scene
+		if (isRendered)
+			pRenderer->UpdateFrameBudget(pTimer->GetElapsed());
 		printTimer += pTimer->GetElapsed();
 		if (printTimer >= 1.f)
 		{
 			printTimer = 0.f;
-			std::cout << "dFPS: " << pTimer->GetdFPS() << std::endl;
+			std::cout << "dFPS: " << pTimer->GetdFPS();
+			if (pRenderer->GetNrAntiAliasingSamples() > 0)
+				std::cout << ", samples/frame: " << pRenderer->GetNrAntiAliasingSamples();
+			std::cout << std::endl;
+
+			//Of the last second, prints nothing when no mesh is streamed
+			GeometryCache::GetInstance().PrintStatistics();
+			GeometryCache::GetInstance().ResetStatistics();
 		}
 
-		//Save screenshot after full render
+		//Save screenshot after full render, the writer reports when it is on disk
 		if (takeScreenshot)
 		{
-			if (!pRenderer->SaveBufferToImage())
-				std::cout << "Screenshot saved!" << std::endl;
-			else
-				std::cout << "Something went wrong. Screenshot not saved!" << std::endl;
+			pRenderer->SaveBufferToImage(screenshotPath);
 			takeScreenshot = false;
 		}
 	}
@@ -112,7 +402,9 @@ int main(int argc, char* args[])
 
 	//Shutdown "framework"
 	delete pScene;
+	delete pStream;
 	delete pRenderer;
+	delete pTarget;
 	delete pTimer;
 
 	ShutDown(pWindow);